@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+#include "just/agent.hpp"
+#include "just/dwa.hpp"
+#include "just/kernels.hpp"
+#include "just/kinematic_world.hpp"
+#include "just/physics.hpp"
+#include "just/sensor.hpp"
+#include "just/world_model.hpp"
+
+// Microbenchmarks of the mapping, sensing and planning kernels.
+//
+// Run with e.g. `just_bench --benchmark_format=json --benchmark_out=results.json` for machine
+// readable results, see `just_bench --help` for filtering and repetitions.
+//
+// Obstacle densities are given in percent of occupied cells (for the grid/window kernels) or as a
+// number of obstacles in sensor range (for the sensor). Everything random is seeded, so runs are
+// comparable with each other.
+
+namespace
+{
+
+constexpr size_t WINDOW_SIZE = just::VFHAgent::WINDOW_SIZE;
+constexpr size_t WINDOW_SIZE_SQUARED = just::VFHAgent::WINDOW_SIZE_SQUARED;
+constexpr size_t K = just::VFHAgent::K;
+
+// An active window with 'density' percent of its cells holding a random certainty value
+std::array<uint8_t, WINDOW_SIZE_SQUARED> random_window(int density)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> certainty(1, just::HistogramGrid::CV_MAX);
+
+    std::array<uint8_t, WINDOW_SIZE_SQUARED> window{};
+    for (auto& cell : window) {
+        if (percent(rng) < density) {
+            cell = certainty(rng);
+        }
+    }
+    return window;
+}
+
+std::array<float, K> polar_histogram_of(const std::array<uint8_t, WINDOW_SIZE_SQUARED>& window)
+{
+    std::array<uint32_t, K> sectors;
+    std::array<float, K> smoothed;
+    just::VFHAgent::project_window(window, sectors);
+    just::VFHAgent::smooth_sectors(sectors, smoothed);
+    return smoothed;
+}
+
+// Args: grid size, percept distance (cells)
+void BM_AddPercept(benchmark::State& state)
+{
+    unsigned grid_size = state.range(0);
+    float distance = state.range(1);
+    just::HistogramGrid grid(grid_size, grid_size);
+
+    // Sweep around the origin like a sensor array would, alternating hits and misses
+    constexpr int BEAMS = 36;
+    int beam = 0;
+    for (auto _ : state) {
+        float theta = 2.0 * M_PI * beam / BEAMS;
+        benchmark::DoNotOptimize(grid.add_percept(0, 0, theta, distance, beam % 2 == 0));
+        beam = (beam + 1) % BEAMS;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AddPercept)->ArgsProduct({{100, 1000, 4000}, {5, 25, 100}});
+
+// Args: grid size
+template <size_t W>
+void BM_Subgrid(benchmark::State& state)
+{
+    unsigned grid_size = state.range(0);
+    just::HistogramGrid grid(grid_size, grid_size);
+
+    for (auto _ : state) {
+        auto window = grid.subgrid<W, W>(0, 0);
+        benchmark::DoNotOptimize(window);
+    }
+    state.SetBytesProcessed(state.iterations() * W * W);
+}
+BENCHMARK_TEMPLATE(BM_Subgrid, 15)->Arg(100)->Arg(1000)->Arg(4000);
+BENCHMARK_TEMPLATE(BM_Subgrid, 30)->Arg(100)->Arg(1000)->Arg(4000);
+BENCHMARK_TEMPLATE(BM_Subgrid, 61)->Arg(100)->Arg(1000)->Arg(4000);
+
+// The work of VFHAgent::create_polar_histogram: window extraction, projection and smoothing.
+// Args: grid size, obstacle density
+void BM_CreatePolarHistogram(benchmark::State& state)
+{
+    unsigned grid_size = state.range(0);
+    just::HistogramGrid grid(grid_size, grid_size);
+
+    // Put the obstacles into the grid at the window's location. Each hit also clears the cell to
+    // its left, so columns are filled right to left to not undo earlier hits.
+    auto obstacles = random_window(state.range(1));
+    int half = WINDOW_SIZE / 2;
+    for (size_t i = 0; i < WINDOW_SIZE; ++i) {
+        for (size_t j = WINDOW_SIZE; j-- > 0;) {
+            uint8_t value = obstacles[i * WINDOW_SIZE + j];
+            int x = static_cast<int>(j) - half + 1;
+            int y = static_cast<int>(i) - half + 1;
+            for (int hits = 0; hits < value; hits += just::HistogramGrid::CV_INC) {
+                grid.add_percept(x - 1, y, 0.0, 1.0, true);
+            }
+        }
+    }
+
+    std::array<uint8_t, WINDOW_SIZE_SQUARED> window;
+    std::array<uint32_t, K> sectors;
+    std::array<float, K> smoothed;
+    for (auto _ : state) {
+        grid.copy_subgrid<WINDOW_SIZE, WINDOW_SIZE>(0, 0, window);
+        just::VFHAgent::project_window(window, sectors);
+        just::VFHAgent::smooth_sectors(sectors, smoothed);
+        benchmark::DoNotOptimize(smoothed);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CreatePolarHistogram)->ArgsProduct({{100, 1000, 4000}, {0, 10, 50}});
+
+// Args: obstacle density
+void BM_ProjectWindow(benchmark::State& state)
+{
+    auto window = random_window(state.range(0));
+    std::array<uint32_t, K> sectors;
+    for (auto _ : state) {
+        just::VFHAgent::project_window(window, sectors);
+        benchmark::DoNotOptimize(sectors);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ProjectWindow)->Arg(0)->Arg(10)->Arg(50);
+
+void BM_SmoothSectors(benchmark::State& state)
+{
+    std::array<uint32_t, K> sectors;
+    just::VFHAgent::project_window(random_window(10), sectors);
+    std::array<float, K> smoothed;
+    for (auto _ : state) {
+        just::VFHAgent::smooth_sectors(sectors, smoothed);
+        benchmark::DoNotOptimize(smoothed);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SmoothSectors);
+
+// The work of VFHAgent::compute_steering: target sector, valley search and steering command.
+// Args: obstacle density
+void BM_ComputeSteering(benchmark::State& state)
+{
+    auto polar_histogram = polar_histogram_of(random_window(state.range(0)));
+    // Threshold in the middle of the range, so there are valleys to search
+    auto [min, max] = std::minmax_element(polar_histogram.begin(), polar_histogram.end());
+    float valley_threshold = (*min + *max) / 2.0;
+
+    for (auto _ : state) {
+        size_t k_target = just::VFHAgent::target_sector({10.0, 5.0});
+        auto heading = just::VFHAgent::select_heading(polar_histogram, k_target, valley_threshold);
+        if (heading) {
+            benchmark::DoNotOptimize(just::VFHAgent::steering_command(polar_histogram,
+                                                                      *heading,
+                                                                      valley_threshold,
+                                                                      1.0));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ComputeSteering)->Arg(0)->Arg(10)->Arg(50);
+
+// The work of DWAAgent's planning, choosing a velocity by rolling out every sample. To weigh
+// against BM_CreatePolarHistogram plus BM_ComputeSteering for VFH.
+// Args: turn rate samples (by 8 speeds), obstacle density
+void BM_DynamicWindow(benchmark::State& state)
+{
+    static_assert(just::DynamicWindow::WINDOW_SIZE == WINDOW_SIZE);
+    just::DynamicWindow::Options options;
+    options.turn_samples = state.range(0);
+    options.max_speed = 3.0;
+    just::DynamicWindow dwa(options);
+    auto window = random_window(state.range(1));
+    // The agent's own cell is clear, as it would be when driving
+    window[(WINDOW_SIZE / 2 - 1) * WINDOW_SIZE + WINDOW_SIZE / 2 - 1] = 0;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            dwa.choose(window, {0.0, 0.0}, 0.0, {1.5, 0.0}, {10.0, 5.0}, 0.02));
+    }
+    state.SetItemsProcessed(state.iterations() * dwa.sample_count());
+}
+BENCHMARK(BM_DynamicWindow)->ArgsProduct({{9, 25, 65}, {0, 10, 50}});
+
+// Each variant of the dispatched kernels, to see what the wider ones buy. Variants the host doesn't
+// support are skipped.
+// Args: ISA (see just::Isa)
+void BM_KernelVariants(benchmark::State& state)
+{
+    auto isa = static_cast<just::Isa>(state.range(0));
+    const just::Kernels* kernels = just::kernels_for(isa);
+    if (!kernels) {
+        state.SkipWithError("ISA not supported by this host");
+        return;
+    }
+    state.SetLabel(just::isa_name(isa));
+
+    // What the agents run per step: a projection and smoothing of the window, and a rollout of a
+    // typical number of DWA samples over 20 steps
+    constexpr size_t ROLLOUTS = 200;
+    constexpr size_t ROLLOUT_STEPS = 20;
+    auto window = random_window(10);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> sector(0, K - 1);
+    std::uniform_int_distribution<int> weight(0, just::VFHAgent::A);
+    std::uniform_real_distribution<float> real(-1.0, 1.0);
+    std::array<uint8_t, WINDOW_SIZE_SQUARED> sectors_of;
+    std::array<uint16_t, WINDOW_SIZE_SQUARED> weights;
+    for (size_t idx = 0; idx < WINDOW_SIZE_SQUARED; ++idx) {
+        sectors_of[idx] = sector(rng);
+        weights[idx] = weight(rng);
+    }
+    // Speed, the rotation of a step and the state (heading and position) rolled out. The
+    // rotations and headings are those of random angles, anything else would grow or shrink
+    // towards inf or denormals over the iterations.
+    std::uniform_real_distribution<float> angle(-M_PI, M_PI);
+    std::array<std::vector<float>, 7> rollouts;
+    for (size_t i = 0; i < ROLLOUTS; ++i) {
+        float turn = 0.1 * angle(rng);
+        float heading = angle(rng);
+        rollouts[0].push_back(real(rng));
+        rollouts[1].push_back(std::cos(turn));
+        rollouts[2].push_back(std::sin(turn));
+        rollouts[3].push_back(std::cos(heading));
+        rollouts[4].push_back(std::sin(heading));
+        rollouts[5].push_back(10.0 * real(rng));
+        rollouts[6].push_back(10.0 * real(rng));
+    }
+    // Every iteration starts the rollouts over from here. The copy is the same for every variant,
+    // and small next to the rollout itself.
+    const auto initial = rollouts;
+
+    std::array<uint32_t, K> sectors;
+    std::array<float, K> smoothed;
+    for (auto _ : state) {
+        for (size_t i = 3; i < rollouts.size(); ++i) {
+            std::copy(initial[i].begin(), initial[i].end(), rollouts[i].begin());
+        }
+        sectors.fill(0);
+        kernels->project_window(
+            window.data(), sectors_of.data(), weights.data(), WINDOW_SIZE_SQUARED, sectors.data());
+        kernels->smooth_sectors(sectors.data(), smoothed.data());
+        for (size_t step = 0; step < ROLLOUT_STEPS; ++step) {
+            kernels->rollout_step(ROLLOUTS,
+                                  0.1,
+                                  rollouts[0].data(),
+                                  rollouts[1].data(),
+                                  rollouts[2].data(),
+                                  rollouts[3].data(),
+                                  rollouts[4].data(),
+                                  rollouts[5].data(),
+                                  rollouts[6].data());
+        }
+        benchmark::DoNotOptimize(smoothed);
+        benchmark::DoNotOptimize(rollouts[5].data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_KernelVariants)->DenseRange(static_cast<int>(just::Isa::SCALAR),
+                                         static_cast<int>(just::Isa::AVX512));
+
+// Args: beam count, obstacles in range
+void BM_SenseAll(benchmark::State& state)
+{
+    constexpr float RANGE = 25.0;
+    just::Box2DWorld world;
+    auto body = world.create_body(toml::table{{"shape", "circle"}, {"radius", 1.0}});
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-RANGE, RANGE);
+    for (int i = 0; i < state.range(1); ++i) {
+        b2Vec2 center{position(rng), position(rng)};
+        // Keep the agent itself clear
+        if (center.Length() < 3.0) {
+            center.x += 5.0;
+        }
+        world.add_obstacle(toml::table{
+            {"shape", "circle"}, {"radius", 0.5}, {"x", center.x}, {"y", center.y}});
+    }
+    // Let the broadphase settle, as it would have in a running simulation
+    world.step(0.01);
+
+    just::UltrasonicArray sensor(state.range(0), RANGE, &world, body.get());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sensor.sense_all());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SenseAll)->ArgsProduct({{8, 36, 180}, {0, 10, 100, 1000}});
+
+// Every agent of a swarm looking up its neighbours within 10m.
+// Args: backend (0 for Box2D, 1 for kinematic), agent count
+void BM_BodiesNear(benchmark::State& state)
+{
+    std::unique_ptr<just::PhysicsWorld> world;
+    if (state.range(0) == 0) {
+        world = std::make_unique<just::Box2DWorld>();
+    } else {
+        world = std::make_unique<just::KinematicWorld>(just::KinematicWorld::Options{});
+    }
+
+    // A square lattice, 3m apart
+    int per_side = std::ceil(std::sqrt(state.range(1)));
+    std::vector<std::unique_ptr<just::PhysicsBody>> bodies;
+    for (int i = 0; i < state.range(1); ++i) {
+        float x = (i % per_side) * 3.0;
+        float y = (i / per_side) * 3.0;
+        bodies.push_back(world->create_body(
+            toml::table{{"shape", "circle"}, {"radius", 1.0}, {"x", x}, {"y", y}}));
+    }
+    world->step(0.01);
+
+    std::vector<const just::PhysicsBody*> near;
+    for (auto _ : state) {
+        for (const auto& body : bodies) {
+            near.clear();
+            world->bodies_near(body->position(), 10.0, body.get(), near);
+            benchmark::DoNotOptimize(near.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_BodiesNear)->ArgsProduct({{0, 1}, {100, 1000, 10000}});
+
+} // namespace
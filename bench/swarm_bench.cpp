@@ -0,0 +1,303 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "toml++/toml.hpp"
+
+#include "just/agent.hpp"
+#include "just/agent_system.hpp"
+#include "just/physics.hpp"
+#include "just/profiling.hpp"
+#include "just/scenario.hpp"
+
+// End to end scaling benchmark of the simulation.
+//
+// Generates swarm worlds (in the style of config/swarm.toml) for every combination of the swept
+// parameters, runs each for a fixed number of steps and prints one CSV row per world:
+//
+//   agents, grid, beams, obstacles, batched, backend, agent, steps,
+//   steps_per_sec         simulation steps (all agents plus physics) per wall clock second
+//   agent_p50_us/p99_us   latency of a single agent's step (the AgentSystem step divided by the
+//                         number of agents when batched)
+//   control_ms/physics_ms mean time per step spent stepping the agents and the world respectively
+//   peak_rss_mib          peak resident memory, each world is run in a child process of its own
+//
+// Usage: just_swarm_bench [--agents 1,10,100,1000] [--grid 200,1000] [--beams 24]
+//                         [--obstacles 0,1000] [--steps 500] [--seed 42] [--batched]
+//                         [--backend box2d|kinematic] [--agent vfh|dwa]
+//
+// Comparing control and physics time shows whether the physics or the agents stop scaling first,
+// and running both backends how much the kinematic world (see KinematicWorld) buys back. Running
+// both agent types compares the VFH and DWA (see DynamicWindow) planners on the same worlds. For
+// where the agents' time goes (sensing, map updates or planning), build with
+// JUST_ENABLE_PROFILING, though note every agent then prints its own report.
+
+namespace
+{
+
+struct Point
+{
+    size_t agents;
+    unsigned grid;
+    unsigned beams;
+    size_t obstacles;
+};
+
+struct Options
+{
+    std::vector<size_t> agents{1, 10, 100, 1000};
+    std::vector<size_t> grids{200, 1000};
+    std::vector<size_t> beams{24};
+    std::vector<size_t> obstacles{0, 1000};
+    size_t steps{500};
+    unsigned seed{42};
+    bool batched{false};
+    std::string backend{"box2d"};
+    std::string agent{"vfh"};
+};
+
+constexpr float DELTA_T = 1.0 / 50.0;
+constexpr size_t WARMUP_STEPS = 10;
+// Agents and obstacles are placed on a lattice this far apart, so none start out touching
+constexpr float SPACING = 3.0;
+
+std::vector<size_t> parse_list(const std::string& list)
+{
+    std::vector<size_t> values;
+    std::stringstream stream(list);
+    std::string value;
+    while (std::getline(stream, value, ',')) {
+        values.push_back(std::stoul(value));
+    }
+    if (values.empty()) {
+        throw std::invalid_argument("Empty list of values");
+    }
+    return values;
+}
+
+// A swarm world of the given size (see ScenarioGenerator): agents and obstacles at random (but
+// seeded) spots of a lattice covering the grid, each agent heading for the point opposite it
+// through the origin so that traffic crosses in the middle.
+toml::table generate_world(const Point& point, const Options& options)
+{
+    // Agents need their whole active window within the grid, so keep clear of its edges
+    float size = point.grid - 2.0 * just::VFHAgent::WINDOW_SIZE;
+    if (size < 2.0 * SPACING) {
+        throw std::invalid_argument("Grid too small for the active window");
+    }
+
+    just::ScenarioGenerator::Options scenario;
+    scenario.seed = options.seed;
+    scenario.size = size;
+    scenario.spacing = SPACING;
+    scenario.agents = point.agents;
+    scenario.obstacles = point.obstacles;
+    scenario.agent = toml::table{
+        {"type", options.agent},
+        {"grid", toml::table{{"width", point.grid}, {"height", point.grid}}},
+        {"sensor", toml::table{{"count", point.beams}, {"range", 25.0}}},
+    };
+    just::ScenarioGenerator generator(scenario);
+
+    toml::table config = generator.to_config(generator.generate());
+    config.insert(
+        "world",
+        toml::table{{"width", point.grid}, {"height", point.grid}, {"backend", options.backend}});
+    return config;
+}
+
+double peak_rss_mib()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in kilobytes on Linux
+    return usage.ru_maxrss / 1024.0;
+}
+
+// Runs one world and prints its CSV row
+void run(const Point& point, const Options& options)
+{
+    using Clock = std::chrono::steady_clock;
+
+    toml::table config = generate_world(point, options);
+    auto world = just::make_physics_world(*config["world"].as_table());
+
+    config["obstacles"].as_array()->for_each([&world](const toml::table& obstacle_config) {
+        world->add_obstacle(obstacle_config);
+    });
+
+    just::AgentSystem system(world.get());
+    std::vector<std::unique_ptr<just::Agent>> agents;
+    config["agents"].as_array()->for_each([&](const toml::table& agent_config) {
+        if (options.batched) {
+            system.add_vfh_agent(agent_config);
+        } else if (options.agent == "dwa") {
+            agents.push_back(std::make_unique<just::DWAAgent>(agent_config, world.get()));
+        } else {
+            agents.push_back(std::make_unique<just::VFHAgent>(agent_config, world.get()));
+        }
+    });
+
+    just::LatencyHistogram agent_latency;
+    Clock::duration control_time{0};
+    Clock::duration physics_time{0};
+
+    for (size_t step = 0; step < WARMUP_STEPS + options.steps; ++step) {
+        bool measured = step >= WARMUP_STEPS;
+
+        auto control_start = Clock::now();
+        if (options.batched) {
+            system.step(DELTA_T);
+            if (measured) {
+                auto elapsed = std::chrono::nanoseconds(Clock::now() - control_start);
+                agent_latency.record(elapsed.count() / point.agents);
+            }
+        } else {
+            for (auto& agent : agents) {
+                auto agent_start = Clock::now();
+                agent->step(DELTA_T);
+                if (measured) {
+                    agent_latency.record(
+                        std::chrono::nanoseconds(Clock::now() - agent_start).count());
+                }
+            }
+        }
+
+        auto physics_start = Clock::now();
+        world->step(DELTA_T);
+        auto physics_end = Clock::now();
+
+        if (measured) {
+            control_time += physics_start - control_start;
+            physics_time += physics_end - physics_start;
+        }
+    }
+
+    double total_seconds = std::chrono::duration<double>(control_time + physics_time).count();
+    auto mean_ms = [&options](Clock::duration time) {
+        return std::chrono::duration<double, std::milli>(time).count() / options.steps;
+    };
+
+    std::printf("%zu,%u,%u,%zu,%d,%s,%s,%zu,%.2f,%.2f,%.2f,%.3f,%.3f,%.1f\n",
+                point.agents,
+                point.grid,
+                point.beams,
+                point.obstacles,
+                options.batched,
+                options.backend.c_str(),
+                options.agent.c_str(),
+                options.steps,
+                options.steps / total_seconds,
+                agent_latency.percentile(0.5) / 1000.0,
+                agent_latency.percentile(0.99) / 1000.0,
+                mean_ms(control_time),
+                mean_ms(physics_time),
+                peak_rss_mib());
+    std::fflush(stdout);
+
+    // Agents hold on to bodies of the world, so go first
+    agents.clear();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--batched") {
+                options.batched = true;
+                continue;
+            }
+            if (i + 1 == argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--agents") {
+                options.agents = parse_list(value);
+            } else if (arg == "--grid") {
+                options.grids = parse_list(value);
+            } else if (arg == "--beams") {
+                options.beams = parse_list(value);
+            } else if (arg == "--obstacles") {
+                options.obstacles = parse_list(value);
+            } else if (arg == "--steps") {
+                options.steps = std::stoul(value);
+            } else if (arg == "--seed") {
+                options.seed = std::stoul(value);
+            } else if (arg == "--backend") {
+                if (value != "box2d" && value != "kinematic") {
+                    throw std::invalid_argument("Unknown backend " + value);
+                }
+                options.backend = value;
+            } else if (arg == "--agent") {
+                if (value != "vfh" && value != "dwa") {
+                    throw std::invalid_argument("Unknown agent type " + value);
+                }
+                options.agent = value;
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        if (options.batched && options.agent != "vfh") {
+            throw std::invalid_argument("Only VFH agents can be batched");
+        }
+    } catch (const std::exception& err) {
+        std::cerr << "Error: " << err.what() << "\n"
+                  << "Usage: just_swarm_bench [--agents 1,10,100,1000] [--grid 200,1000] "
+                  << "[--beams 24] [--obstacles 0,1000] [--steps 500] [--seed 42] [--batched] "
+                  << "[--backend box2d|kinematic] [--agent vfh|dwa]" << std::endl;
+        return 1;
+    }
+
+    std::printf("agents,grid,beams,obstacles,batched,backend,agent,steps,steps_per_sec,"
+                "agent_p50_us,agent_p99_us,control_ms,physics_ms,peak_rss_mib\n");
+    std::fflush(stdout);
+
+    int failures = 0;
+    for (size_t grid : options.grids) {
+        for (size_t beams : options.beams) {
+            for (size_t obstacles : options.obstacles) {
+                for (size_t agents : options.agents) {
+                    Point point{agents,
+                                static_cast<unsigned>(grid),
+                                static_cast<unsigned>(beams),
+                                obstacles};
+
+                    // A process per world, so the peak RSS is that of the world alone
+                    pid_t pid = fork();
+                    if (pid == 0) {
+                        try {
+                            run(point, options);
+                        } catch (const std::exception& err) {
+                            std::cerr << "Skipping " << agents << " agents, grid " << grid
+                                      << ", " << beams << " beams, " << obstacles
+                                      << " obstacles: " << err.what() << std::endl;
+                            _exit(1);
+                        }
+                        _exit(0);
+                    }
+
+                    int status = 0;
+                    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+                        || WEXITSTATUS(status) != 0) {
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    return failures == 0 ? 0 : 4;
+}
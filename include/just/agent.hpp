@@ -2,36 +2,53 @@
 #define __JUST__AGENT_HPP__
 
 #include <cmath>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string>
 
 #include "box2d/box2d.h"
 #include "toml++/toml.hpp"
-#include "highfive/highfive.hpp"
 
+#include "dwa.hpp"
+#include "physics.hpp"
 #include "world_model.hpp"
 #include "sensor.hpp"
+#include "profiling.hpp"
 
 namespace just
 {
 
+class Telemetry;
+class FlightRecorder;
+class DeadlineMonitor;
+class GlobalPlanner;
+class LiveStream;
+class LivePublisher;
+
 class Agent
 {
 public:
-    Agent(const toml::table& config, b2World* world);
-    virtual ~Agent();
+    // Throws if the 'shape' field is invalid (see PhysicsWorld::create_body)
+    Agent(const toml::table& config, PhysicsWorld* world);
+    virtual ~Agent() = default;
 
     virtual void step(float delta_t) = 0;
 
-    const b2Body* get_body() { return body_; }
+    // Write out the agent's in-memory history (see FlightRecorder), if it keeps one
+    virtual void dump_flight_recorder() {}
+
+    const PhysicsBody* get_body() const { return body_.get(); }
 
 protected:
-    b2Body* body_;
+    std::unique_ptr<PhysicsBody> body_;
 };
 
 class PatrolAgent : public Agent
 {
 public:
-    PatrolAgent(const toml::table& config, b2World* world);
+    PatrolAgent(const toml::table& config, PhysicsWorld* world);
 
     void step(float delta_t) override;
 private:
@@ -68,58 +85,136 @@ public:
 
     static constexpr size_t S_MAX = 18; // selected valley size, 18 in the paper
 
-
-    VFHAgent(const toml::table& config, b2World* world);
-
-    void step(float delta_t) override;
-
-private:
-    // Adapter class to make a subgrid more ergonomic to use
-    // TODO: not sure if this is the right place for this to live
-    class SubgridAdapter
+    struct SteeringCommand
     {
-    public:
-        SubgridAdapter() = delete;
-        explicit SubgridAdapter(std::array<uint8_t, WINDOW_SIZE_SQUARED>&& arr)
-            : arr_(std::move(arr)) {}
-
-        // NOTE: no bounds checking is done and an exception may be thrown
-        uint8_t at(int x, int y) {
-            return arr_.at(y * WINDOW_SIZE + x);
-        }
-    private:
-        std::array<uint8_t, WINDOW_SIZE_SQUARED> arr_;
+        float angle;
+        float speed;
     };
 
-    class Logger
+    // The phases of step(), as timed when built with JUST_ENABLE_PROFILING
+    enum Phase : size_t
     {
-    public:
-        Logger(const std::string& filename, unsigned grid_size);
-        void log_polar_histogram(const std::array<float, K>& polar_histogram);
-        void log_window(const std::array<uint8_t, WINDOW_SIZE_SQUARED>& window);
-        void log_full_grid(const HistogramGrid& grid);
-        void log_motion(float angle, float speed, float x, float y);
-    private:
-        std::unique_ptr<HighFive::File> file_;
-        size_t steering_idx_{0};
+        SENSE,
+        GRID_UPDATE,
+        PLANNING,
+        WINDOW,
+        POLAR_HISTOGRAM,
+        SMOOTHING,
+        STEERING,
+        LOGGING,
     };
 
-    struct SteeringCommand
-    {
-        float angle;
-        float speed;
-    };
+    // If given, logs go to the shared telemetry sink instead of a file of the agent's own, and
+    // every step is published to the live stream
+    VFHAgent(const toml::table& config,
+             PhysicsWorld* world,
+             Telemetry* telemetry = nullptr,
+             LiveStream* live_stream = nullptr);
+    ~VFHAgent() override;
+
+    void step(float delta_t) override;
+    void dump_flight_recorder() override;
+
+    // Per phase latencies, only populated when built with JUST_ENABLE_PROFILING (the report is
+    // also printed when the agent is destroyed)
+    const StepProfiler& profiler() const { return profiler_; }
+    // Null unless the agent has a 'deadline' table, see DeadlineMonitor
+    const DeadlineMonitor* deadline_monitor() const { return deadline_.get(); }
+    // The agent's map, e.g. for a live view of it (see GridOverlay)
+    HistogramGrid& grid() { return grid_; }
+
+    // The stages of the VFH pipeline, as free standing kernels.
+    // These operate on plain (contiguous) buffers so they can be shared between a lone VFHAgent
+    // and the batched AgentSystem, which keeps the state of many agents in flat arrays.
+    //
+    // The polar histogram is built in integer arithmetic: certainty values are small integers and
+    // the magnitude weights (A - B * d) are rounded to integers, so the sectors and their smoothing
+    // come out exactly the same on every compiler and CPU, and replays are deterministic. The
+    // smoothed histogram is integral, and handed on as float to the steering stage.
+
+    // Project a window of the histogram grid into (unsmoothed) polar sectors
+    static void project_window(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window,
+                               std::span<uint32_t, K> sectors);
+    // Smooth the polar histogram (equation 5 in the paper)
+    static void smooth_sectors(std::span<const uint32_t, K> sectors, std::span<float, K> smoothed);
+    // Sector containing the goal, given the goal in the agent's local frame
+    static size_t target_sector(b2Vec2 goal_local);
+    // Search for the selected valley and return the heading sector within it.
+    // Returns nullopt if every sector is above the valley threshold.
+    static std::optional<size_t> select_heading(std::span<const float, K> polar_histogram,
+                                                size_t k_target,
+                                                float valley_threshold);
+    // Turn a heading sector into a steering command
+    static SteeringCommand steering_command(std::span<const float, K> polar_histogram,
+                                            size_t heading,
+                                            float valley_threshold,
+                                            float v_max);
+
+private:
+    // Asynchronous HDF5 logger, see vfh_logger.hpp
+    class Logger;
 
     HistogramGrid grid_;
     UltrasonicArray sensor_;
     std::unique_ptr<Logger> logger_;
+    std::unique_ptr<FlightRecorder> recorder_;
+    std::unique_ptr<LivePublisher> live_;
+    std::unique_ptr<DeadlineMonitor> deadline_;
+    std::unique_ptr<GlobalPlanner> planner_;
+    // Steps went unlogged (shed), the next one logged logs the whole grid
+    bool grid_keyframe_due_{false};
+    // Number of the current step, counting from 0, the log tells the steps it skipped by it
+    uint64_t step_{0};
+    std::string name_;
     b2Vec2 goal_;
+    // Steered towards: the goal itself, or the planner's subgoal on the way there
+    b2Vec2 subgoal_;
     float valley_threshold_;
     float v_max_;
+    StepProfiler profiler_;
+    // The polar histogram of the last step that computed one, steered on when shedding load
+    std::optional<std::array<float, K>> last_polar_histogram_;
 
+    // Whether this step is logged, false without a logger or while shedding it
+    bool logging() const;
     void sense();
+    // Hand the planner the grid's changes and update the subgoal
+    void plan();
     std::optional<std::array<float, K>> create_polar_histogram();
     SteeringCommand compute_steering(const std::array<float, K>& polar_histogram);
+    // Hand the outcome of a step to whichever of the logger, flight recorder and live stream are
+    // enabled. 'polar_histogram' is null when the agent is stuck at the edge of the map.
+    void log_step(const std::array<float, K>* polar_histogram, SteeringCommand command);
+};
+
+// Drives like a unicycle (forward speed and turn rate) using the Dynamic Window Approach, see
+// DynamicWindow. Maps its surroundings into a HistogramGrid the same way VFHAgent does, so the two
+// can be compared on the same worlds.
+//
+// Like any purely local planner, DWA can get stuck in front of an obstacle squarely in its way. A
+// 'planner' table adds a GlobalPlanner, as for VFHAgent, whose subgoals lead it around.
+class DWAAgent : public Agent
+{
+public:
+    // Takes the same 'grid', 'sensor', 'goal', 'speed' and 'planner' fields as VFHAgent, plus an
+    // optional 'dwa' table (see DynamicWindow::options_from_config)
+    DWAAgent(const toml::table& config, PhysicsWorld* world);
+    ~DWAAgent() override;
+
+    void step(float delta_t) override;
+
+    const DynamicWindow& dynamic_window() const { return dwa_; }
+    // The agent's map, e.g. for a live view of it (see GridOverlay)
+    HistogramGrid& grid() { return grid_; }
+
+private:
+    HistogramGrid grid_;
+    UltrasonicArray sensor_;
+    DynamicWindow dwa_;
+    std::unique_ptr<GlobalPlanner> planner_;
+    b2Vec2 goal_;
+    DynamicWindow::Velocity velocity_;
+    std::array<uint8_t, DynamicWindow::WINDOW_SIZE_SQUARED> window_;
 };
 
 } // namespace just
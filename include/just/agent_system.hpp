@@ -0,0 +1,101 @@
+#ifndef __JUST__AGENT_SYSTEM_HPP__
+#define __JUST__AGENT_SYSTEM_HPP__
+
+#include <memory>
+#include <vector>
+
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+#include "agent.hpp"
+#include "physics.hpp"
+#include "world_model.hpp"
+#include "sensor.hpp"
+
+namespace just
+{
+
+// Batched VFH agents.
+//
+// Rather than stepping VFHAgents one at a time through a virtual call, the state of every agent
+// is kept in flat (structure of arrays) storage and each stage of the VFH pipeline is run across
+// all agents before moving on to the next. This keeps the hot data for a stage contiguous and
+// lets the compiler vectorize across agents, which matters for swarms of hundreds of agents.
+//
+// Behaviour matches VFHAgent (the same kernels are used), with the exception of logging and of
+// deadline monitoring (the stages run for all agents at once, there's no per agent step to time or
+// shed), neither of which is supported in batched mode. Flight recorders are.
+class AgentSystem
+{
+public:
+    // If given, every agent's steps are published to the live stream
+    explicit AgentSystem(PhysicsWorld* world, LiveStream* live_stream = nullptr);
+    ~AgentSystem();
+
+    AgentSystem(const AgentSystem&) = delete;
+    AgentSystem& operator=(const AgentSystem&) = delete;
+
+    // Add a VFH agent, using the same TOML config as VFHAgent.
+    // Returns the index of the new agent.
+    // Throws if the config asks for logging or a deadline, which aren't supported.
+    size_t add_vfh_agent(const toml::table& config);
+
+    void step(float delta_t);
+
+    // Write out the history of every agent that has a flight recorder
+    void dump_flight_recorders();
+
+    size_t size() const { return bodies_.size(); }
+    const PhysicsBody* get_body(size_t idx) const { return bodies_.at(idx).get(); }
+    HistogramGrid& grid(size_t idx) { return *grids_.at(idx); }
+
+private:
+    static constexpr size_t K = VFHAgent::K;
+    static constexpr size_t WINDOW_SIZE = VFHAgent::WINDOW_SIZE;
+    static constexpr size_t WINDOW_SIZE_SQUARED = VFHAgent::WINDOW_SIZE_SQUARED;
+
+    PhysicsWorld* world_;
+    LiveStream* live_stream_;
+
+    // Per agent configuration/state
+    std::vector<std::unique_ptr<PhysicsBody>> bodies_;
+    std::vector<b2Vec2> goals_;
+    std::vector<float> valley_thresholds_;
+    std::vector<float> v_maxs_;
+    std::vector<std::unique_ptr<HistogramGrid>> grids_;
+    std::vector<UltrasonicArray> sensors_;
+    std::vector<std::unique_ptr<FlightRecorder>> recorders_;    // null if disabled
+    std::vector<std::unique_ptr<GlobalPlanner>> planners_;      // null if disabled
+    std::vector<std::unique_ptr<LivePublisher>> publishers_;    // null without a live stream
+
+    // Per step scratch buffers, indexed by agent
+    std::vector<int> cell_x_;
+    std::vector<int> cell_y_;
+    std::vector<size_t> target_sectors_;
+    std::vector<uint8_t> window_valid_;
+    std::vector<uint8_t> windows_;              // WINDOW_SIZE_SQUARED per agent
+    std::vector<uint32_t> sectors_;             // K per agent
+    std::vector<float> polar_histograms_;       // K per agent
+    std::vector<VFHAgent::SteeringCommand> commands_;
+
+    // The stages of the pipeline, each run across every agent
+    void gather_poses();
+    void sense();
+    // Steer agents with a global planner towards its subgoal rather than the goal
+    void plan();
+    void extract_windows();
+    void project();
+    void smooth();
+    void steer();
+    void apply_commands();
+    void record(float delta_t);
+    void publish();
+
+    std::span<uint8_t, WINDOW_SIZE_SQUARED> window(size_t idx);
+    std::span<uint32_t, K> sectors(size_t idx);
+    std::span<float, K> polar_histogram(size_t idx);
+};
+
+} // namespace just
+
+#endif // __JUST__AGENT_SYSTEM_HPP__
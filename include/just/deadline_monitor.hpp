@@ -0,0 +1,75 @@
+#ifndef __JUST__DEADLINE_MONITOR_HPP__
+#define __JUST__DEADLINE_MONITOR_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "toml++/toml.hpp"
+
+namespace just
+{
+
+// Watches how long an agent's control steps take against a time budget, and decides how much
+// optional work the agent should shed to stay within it.
+//
+// A step that takes longer than the budget is an overrun. After 'escalate_after' overruns in a row
+// the shed level goes up by one, after 'recover_after' steps in a row within budget it goes back
+// down by one. Levels are cumulative: an agent shedding at REDUCE_BEAMS also skips logging.
+class DeadlineMonitor
+{
+public:
+    enum class ShedLevel : uint8_t
+    {
+        NONE,
+        SKIP_LOGGING,               // no HDF5 logging (flight recorder and live stream are kept)
+        REDUCE_BEAMS,               // fire a fraction of the sensor beams per step
+        CACHED_POLAR_HISTOGRAM,     // steer on the previous step's polar histogram
+    };
+
+    struct Options
+    {
+        // Seconds a step may take
+        float budget{0.01};
+        // Consecutive overruns before shedding more work
+        unsigned escalate_after{3};
+        // Consecutive steps within budget before shedding less work
+        unsigned recover_after{100};
+        // Fraction of the beams fired per step at REDUCE_BEAMS
+        float beam_fraction{0.5};
+    };
+
+    // Read the options from an agent's 'deadline' table.
+    // Returns nullopt if the agent doesn't have one (no deadline is enforced).
+    static std::optional<Options> options_from_config(const toml::table& agent_config);
+
+    explicit DeadlineMonitor(Options options);
+
+    // Account for a finished step. Returns true if the shed level changed.
+    bool record(std::chrono::nanoseconds step_time);
+
+    ShedLevel level() const { return level_; }
+    // Whether the work shed at 'level' is currently being shed
+    bool shedding(ShedLevel level) const { return level_ >= level; }
+
+    const Options& options() const { return options_; }
+    uint64_t steps() const { return steps_; }
+    uint64_t overruns() const { return overruns_; }
+    std::chrono::nanoseconds worst() const { return worst_; }
+
+    static const char* level_name(ShedLevel level);
+
+private:
+    Options options_;
+    std::chrono::nanoseconds budget_;
+    ShedLevel level_{ShedLevel::NONE};
+    unsigned consecutive_overruns_{0};
+    unsigned consecutive_within_budget_{0};
+    uint64_t steps_{0};
+    uint64_t overruns_{0};
+    std::chrono::nanoseconds worst_{0};
+};
+
+} // namespace just
+
+#endif // __JUST__DEADLINE_MONITOR_HPP__
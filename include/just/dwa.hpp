@@ -0,0 +1,120 @@
+#ifndef __JUST__DWA_HPP__
+#define __JUST__DWA_HPP__
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+namespace just
+{
+
+// Dynamic Window Approach (Fox, Burgard & Thrun, 1997) local planner, for unicycle agents driven by
+// a forward speed and a turn rate.
+//
+// Every step, the velocities reachable within one control period (the dynamic window) are sampled
+// on a lattice and each is forward simulated as an arc over 'horizon' seconds. Arcs are scored
+// against a window of the agent's HistogramGrid: how well they end up facing the goal, how far
+// they stay from obstacles and how much closer to the goal they get. Rewarding progress rather than
+// speed alone (as in the original paper) keeps the agent from slowly creeping straight up to an
+// obstacle in its way. Arcs that come within 'radius' of an obstacle, or
+// couldn't brake in time before one, are discarded.
+//
+// Rollouts are independent of each other, so they're evaluated as a batch: the state of every arc
+// is kept in flat (structure of arrays) storage and each integration step is run across all of
+// them before moving on to the next, which lets the compiler vectorize across samples. The step
+// itself is one of the dispatched kernels (see kernels.hpp), run with the widest vectors the CPU
+// has.
+class DynamicWindow
+{
+public:
+    // Side of the (square) grid window arcs are scored in, the same as VFH's active window
+    static constexpr size_t WINDOW_SIZE = 30;
+    static constexpr size_t WINDOW_SIZE_SQUARED = WINDOW_SIZE * WINDOW_SIZE;
+
+    struct Options
+    {
+        // Lattice of samples over the dynamic window, speeds by turn rates. An odd number of turn
+        // rates includes keeping the current one.
+        unsigned speed_samples{8};
+        unsigned turn_samples{25};
+        // Length of the simulated arcs and their integration step, in seconds
+        float horizon{2.0};
+        float time_step{0.1};
+
+        // Limits, in meters (grid cells) and radians per second (squared)
+        float max_speed{1.0};
+        float max_accel{5.0};
+        float max_turn_rate{2.0};
+        float max_turn_accel{8.0};
+
+        // Certainty at which a grid cell counts as an obstacle
+        unsigned threshold{6};
+        // Clearance the agent needs from the center of an obstacle cell, at least its own radius
+        // plus half a cell
+        float radius{1.5};
+
+        // Weights of the objective
+        float heading_weight{0.2};
+        float clearance_weight{0.5};
+        float progress_weight{1.0};
+    };
+
+    struct Velocity
+    {
+        float speed{0.0};
+        float turn_rate{0.0};
+    };
+
+    // Read the options from an agent's 'dwa' table, with 'max_speed' taken from the agent's
+    // 'speed'. Anything missing keeps its default.
+    static Options options_from_config(const toml::table& agent_config);
+
+    explicit DynamicWindow(Options options);
+
+    // Choose the velocity to command next.
+    // 'window' is the grid around the agent's cell (see HistogramGrid::copy_subgrid) and 'offset'
+    // the agent's position within that cell. 'heading' is in the world frame, as is 'goal', given
+    // relative to the agent. 'current' is the velocity the agent is moving at and 'delta_t' the
+    // control period, which together bound the dynamic window.
+    // Returns nullopt if every sampled arc collides.
+    std::optional<Velocity> choose(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window,
+                                   b2Vec2 offset,
+                                   float heading,
+                                   Velocity current,
+                                   b2Vec2 goal,
+                                   float delta_t);
+
+    const Options& options() const { return options_; }
+    size_t sample_count() const { return speed_.size(); }
+    // Distance of every window cell to the nearest obstacle cell, as of the last choose()
+    std::span<const float, WINDOW_SIZE_SQUARED> clearance_map() const { return distance_; }
+
+private:
+    Options options_;
+    size_t rollout_steps_;
+    std::array<float, WINDOW_SIZE_SQUARED> distance_;
+
+    // Per sample rollout state
+    std::vector<float> speed_;
+    std::vector<float> turn_rate_;
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> cos_;
+    std::vector<float> sin_;
+    std::vector<float> cos_step_;
+    std::vector<float> sin_step_;
+    std::vector<float> clearance_;
+
+    void compute_distances(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window);
+    void sample(Velocity current, float delta_t);
+    void rollout(b2Vec2 offset, float heading);
+};
+
+} // namespace just
+
+#endif // __JUST__DWA_HPP__
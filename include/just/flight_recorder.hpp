@@ -0,0 +1,107 @@
+#ifndef __JUST__FLIGHT_RECORDER_HPP__
+#define __JUST__FLIGHT_RECORDER_HPP__
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "toml++/toml.hpp"
+
+#include "agent.hpp"
+
+namespace just
+{
+
+// Keeps the last few seconds of a VFH agent's internals in memory, and only writes them to disk
+// when something goes wrong.
+//
+// Recording a step is a copy into a preallocated ring, so a recorder can be left on for every
+// agent of a swarm where full logging would be far too expensive. A dump is written synchronously
+// (it is a rare event), in the same layout as the Logger but with a per step time in place of
+// agent_steps, as every step is recorded:
+//   vfh_agent/time               double [steps], seconds since the recorder was created
+//   vfh_agent/flags              uint8 [steps], which of the below were recorded for each step
+//   vfh_agent/window_histogram   uint8 [WINDOW_SIZE_SQUARED, steps]
+//   vfh_agent/polar_histogram    float [K, steps]
+//   vfh_agent/packed_motion      float [4, steps] (angle, speed, x, y)
+// Columns of steps that didn't record a window/polar histogram (edge of the map) are zeroed.
+class FlightRecorder
+{
+public:
+    static constexpr size_t K = VFHAgent::K;
+    static constexpr size_t WINDOW_SIZE_SQUARED = VFHAgent::WINDOW_SIZE_SQUARED;
+
+    enum Flags : uint8_t
+    {
+        WINDOW = 1 << 0,
+        POLAR_HISTOGRAM = 1 << 1,
+        MOTION = 1 << 2,
+    };
+
+    struct Options
+    {
+        // Seconds of history to keep
+        float duration{10.0};
+        // Highest rate the agent is expected to step at, sizes the ring
+        float max_rate{100.0};
+        // Minimum number of seconds between triggered dumps
+        float cooldown{5.0};
+        // Where dumps are written, as flight_<n>_<reason>.h5
+        std::string directory;
+    };
+
+    // Read the options from an agent's 'flight_recorder' table.
+    // Returns nullopt if the agent doesn't have one (the recorder is disabled).
+    static std::optional<Options> options_from_config(const toml::table& agent_config);
+
+    explicit FlightRecorder(Options options);
+
+    // Start recording a new step, overwriting the oldest one if the ring is full
+    void begin_step(float delta_t);
+    void record_window(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window);
+    void record_polar_histogram(std::span<const float, K> polar_histogram);
+    void record_motion(float angle, float speed, float x, float y);
+    // Finish the step. Triggers a dump when the agent has just become stuck (a zero speed
+    // command) or has just run into something.
+    void end_step(bool stuck, bool in_contact);
+
+    // Dump unless a dump happened within the last 'cooldown' seconds.
+    // Returns the file written, if any.
+    std::optional<std::string> trigger(std::string_view reason);
+    // Dump the recorded history right away, regardless of the cooldown
+    std::string dump(std::string_view reason);
+
+    size_t size() const { return count_; }
+    size_t capacity() const { return records_.size(); }
+    double time() const { return time_; }
+
+private:
+    struct Record
+    {
+        double time;
+        uint8_t flags;
+        std::array<uint8_t, WINDOW_SIZE_SQUARED> window;
+        std::array<float, K> polar_histogram;
+        std::array<float, 4> motion;
+    };
+
+    Options options_;
+    std::vector<Record> records_;
+    size_t head_{0};    // slot of the next record
+    size_t count_{0};
+    double time_{0.0};
+
+    bool was_stuck_{false};
+    bool was_in_contact_{false};
+    std::optional<double> last_dump_;
+    unsigned dump_count_{0};
+
+    Record& current();
+};
+
+} // namespace just
+
+#endif // __JUST__FLIGHT_RECORDER_HPP__
@@ -0,0 +1,130 @@
+#ifndef __JUST__GLOBAL_PLANNER_HPP__
+#define __JUST__GLOBAL_PLANNER_HPP__
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <span>
+#include <vector>
+
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+#include "world_model.hpp"
+
+namespace just
+{
+
+// Incremental global planner over an agent's HistogramGrid, handing VFH intermediate subgoals so
+// that it routes around dead ends rather than steering straight at the goal.
+//
+// The grid is downsampled into square blocks of 'cell_size' cells, a block being blocked when any
+// of its cells has a certainty of at least 'threshold'. Unknown space is assumed to be free.
+// Planning uses D* Lite (Koenig & Likhachev, 2002), which searches backwards from the goal: as the
+// agent moves and blocks change, only the part of the search affected by the changed blocks is
+// repaired, rather than replanning from scratch. Changes are fed in from the grid's change
+// tracking, so they cost O(changed cells) to take in.
+class GlobalPlanner
+{
+public:
+    struct Options
+    {
+        // Side of a block, in grid cells
+        unsigned cell_size{10};
+        // Certainty at which a grid cell counts as an obstacle
+        unsigned threshold{6};
+        // Distance along the path at which the subgoal is placed, in meters (grid cells)
+        float lookahead{10.0};
+    };
+
+    // Read the options from an agent's 'planner' table.
+    // Returns nullopt if the agent doesn't have one (no global planning).
+    static std::optional<Options> options_from_config(const toml::table& agent_config);
+
+    // 'goal' in world coordinates. The grid's current contents are taken in right away.
+    GlobalPlanner(Options options, const HistogramGrid& grid, b2Vec2 goal);
+
+    // Take in changed grid cells, given as indices into grid.data() (see
+    // HistogramGrid::changed_cells). Cells may be repeated.
+    void update_cells(const HistogramGrid& grid, std::span<const uint32_t> changed_cells);
+
+    // Repair the plan for an agent at 'position' and return the point to steer towards: 'lookahead'
+    // along the path, or the goal itself once it is closer than that or when there is no path.
+    b2Vec2 subgoal(b2Vec2 position);
+
+    // Whether the last subgoal() found a path to the goal
+    bool has_path() const { return has_path_; }
+    unsigned blocks_wide() const { return blocks_x_; }
+    unsigned blocks_high() const { return blocks_y_; }
+    bool blocked(unsigned bx, unsigned by) const { return blocked_counts_[bx + by * blocks_x_]; }
+    // Total block expansions of the search so far, to gauge how much repairing costs
+    uint64_t expansions() const { return expansions_; }
+
+private:
+    // Path costs are integers, 10 for a straight move and 14 for a diagonal one, so that the many
+    // equally good paths of a grid tie exactly rather than to within rounding
+    using Cost = uint32_t;
+
+    struct Key
+    {
+        uint64_t k1;
+        uint64_t k2;
+
+        auto operator<=>(const Key&) const = default;
+    };
+
+    struct Entry
+    {
+        Key key;
+        uint32_t block;
+
+        bool operator>(const Entry& other) const { return key > other.key; }
+    };
+
+    Options options_;
+    int x_min_;
+    int y_min_;
+    unsigned width_;
+    unsigned height_;
+    unsigned blocks_x_;
+    unsigned blocks_y_;
+
+    // Per grid cell, whether it was an obstacle as of the last update
+    std::vector<bool> occupied_;
+    // Per block, the number of occupied grid cells within it
+    std::vector<uint32_t> blocked_counts_;
+    // Blocks that switched between free and blocked since the last subgoal()
+    std::vector<uint32_t> changed_blocks_;
+
+    b2Vec2 goal_;
+    uint32_t goal_block_;
+    std::optional<uint32_t> last_start_;
+    uint64_t km_{0};
+    std::vector<Cost> g_;
+    std::vector<Cost> rhs_;
+    // Lazily updated: entries are only checked against the block's key when popped
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open_;
+    bool has_path_{false};
+    uint64_t expansions_{0};
+
+    uint32_t block_of(b2Vec2 position) const;
+    b2Vec2 center_of(uint32_t block) const;
+    bool is_blocked(uint32_t block) const { return blocked_counts_[block] && block != goal_block_; }
+    Cost heuristic(uint32_t a, uint32_t b) const;
+    // Cost of moving from block 'a' to its neighbour 'b'
+    Cost cost(uint32_t a, uint32_t b) const;
+    Key key(uint32_t block, uint32_t start) const;
+
+    // Calls fn(neighbour, cost of the move) for each of the (up to 8) neighbours of 'block',
+    // regardless of whether they're blocked
+    template <typename Fn>
+    void for_each_neighbour(uint32_t block, Fn&& fn) const;
+
+    void update_vertex(uint32_t block, uint32_t start);
+    void compute_shortest_path(uint32_t start);
+};
+
+} // namespace just
+
+#endif // __JUST__GLOBAL_PLANNER_HPP__
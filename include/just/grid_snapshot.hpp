@@ -0,0 +1,50 @@
+#ifndef __JUST__GRID_SNAPSHOT_HPP__
+#define __JUST__GRID_SNAPSHOT_HPP__
+
+#include <cstdint>
+#include <vector>
+
+#include "world_model.hpp"
+
+namespace just
+{
+
+// A copy of a HistogramGrid as of some step, for another thread (e.g. rendering) to read while
+// the simulation carries on with the grid itself.
+//
+// Every tile (see HistogramGrid::TILE_SIZE) has a version, bumped whenever the tile changes. A
+// reader that remembers the versions it last saw can tell which tiles changed since, even across
+// snapshots it skipped.
+struct GridSnapshot
+{
+    unsigned width{0};
+    unsigned height{0};
+    unsigned tiles_wide{0};
+    int x_min{0};
+    int y_min{0};
+    std::vector<uint8_t> cells;
+    std::vector<uint64_t> tile_versions;
+};
+
+// Writes GridSnapshots of a grid, copying only the tiles that changed since the snapshot being
+// written was last brought up to date. Snapshots are meant to be reused (as in a TripleBuffer),
+// after the first write to a snapshot the cost is that of the changed tiles.
+class GridSnapshotter
+{
+public:
+    // Turns on dirty tile tracking of 'grid', which must outlive the snapshotter
+    explicit GridSnapshotter(HistogramGrid& grid);
+
+    // Bring 'snapshot' up to date with the grid.
+    // Returns the number of tiles copied.
+    size_t write(GridSnapshot& snapshot);
+
+private:
+    HistogramGrid* grid_;
+    uint64_t version_{1};
+    std::vector<uint64_t> tile_versions_;
+};
+
+} // namespace just
+
+#endif // __JUST__GRID_SNAPSHOT_HPP__
@@ -0,0 +1,70 @@
+#ifndef __JUST__KERNELS_HPP__
+#define __JUST__KERNELS_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace just
+{
+
+// Runtime CPU feature dispatch of the hot mapping and planning loops.
+//
+// Every kernel is compiled once per instruction set (through GCC/Clang target attributes, the rest
+// of the build stays at the baseline ISA) and the best variant the host supports is picked the
+// first time kernels() is called. One binary thus gets the widest vectors of whichever machine it
+// runs on. The JUST_ISA environment variable ("scalar", "sse4.2", "avx2" or "avx512") caps the
+// choice, e.g. to compare variants or rule one out.
+//
+// Variants are the same source compiled for different targets. The VFH kernels are integer only,
+// and the rest are built without floating point contraction (see CMakeLists.txt), so they produce
+// bit for bit the same results as the scalar reference, which a test checks every variant the host
+// supports against on random inputs.
+enum class Isa : uint8_t
+{
+    SCALAR,     // the baseline the rest of the build targets
+    SSE4_2,
+    AVX2,
+    AVX512,     // F, BW and VL
+};
+
+struct Kernels
+{
+    // VFHAgent::project_window over a window of 'cells' cells, given each cell's sector and
+    // weight. 'sectors' must be zeroed.
+    void (*project_window)(const uint8_t* window,
+                           const uint8_t* sector,
+                           const uint16_t* weight,
+                           size_t cells,
+                           uint32_t* sectors);
+    // VFHAgent::smooth_sectors
+    void (*smooth_sectors)(const uint32_t* sectors, float* smoothed);
+    // One integration step of 'n' DynamicWindow rollouts, see DynamicWindow::rollout
+    void (*rollout_step)(size_t n,
+                         float dt,
+                         const float* speed,
+                         const float* cos_step,
+                         const float* sin_step,
+                         float* cosine,
+                         float* sine,
+                         float* x,
+                         float* y);
+};
+
+// The kernels in use, selected on the first call
+const Kernels& kernels();
+Isa active_isa();
+
+// The variants of this host, in increasing order of preference (SCALAR is always there)
+std::vector<Isa> supported_isas();
+// The variant for 'isa', or null if this build or host doesn't have it
+const Kernels* kernels_for(Isa isa);
+
+const char* isa_name(Isa isa);
+std::optional<Isa> isa_from_name(std::string_view name);
+
+} // namespace just
+
+#endif // __JUST__KERNELS_HPP__
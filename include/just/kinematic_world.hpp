@@ -0,0 +1,107 @@
+#ifndef __JUST__KINEMATIC_WORLD_HPP__
+#define __JUST__KINEMATIC_WORLD_HPP__
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+#include "physics.hpp"
+#include "spatial_hash.hpp"
+
+namespace just
+{
+
+// A lightweight world for large swarms, in place of full Box2D dynamics.
+//
+// Agents are velocity commanded and obstacles static, so bodies are simply moved by their commanded
+// velocities each step and then pushed out of whatever they overlap. Obstacles are circles and
+// (rotated) boxes, agent bodies are treated as circles, boxes by their circumscribed circle.
+// Overlaps are resolved against obstacles fully and between agents by moving both apart equally,
+// a few iterations per step. There is no mass, friction or restitution.
+//
+// Obstacles and agents are each kept in a SpatialHash (the agents' rebuilt every step), which both
+// collision detection and sensor raycasts use to only test nearby shapes.
+class KinematicWorld : public PhysicsWorld
+{
+public:
+    struct Options
+    {
+        // Side of a spatial hash cell, in meters. Around the size of an agent works well.
+        float cell_size{4.0};
+        // Collision resolution passes per step
+        unsigned iterations{2};
+    };
+
+    // Read the options from a [world] table's 'kinematic' table (defaults if there is none)
+    static Options options_from_config(const toml::table& world_config);
+
+    explicit KinematicWorld(Options options);
+    ~KinematicWorld() override;
+
+    std::unique_ptr<PhysicsBody> create_body(const toml::table& config) override;
+    bool add_obstacle(const toml::table& config) override;
+    size_t add_occupancy_map(const OccupancyMap& map) override;
+    void step(float delta_t) override;
+    std::optional<float> raycast(b2Vec2 from, b2Vec2 to, const PhysicsBody* ignore) override;
+    void bodies_near(b2Vec2 center,
+                     float radius,
+                     const PhysicsBody* ignore,
+                     std::vector<const PhysicsBody*>& bodies) override;
+    std::optional<BodyHit> raycast_bodies(b2Vec2 from,
+                                          b2Vec2 to,
+                                          const PhysicsBody* ignore) override;
+
+    size_t body_count() const { return bodies_.size(); }
+    size_t obstacle_count() const { return obstacles_.size(); }
+
+private:
+    class Body;
+
+    struct Obstacle
+    {
+        b2Vec2 center;
+        b2Rot rotation;
+        // For boxes, zero for circles
+        b2Vec2 half_extents;
+        // For circles, zero for boxes
+        float radius;
+    };
+
+    Options options_;
+
+    // Per body state, indexed by Body::index_ (removal swaps the last body into the gap)
+    std::vector<Body*> bodies_;
+    std::vector<b2Vec2> positions_;
+    std::vector<float> angles_;
+    std::vector<b2Vec2> velocities_;
+    std::vector<float> angular_velocities_;
+    std::vector<float> radii_;
+    std::vector<uint8_t> contacts_;
+    std::vector<b2AABB> body_boxes_;
+    SpatialHash body_hash_;
+    bool bodies_dirty_{false};
+
+    std::vector<Obstacle> obstacles_;
+    std::vector<b2AABB> obstacle_boxes_;
+    SpatialHash obstacle_hash_;
+    bool obstacles_dirty_{false};
+
+    void remove_body(size_t index);
+    void rebuild_body_hash();
+    // Closest body on the segment, as a fraction of it (> 1 if none), and its index
+    float raycast_body_hash(b2Vec2 from, b2Vec2 to, const PhysicsBody* ignore, size_t& index);
+    void resolve_collisions();
+
+    // Fraction along p1 to p2 at which the segment enters the shape, > 1 if it doesn't
+    static float raycast_circle(b2Vec2 p1, b2Vec2 p2, b2Vec2 center, float radius);
+    static float raycast_obstacle(b2Vec2 p1, b2Vec2 p2, const Obstacle& obstacle);
+    // Push a circle out of an obstacle, returns true if they overlapped
+    static bool push_out(b2Vec2& center, float radius, const Obstacle& obstacle);
+};
+
+} // namespace just
+
+#endif // __JUST__KINEMATIC_WORLD_HPP__
@@ -0,0 +1,144 @@
+#ifndef __JUST__LIVE_STREAM_HPP__
+#define __JUST__LIVE_STREAM_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "agent.hpp"
+
+namespace just
+{
+
+// Live view of every agent's latest step, published through POSIX shared memory so external
+// tools (see notebooks/live_plot.py) can watch a run as it happens.
+//
+// The segment holds a header followed by one fixed size slot per agent. Each slot is guarded by
+// a seqlock: the publisher bumps the slot's sequence to odd, copies the step in and bumps it back
+// to even. Readers copy the slot out and retry if the sequence was odd or changed underneath
+// them, so they can attach, read and detach at any time without ever blocking the simulation.
+// Only the latest step of each agent is kept, readers that fall behind simply skip steps.
+//
+// Every offset a reader needs is written to the header, so readers don't have to mirror the
+// C++ struct layout.
+struct LiveHeader
+{
+    static constexpr uint32_t MAGIC = 0x4a555354;   // "JUST"
+    static constexpr uint32_t VERSION = 1;
+
+    std::atomic<uint32_t> magic;    // written last, once the header is complete
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t slots_offset;
+    uint32_t k;
+    uint32_t window_size;
+    uint32_t name_size;
+    uint32_t name_offset;
+    uint32_t step_offset;
+    uint32_t flags_offset;
+    uint32_t motion_offset;
+    uint32_t polar_histogram_offset;
+    uint32_t window_offset;
+    std::atomic<uint32_t> slots_used;
+};
+
+struct alignas(64) LiveSlot
+{
+    static constexpr size_t NAME_SIZE = 32;
+
+    enum Flags : uint32_t
+    {
+        WINDOW = 1 << 0,
+        POLAR_HISTOGRAM = 1 << 1,
+        MOTION = 1 << 2,
+    };
+
+    // Everything guarded by the sequence, copied in/out as a whole
+    struct Data
+    {
+        std::array<char, NAME_SIZE> name;
+        uint64_t step;
+        uint32_t flags;
+        std::array<float, 4> motion;    // angle, speed, x, y
+        std::array<float, VFHAgent::K> polar_histogram;
+        std::array<uint8_t, VFHAgent::WINDOW_SIZE_SQUARED> window;
+    };
+
+    std::atomic<uint64_t> sequence;
+    Data data;
+};
+
+// Publishes one agent's steps into its slot. Data is staged locally over the course of a step
+// and copied into shared memory in one go by end_step(), keeping the write side of the seqlock
+// short.
+class LivePublisher
+{
+public:
+    LivePublisher(LiveSlot* slot, const std::string& agent_name);
+
+    void publish_window(std::span<const uint8_t, VFHAgent::WINDOW_SIZE_SQUARED> window);
+    void publish_polar_histogram(std::span<const float, VFHAgent::K> polar_histogram);
+    void publish_motion(float angle, float speed, float x, float y);
+    void end_step();
+
+private:
+    LiveSlot* slot_;
+    LiveSlot::Data staged_{};
+};
+
+// Owner of the shared memory segment, the segment is removed again when this is destroyed
+class LiveStream
+{
+public:
+    // 'name' is a POSIX shm name, e.g. "/just_live". Throws if the segment can't be created.
+    LiveStream(const std::string& name, size_t slot_count);
+    ~LiveStream();
+
+    LiveStream(const LiveStream&) = delete;
+    LiveStream& operator=(const LiveStream&) = delete;
+
+    // Claim the next free slot for an agent. Throws if every slot is taken.
+    LivePublisher add_publisher(const std::string& agent_name);
+
+    const std::string& name() const { return name_; }
+
+private:
+    std::string name_;
+    void* memory_;
+    size_t size_;
+    LiveHeader* header_;
+};
+
+// Attaches to a LiveStream from another process (or thread)
+class LiveStreamReader
+{
+public:
+    using Snapshot = LiveSlot::Data;
+
+    // Throws if there is no (complete) stream with this name
+    explicit LiveStreamReader(const std::string& name);
+    ~LiveStreamReader();
+
+    LiveStreamReader(const LiveStreamReader&) = delete;
+    LiveStreamReader& operator=(const LiveStreamReader&) = delete;
+
+    // Number of slots claimed by agents so far
+    size_t size() const;
+
+    // Copy out the latest step of an agent. Returns false if nothing has been published to the
+    // slot yet, or the publisher kept it busy for 'max_retries' attempts.
+    bool read(size_t slot, Snapshot& snapshot, unsigned max_retries = 100) const;
+
+private:
+    void* memory_;
+    size_t size_;
+    const LiveHeader* header_;
+    const LiveSlot* slots_;
+};
+
+} // namespace just
+
+#endif // __JUST__LIVE_STREAM_HPP__
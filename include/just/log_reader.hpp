@@ -0,0 +1,93 @@
+#ifndef __JUST__LOG_READER_HPP__
+#define __JUST__LOG_READER_HPP__
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "highfive/highfive.hpp"
+
+#include "agent.hpp"
+
+namespace just
+{
+
+// Reads back the per step records of a VFH agent log (see vfh_logger.hpp), or of a flight
+// recorder dump, which shares the layout.
+//
+// Motion is small (16 bytes a step) and needed for every step of a replay, so it is loaded up
+// front. Windows and polar histograms are streamed: they are read a block of steps at a time
+// (matching the chunking of the log) and only the block of the most recent step is kept, so
+// reading sequentially costs one HDF5 read per block and seeking anywhere costs at most one.
+//
+// Step i is the i-th logged step, i.e. the i-th column of the motion/window/polar histogram
+// datasets. Steps an agent spent stuck at the edge of the map, or shedding load, are not logged:
+// agent_steps() holds the agent's own step number of each, and find() looks them up by it.
+//
+// The full grid history of an agent's log (flight recorder dumps have none) is rebuilt on demand
+// from its keyframes and deltas, by the agent's step as well.
+class LogReader
+{
+public:
+    static constexpr size_t K = VFHAgent::K;
+    static constexpr size_t WINDOW_SIZE_SQUARED = VFHAgent::WINDOW_SIZE_SQUARED;
+    static constexpr size_t BLOCK_STEPS = 256;
+
+    struct Motion
+    {
+        float angle;
+        float speed;
+        float x;
+        float y;
+    };
+
+    // 'group' is the agent's name in a shared telemetry file, or "/" for an agent's own log
+    explicit LogReader(const std::string& filename, const std::string& group = "/");
+    ~LogReader();
+
+    LogReader(const LogReader&) = delete;
+    LogReader& operator=(const LogReader&) = delete;
+
+    // The agents (groups) of a shared telemetry file that hold a VFH agent log
+    static std::vector<std::string> agents(const std::string& filename);
+
+    size_t steps() const { return motion_.size(); }
+    const std::vector<Motion>& motion() const { return motion_; }
+    // Increasing. A flight recorder dump records every step, its i-th step is step i of the dump.
+    const std::vector<uint64_t>& agent_steps() const { return agent_steps_; }
+    // The last logged step at or before the agent's step 'agent_step' (the first logged step if
+    // there is none), by binary search. The log must not be empty.
+    size_t find(uint64_t agent_step) const;
+
+    // The returned spans are valid until the next call for a step in another block.
+    // Throws std::out_of_range if the step wasn't logged.
+    std::span<const float, K> polar_histogram(size_t step);
+    std::span<const uint8_t, WINDOW_SIZE_SQUARED> window(size_t step);
+
+    // Whether the log holds the full grid history
+    bool has_grid() const { return grid_ != nullptr; }
+    unsigned grid_width() const;
+    unsigned grid_height() const;
+    // The full grid (laid out as HistogramGrid::data()) as of the agent's step 'agent_step', i.e.
+    // after the last grid step logged at or before it.
+    // Throws std::out_of_range if the log has no grid history or none that early.
+    std::vector<uint8_t> grid(uint64_t agent_step);
+
+private:
+    template <typename T, size_t N>
+    class ColumnStream;
+    class GridHistory;
+
+    std::unique_ptr<HighFive::File> file_;
+    std::vector<Motion> motion_;
+    std::vector<uint64_t> agent_steps_;
+    std::unique_ptr<ColumnStream<float, K>> polar_histogram_;
+    std::unique_ptr<ColumnStream<uint8_t, WINDOW_SIZE_SQUARED>> window_;
+    std::unique_ptr<GridHistory> grid_;   // null without a grid history
+};
+
+} // namespace just
+
+#endif // __JUST__LOG_READER_HPP__
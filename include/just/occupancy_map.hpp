@@ -0,0 +1,73 @@
+#ifndef __JUST__OCCUPANCY_MAP_HPP__
+#define __JUST__OCCUPANCY_MAP_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+namespace just
+{
+
+// A map of static obstacles read from an occupancy image, such as a scanned floor plan.
+//
+// Every pixel is a square cell of 'resolution' meters, occupied when it is dark enough. The image's
+// bottom left corner sits at 'x', 'y' in the world, its top row being the far side in y (as the
+// image is viewed). Rather than one obstacle per occupied cell, the cells are merged into
+// rectangles (see rectangles()), so that even large maps only take a few thousand boxes.
+class OccupancyMap
+{
+public:
+    struct Options
+    {
+        // Side of a pixel, in meters
+        float resolution{0.1};
+        // World position of the image's bottom left corner
+        float x{0.0};
+        float y{0.0};
+        // Darkness (0 white to 1 black) above which a pixel is occupied
+        float occupied_threshold{0.5};
+        // Occupied pixels are light rather than dark
+        bool negate{false};
+    };
+
+    // Read the options from a [map] table
+    static Options options_from_config(const toml::table& map_config);
+
+    // Load an 8 bit binary (P5) or plain (P2) PGM image, or any image format raylib reads (PNG,
+    // BMP, ...), converted to grayscale.
+    // Throws if the file can't be read or parsed.
+    static OccupancyMap load(const std::string& path, Options options);
+
+    // From grayscale pixels, row major starting with the image's top row.
+    // Throws if there aren't width * height of them, or the resolution isn't positive.
+    OccupancyMap(unsigned width,
+                 unsigned height,
+                 const std::vector<uint8_t>& pixels,
+                 Options options);
+
+    unsigned width() const { return width_; }
+    unsigned height() const { return height_; }
+    const Options& options() const { return options_; }
+    // Whether the pixel at 'col', 'row' (from the image's top left corner) is occupied
+    bool occupied(unsigned col, unsigned row) const { return occupied_[col + row * width_]; }
+
+    // Cover the occupied cells with non-overlapping rectangles, in world coordinates.
+    // Greedy, in a single pass over the image: each cell not yet covered starts a rectangle that
+    // is grown right as far as the row allows, then down for as long as the rows below are
+    // occupied over its full width. Not minimal, but walls and rooms come out as one rectangle
+    // per straight stretch.
+    std::vector<b2AABB> rectangles() const;
+
+private:
+    Options options_;
+    unsigned width_;
+    unsigned height_;
+    std::vector<uint8_t> occupied_;
+};
+
+} // namespace just
+
+#endif // __JUST__OCCUPANCY_MAP_HPP__
@@ -0,0 +1,150 @@
+#ifndef __JUST__PHYSICS_HPP__
+#define __JUST__PHYSICS_HPP__
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+#include "occupancy_map.hpp"
+#include "spatial_hash.hpp"
+
+namespace just
+{
+
+// A body in a PhysicsWorld, as seen by agents: a pose they can read and velocities they command.
+//
+// Destroying the body removes it from its world, so bodies must not outlive their world.
+class PhysicsBody
+{
+public:
+    virtual ~PhysicsBody() = default;
+
+    virtual b2Vec2 position() const = 0;
+    virtual float angle() const = 0;
+
+    virtual void set_linear_velocity(b2Vec2 velocity) = 0;
+    virtual void set_angular_velocity(float omega) = 0;
+
+    // Whether the body is touching anything, as of the last world step
+    virtual bool in_contact() const = 0;
+
+    // Transforms between the body's frame and the world's
+    b2Vec2 local_point(b2Vec2 world_point) const
+    {
+        return b2MulT(b2Rot(angle()), world_point - position());
+    }
+    b2Vec2 world_point(b2Vec2 local_point) const
+    {
+        return position() + b2Mul(b2Rot(angle()), local_point);
+    }
+};
+
+// The simulated world agents live in: their bodies, static obstacles and sensor raycasts.
+//
+// Bodies and obstacles are described by the same TOML tables as in the configs: 'shape' ("circle"
+// or "box"), 'radius' or 'width'/'height', and the pose 'x', 'y', 'theta'.
+//
+// Both backends also keep the agents' bodies in a spatial hash, rebuilt in O(bodies) after the
+// bodies have moved, for proximity queries between agents that don't scale with the size of the
+// swarm.
+class PhysicsWorld
+{
+public:
+    struct BodyHit
+    {
+        const PhysicsBody* body;
+        float distance;
+    };
+
+    virtual ~PhysicsWorld() = default;
+
+    // Create the dynamic body of an agent.
+    // Throws if the 'shape' field is invalid.
+    virtual std::unique_ptr<PhysicsBody> create_body(const toml::table& config) = 0;
+
+    // Add a static obstacle.
+    // Returns false, adding nothing, if the 'shape' field is invalid.
+    virtual bool add_obstacle(const toml::table& config) = 0;
+
+    // Add the occupied parts of 'map' as static obstacles, one box per rectangle of
+    // OccupancyMap::rectangles().
+    // Returns the number of boxes added.
+    virtual size_t add_occupancy_map(const OccupancyMap& map) = 0;
+
+    virtual void step(float delta_t) = 0;
+
+    // Distance from 'from' to the closest body or obstacle on the segment to 'to', ignoring the
+    // given body (e.g. the one casting the ray) and anything 'from' is inside of.
+    // Returns nullopt if nothing is hit.
+    virtual std::optional<float> raycast(b2Vec2 from, b2Vec2 to, const PhysicsBody* ignore) = 0;
+
+    // Append the bodies (other than 'ignore') whose bounding circle is within 'radius' of
+    // 'center' to 'bodies'. Obstacles are not included.
+    virtual void bodies_near(b2Vec2 center,
+                             float radius,
+                             const PhysicsBody* ignore,
+                             std::vector<const PhysicsBody*>& bodies) = 0;
+
+    // The closest body (other than 'ignore') on the segment from 'from' to 'to', ignoring
+    // obstacles. Returns nullopt if no body is hit.
+    virtual std::optional<BodyHit> raycast_bodies(b2Vec2 from,
+                                                  b2Vec2 to,
+                                                  const PhysicsBody* ignore) = 0;
+};
+
+// Full rigid body dynamics with Box2D
+class Box2DWorld : public PhysicsWorld
+{
+public:
+    // 'cell_size' is that of the agents' spatial hash, in meters
+    explicit Box2DWorld(int velocity_iterations = 10,
+                        int position_iterations = 8,
+                        float cell_size = 4.0);
+
+    std::unique_ptr<PhysicsBody> create_body(const toml::table& config) override;
+    bool add_obstacle(const toml::table& config) override;
+    // All the boxes are fixtures of a single static body
+    size_t add_occupancy_map(const OccupancyMap& map) override;
+    void step(float delta_t) override;
+    std::optional<float> raycast(b2Vec2 from, b2Vec2 to, const PhysicsBody* ignore) override;
+    void bodies_near(b2Vec2 center,
+                     float radius,
+                     const PhysicsBody* ignore,
+                     std::vector<const PhysicsBody*>& bodies) override;
+    std::optional<BodyHit> raycast_bodies(b2Vec2 from,
+                                          b2Vec2 to,
+                                          const PhysicsBody* ignore) override;
+
+    b2World& b2world() { return world_; }
+
+private:
+    class Body;
+
+    b2World world_;
+    int velocity_iterations_;
+    int position_iterations_;
+
+    // Agent bodies, indexed by Body::index_ (removal swaps the last body into the gap)
+    std::vector<Body*> bodies_;
+    std::vector<float> radii_;
+    std::vector<b2Vec2> centers_;
+    std::vector<b2AABB> boxes_;
+    SpatialHash body_hash_;
+    // The hash is out of date (bodies were added, removed or stepped), rebuilt on the next query
+    bool bodies_dirty_{false};
+
+    void remove_body(size_t index);
+    void rebuild_body_hash();
+};
+
+// Create the world backend named by a [world] table's 'backend' field: "box2d" (the default) or
+// "kinematic" (see KinematicWorld, configured by a 'kinematic' table).
+// Throws if the backend is unknown.
+std::unique_ptr<PhysicsWorld> make_physics_world(const toml::table& world_config);
+
+} // namespace just
+
+#endif // __JUST__PHYSICS_HPP__
@@ -0,0 +1,118 @@
+#ifndef __JUST__PROFILING_HPP__
+#define __JUST__PROFILING_HPP__
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per phase timing of hot loops, compiled in with the JUST_ENABLE_PROFILING CMake option.
+//
+// Code is instrumented with the JUST_PROFILE_* macros below, which expand to nothing unless
+// JUST_ENABLE_PROFILING is defined, so the instrumentation costs nothing when disabled.
+#ifdef JUST_ENABLE_PROFILING
+#define JUST_PROFILE_CONCAT_(a, b) a##b
+#define JUST_PROFILE_CONCAT(a, b) JUST_PROFILE_CONCAT_(a, b)
+// Time the rest of the enclosing scope as (part of) the given phase
+#define JUST_PROFILE_PHASE(profiler, phase) \
+    ::just::StepProfiler::Scope JUST_PROFILE_CONCAT(just_profile_scope_, __LINE__)((profiler), \
+                                                                                  (phase))
+#define JUST_PROFILE_BEGIN_STEP(profiler) (profiler).begin_step()
+#define JUST_PROFILE_END_STEP(profiler) (profiler).end_step()
+#else
+#define JUST_PROFILE_PHASE(profiler, phase) do {} while (0)
+#define JUST_PROFILE_BEGIN_STEP(profiler) do {} while (0)
+#define JUST_PROFILE_END_STEP(profiler) do {} while (0)
+#endif
+
+namespace just
+{
+
+// Histogram of latencies (in nanoseconds) with log-linear buckets: each power of two is split
+// into 8 buckets, so percentiles are accurate to within 12.5%. Recording is O(1), the buckets are
+// only allocated on the first record.
+class LatencyHistogram
+{
+public:
+    void record(uint64_t nanoseconds);
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    // Upper bound of the bucket holding the p-th (0 to 1) percentile, 0 if empty
+    uint64_t percentile(double p) const;
+
+    void reset();
+
+private:
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    std::vector<uint32_t> buckets_;
+    uint64_t count_{0};
+    uint64_t max_{0};
+
+    static size_t bucket_of(uint64_t nanoseconds);
+    static uint64_t bucket_upper_bound(size_t bucket);
+};
+
+// Latency histograms of the phases of a step, and of the step as a whole.
+//
+// Time spent in a phase is summed over the step (a phase may be entered more than once) and
+// recorded when the step ends, so the histograms are of per step totals.
+class StepProfiler
+{
+public:
+    static constexpr size_t MAX_PHASES = 8;
+
+    class Scope
+    {
+    public:
+        Scope(StepProfiler& profiler, size_t phase)
+            : profiler_(profiler), phase_(phase), start_(Clock::now())
+        {
+        }
+        ~Scope() { profiler_.add(phase_, Clock::now() - start_); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StepProfiler& profiler_;
+        size_t phase_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // 'name' identifies the profiled object (e.g. the agent) in reports
+    StepProfiler(std::string name, std::initializer_list<const char*> phase_names);
+
+    void begin_step();
+    void end_step();
+    void add(size_t phase, std::chrono::nanoseconds duration);
+
+    size_t phases() const { return phase_names_.size(); }
+    const char* phase_name(size_t phase) const { return phase_names_.at(phase); }
+    const LatencyHistogram& histogram(size_t phase) const { return histograms_.at(phase); }
+    // The whole step, from begin_step() to end_step()
+    const LatencyHistogram& step_histogram() const { return step_histogram_; }
+
+    // A table of p50/p99/max (in microseconds) per phase
+    void report(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string name_;
+    std::vector<const char*> phase_names_;
+    std::array<LatencyHistogram, MAX_PHASES> histograms_;
+    std::array<std::chrono::nanoseconds, MAX_PHASES> current_{};
+    LatencyHistogram step_histogram_;
+    Clock::time_point step_start_;
+};
+
+} // namespace just
+
+#endif // __JUST__PROFILING_HPP__
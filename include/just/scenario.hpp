@@ -0,0 +1,127 @@
+#ifndef __JUST__SCENARIO_HPP__
+#define __JUST__SCENARIO_HPP__
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "box2d/box2d.h"
+#include "toml++/toml.hpp"
+
+namespace just
+{
+
+// The agents and obstacles of a generated world
+struct Scenario
+{
+    struct Agent
+    {
+        b2Vec2 start;
+        b2Vec2 goal;
+    };
+
+    // A circle if 'radius' is positive, otherwise an axis aligned box of 'size'
+    struct Obstacle
+    {
+        b2Vec2 center;
+        float radius;
+        b2Vec2 size;
+    };
+
+    std::vector<Agent> agents;
+    std::vector<Obstacle> obstacles;
+};
+
+// Procedural worlds for stress testing, too large to write by hand: hundreds of agents among
+// thousands of obstacles, reproducible from a seed.
+//
+// The world is a square centered on the origin, laid out as either
+//   "scatter"  circles and boxes at random spots of a lattice, agents at other spots of it
+//   "maze"     the walls of a corridor maze (with some loops), agents at the centers of its cells
+// Each agent heads for a goal assigned by 'goals':
+//   "opposite" the point opposite its start through the origin, so traffic crosses in the middle
+//   "center"   the origin
+//   "random"   a free spot of its own
+//   "exchange" where another agent started
+// Goals and starts are kept clear of obstacles.
+//
+// Worlds are generated in memory, and turned into the 'agents' and 'obstacles' arrays of a config
+// (which the demo takes as they are, see expand_scenario()) or written out as TOML. Random numbers
+// are drawn straight from a std::mt19937 rather than through the standard distributions, whose
+// results differ between standard libraries, so the same options generate the same world anywhere.
+class ScenarioGenerator
+{
+public:
+    struct Options
+    {
+        unsigned seed{42};
+        // Side of the world, in meters
+        float size{200.0};
+        // "scatter" or "maze"
+        std::string layout{"scatter"};
+        size_t agents{10};
+        // "opposite", "center", "random" or "exchange"
+        std::string goals{"opposite"};
+
+        // Scatter: distance between lattice spots, in meters, at least 2 as obstacles are up to
+        // 2 m across. Agents bigger than the spacing may start out touching each other.
+        float spacing{3.0};
+        // Scatter: number of obstacles, unless 'obstacle_density' is set
+        size_t obstacles{0};
+        // Scatter: fraction of the world's area to cover with obstacles (at most around 0.2)
+        float obstacle_density{0.0};
+
+        // Maze: width of a cell (corridor and wall), and of a wall, in meters
+        float corridor_width{8.0};
+        float wall_thickness{1.0};
+        // Maze: fraction of the walls of a perfect maze (one path between any two cells) to leave
+        // out, adding loops
+        float maze_loops{0.1};
+
+        // Fields of every agent (type, grid, sensor, speed, shape, ...), on top of defaults for a
+        // VFH agent with a grid covering the world. A 'name' is used as the prefix of the agents'.
+        toml::table agent;
+    };
+
+    // Read the options from a [scenario] table, whose 'agent' table is the agents' fields
+    static Options options_from_config(const toml::table& scenario_config);
+
+    // Throws if the layout or the goals are unknown, or the spacing too small
+    explicit ScenarioGenerator(Options options);
+
+    // The same options always generate the same scenario.
+    // Throws if the agents and obstacles asked for don't fit in the world.
+    Scenario generate() const;
+
+    // A config table holding the scenario's 'agents' and 'obstacles' arrays
+    toml::table to_config(const Scenario& scenario) const;
+
+private:
+    Options options_;
+
+    // Place the agents at spots of a lattice of 'side' by 'side', 'pitch' apart, marking their
+    // starts and goals as reserved. Returns all the spots, shuffled.
+    std::vector<uint32_t> place_agents(std::mt19937& rng,
+                                       uint32_t side,
+                                       float pitch,
+                                       std::vector<uint8_t>& reserved,
+                                       Scenario& scenario) const;
+    // Obstacles at the unreserved spots, in shuffled order
+    void scatter(std::mt19937& rng,
+                 uint32_t side,
+                 const std::vector<uint32_t>& order,
+                 const std::vector<uint8_t>& reserved,
+                 Scenario& scenario) const;
+    // Walls between the cells of a maze of 'side' by 'side' cells
+    void maze(std::mt19937& rng, uint32_t side, Scenario& scenario) const;
+};
+
+// Replace the [scenario] table of a config (if it has one) by the agents and obstacles it
+// generates, appended to those of the config itself.
+// Throws if the scenario is invalid.
+void expand_scenario(toml::table& config);
+
+} // namespace just
+
+#endif // __JUST__SCENARIO_HPP__
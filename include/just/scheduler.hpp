@@ -0,0 +1,62 @@
+#ifndef __JUST__SCHEDULER_HPP__
+#define __JUST__SCHEDULER_HPP__
+
+#include <functional>
+#include <vector>
+
+namespace just
+{
+
+// Decouples the simulation from the render rate.
+//
+// Physics is run at a fixed timestep, using an accumulator to consume however much (real) time
+// passed since the last frame. Control tasks (i.e. agent steps) are each run at their own rate in
+// simulated time, so low rate agents cost proportionally less and results no longer depend on how
+// quickly frames are drawn.
+class Scheduler
+{
+public:
+    using Task = std::function<void(float delta_t)>;
+
+    // physics_rate is in Hz. At most max_substeps physics steps are run per call to advance(),
+    // any time beyond that is dropped (the simulation slows down rather than spiraling).
+    Scheduler(float physics_rate, Task physics_step, unsigned max_substeps = 10);
+
+    // Run a task at rate_hz (simulated time). A rate <= 0 runs the task every physics step.
+    // Tasks receive the simulated time elapsed since they last ran.
+    void add_task(float rate_hz, Task task);
+
+    // Advance the simulation by frame_time seconds of real time
+    void advance(float frame_time);
+
+    float physics_dt() const { return physics_dt_; }
+    double time() const { return time_; }
+    size_t physics_steps() const { return physics_steps_; }
+
+    // Fraction of a physics step left over in the accumulator, useful for interpolating renders
+    float alpha() const { return accumulator_ / physics_dt_; }
+
+private:
+    struct ScheduledTask
+    {
+        double period;
+        double next_time;
+        double last_time;
+        Task task;
+    };
+
+    float physics_dt_;
+    unsigned max_substeps_;
+    Task physics_step_;
+    std::vector<ScheduledTask> tasks_;
+
+    double accumulator_{0.0};
+    double time_{0.0};
+    size_t physics_steps_{0};
+
+    void tick();
+};
+
+} // namespace just
+
+#endif // __JUST__SCHEDULER_HPP__
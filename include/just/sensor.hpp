@@ -2,10 +2,11 @@
 #define __JUST__SENSOR_HPP__
 
 #include <vector>
-#include <limits>
 
 #include "box2d/box2d.h"
 
+#include "physics.hpp"
+
 namespace just
 {
 
@@ -18,10 +19,19 @@ public:
         float angle{0.0};
     };
 
-    UltrasonicArray(unsigned sensor_cnt, float max_range, b2Body* body);
+    // Beams are cast from 'body' in 'world', which must both outlive the array
+    UltrasonicArray(unsigned sensor_cnt,
+                    float max_range,
+                    PhysicsWorld* world,
+                    const PhysicsBody* body);
 
     SensorReading sense_one();
     std::vector<SensorReading> sense_all();
+    // Fire the next 'count' beams in turn, picking up where the last call left off, so the whole
+    // array is still covered over multiple calls
+    std::vector<SensorReading> sense_some(size_t count);
+
+    size_t beam_count() const { return beams_.size(); }
 
     float max_range()
     {
@@ -35,24 +45,10 @@ private:
         b2Vec2 local_endpoint;
     };
 
-    class RaycastCb : public b2RayCastCallback
-    {
-    public:
-        RaycastCb(b2Body* body) : body_(body) {}
-
-        float ReportFixture(b2Fixture* fixture,
-                            const b2Vec2& world_point,
-                            const b2Vec2& normal,
-                            float fraction);
-
-        float min_distance{std::numeric_limits<float>::max()};
-    private:
-        b2Body* body_;
-    };
-
     std::vector<Beam> beams_;
     size_t active_beam_idx_{0};
-    b2Body* body_;
+    PhysicsWorld* world_;
+    const PhysicsBody* body_;
 };
 
 } // namespace just
@@ -0,0 +1,199 @@
+#ifndef __JUST__SPATIAL_HASH_HPP__
+#define __JUST__SPATIAL_HASH_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "box2d/box2d.h"
+
+namespace just
+{
+
+// Uniform grid over an unbounded plane, hashed into a flat table.
+//
+// Items (identified by their index) are added to every cell their bounding box overlaps. The table
+// is rebuilt from scratch with a counting sort, O(items + cells covered), which is cheap enough to
+// do every step for moving items. Cells that collide in the hash share a bucket, so queries return
+// a superset of the items in the cells asked for: callers are expected to do exact tests on what
+// they get. Each item is reported at most once per query.
+//
+// Queries mark visited items in a scratch buffer, so a hash must not be queried by multiple
+// threads at once.
+class SpatialHash
+{
+public:
+    explicit SpatialHash(float cell_size) : cell_size_(cell_size) {}
+
+    float cell_size() const { return cell_size_; }
+    size_t size() const { return stamps_.size(); }
+
+    void build(std::span<const b2AABB> boxes)
+    {
+        // Bounded by a few cells per item, so the table is sized on a first pass over the boxes
+        size_t entries = 0;
+        for (const b2AABB& box : boxes) {
+            CellRange range = cells_of(box);
+            entries += static_cast<size_t>(range.x1 - range.x0 + 1) * (range.y1 - range.y0 + 1);
+        }
+
+        size_t buckets = 64;
+        while (buckets < 2 * entries) {
+            buckets <<= 1;
+        }
+        mask_ = buckets - 1;
+
+        bucket_start_.assign(buckets + 1, 0);
+        for (const b2AABB& box : boxes) {
+            for_each_cell(cells_of(box),
+                          [this](int x, int y) { ++bucket_start_[bucket(x, y) + 1]; });
+        }
+        for (size_t b = 0; b < buckets; ++b) {
+            bucket_start_[b + 1] += bucket_start_[b];
+        }
+
+        items_.resize(entries);
+        fill_.assign(bucket_start_.begin(), bucket_start_.end() - 1);
+        for (uint32_t item = 0; item < boxes.size(); ++item) {
+            for_each_cell(cells_of(boxes[item]), [this, item](int x, int y) {
+                items_[fill_[bucket(x, y)]++] = item;
+            });
+        }
+
+        stamps_.assign(boxes.size(), 0);
+        stamp_ = 0;
+    }
+
+    // Calls fn(item) for every item sharing a bucket with a cell overlapped by 'box'
+    template <typename Fn>
+    void query(const b2AABB& box, Fn&& fn) const
+    {
+        if (stamps_.empty()) {
+            return;
+        }
+        uint32_t stamp = next_stamp();
+        for_each_cell(cells_of(box), [&](int x, int y) { visit(bucket(x, y), stamp, fn); });
+    }
+
+    // Walks the cells along the segment from p1 to p2 in order, calling fn(item) for every item met
+    // along the way. fn returns the fraction (0 to 1) along the segment at which the item is hit,
+    // or anything larger for a miss. The walk stops once no further cell can hold a closer hit.
+    // Returns the fraction of the closest hit, or a value larger than 1 if there was none.
+    template <typename Fn>
+    float raycast(b2Vec2 p1, b2Vec2 p2, Fn&& fn) const
+    {
+        constexpr float INF = std::numeric_limits<float>::infinity();
+        float best = INF;
+        if (stamps_.empty()) {
+            return best;
+        }
+        uint32_t stamp = next_stamp();
+
+        // Amanatides & Woo voxel traversal, in fractions of the segment
+        b2Vec2 d = p2 - p1;
+        int x = cell(p1.x);
+        int y = cell(p1.y);
+        int x_end = cell(p2.x);
+        int y_end = cell(p2.y);
+        int step_x = d.x > 0 ? 1 : -1;
+        int step_y = d.y > 0 ? 1 : -1;
+        float delta_x = d.x != 0.0f ? cell_size_ / std::abs(d.x) : INF;
+        float delta_y = d.y != 0.0f ? cell_size_ / std::abs(d.y) : INF;
+        float next_x = d.x != 0.0f
+            ? ((x + (step_x > 0 ? 1 : 0)) * cell_size_ - p1.x) / d.x
+            : INF;
+        float next_y = d.y != 0.0f
+            ? ((y + (step_y > 0 ? 1 : 0)) * cell_size_ - p1.y) / d.y
+            : INF;
+
+        auto hit = [&](uint32_t item) { best = std::min(best, fn(item)); };
+        while (true) {
+            visit(bucket(x, y), stamp, hit);
+
+            // The segment leaves this cell at the nearer of the two boundaries
+            float exit = std::min(next_x, next_y);
+            if (best <= exit || (x == x_end && y == y_end) || exit > 1.0f) {
+                break;
+            }
+            if (next_x < next_y) {
+                x += step_x;
+                next_x += delta_x;
+            } else {
+                y += step_y;
+                next_y += delta_y;
+            }
+        }
+        return best;
+    }
+
+private:
+    struct CellRange
+    {
+        int x0, y0, x1, y1;
+    };
+
+    float cell_size_;
+    size_t mask_{0};
+    std::vector<uint32_t> bucket_start_;
+    std::vector<uint32_t> fill_;
+    std::vector<uint32_t> items_;
+    mutable std::vector<uint32_t> stamps_;
+    mutable uint32_t stamp_{0};
+
+    int cell(float coordinate) const
+    {
+        return static_cast<int>(std::floor(coordinate / cell_size_));
+    }
+
+    CellRange cells_of(const b2AABB& box) const
+    {
+        return {cell(box.lowerBound.x),
+                cell(box.lowerBound.y),
+                cell(box.upperBound.x),
+                cell(box.upperBound.y)};
+    }
+
+    size_t bucket(int x, int y) const
+    {
+        return ((static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u))
+               & mask_;
+    }
+
+    template <typename Fn>
+    static void for_each_cell(const CellRange& range, Fn&& fn)
+    {
+        for (int y = range.y0; y <= range.y1; ++y) {
+            for (int x = range.x0; x <= range.x1; ++x) {
+                fn(x, y);
+            }
+        }
+    }
+
+    uint32_t next_stamp() const
+    {
+        if (++stamp_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            stamp_ = 1;
+        }
+        return stamp_;
+    }
+
+    template <typename Fn>
+    void visit(size_t b, uint32_t stamp, Fn& fn) const
+    {
+        for (uint32_t i = bucket_start_[b]; i < bucket_start_[b + 1]; ++i) {
+            uint32_t item = items_[i];
+            if (stamps_[item] != stamp) {
+                stamps_[item] = stamp;
+                fn(item);
+            }
+        }
+    }
+};
+
+} // namespace just
+
+#endif // __JUST__SPATIAL_HASH_HPP__
@@ -0,0 +1,91 @@
+#ifndef __JUST__SPSC_RING_HPP__
+#define __JUST__SPSC_RING_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace just
+{
+
+// Lock-free, bounded, single producer/single consumer ring buffer of fixed size records.
+//
+// Exactly one thread may push and exactly one (other) thread may pop. Each side keeps a cached
+// copy of the other side's index so the shared atomics are only touched when the cache says the
+// ring is full/empty.
+template <typename T>
+class SpscRing
+{
+public:
+    // The capacity is rounded up to the next power of two
+    explicit SpscRing(size_t capacity)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        buffer_.resize(rounded);
+        mask_ = rounded - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side. Returns false if the ring is full.
+    bool try_push(const T& item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ == buffer_.size()) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ == buffer_.size()) {
+                return false;
+            }
+        }
+
+        buffer_[head & mask_] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool try_pop(T& item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == cached_head_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail == cached_head_) {
+                return false;
+            }
+        }
+
+        item = buffer_[tail & mask_];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot, the other side may be pushing/popping concurrently
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return buffer_.size(); }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> buffer_;
+    size_t mask_;
+
+    // Producer owned
+    alignas(CACHE_LINE) std::atomic<size_t> head_{0};
+    size_t cached_tail_{0};
+
+    // Consumer owned
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{0};
+    size_t cached_head_{0};
+};
+
+} // namespace just
+
+#endif // __JUST__SPSC_RING_HPP__
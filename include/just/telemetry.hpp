@@ -0,0 +1,74 @@
+#ifndef __JUST__TELEMETRY_HPP__
+#define __JUST__TELEMETRY_HPP__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "highfive/highfive.hpp"
+
+namespace just
+{
+
+// A telemetry sink: one HDF5 file, written by one background thread.
+//
+// Producers (e.g. the logger of each agent) register a Channel. Channels queue data without
+// touching HDF5, the writer thread drains every channel and writes out all of the blocks that are
+// ready in one go, so a whole world shares a single file, metadata cache and writer.
+class Telemetry
+{
+public:
+    class Channel
+    {
+    public:
+        virtual ~Channel() = default;
+
+        // The following are only ever called by the Telemetry, one channel at a time.
+
+        // Move queued data into the channel's current batch, returns true if there was any
+        virtual bool drain() = 0;
+        // Whether the current batch is full and should be written out
+        virtual bool ready() const = 0;
+        // Write the current batch to the file (called with the HDF5 lock held)
+        virtual void write() = 0;
+    };
+
+    explicit Telemetry(const std::string& filename);
+    ~Telemetry();
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    // Register a channel. 'setup' is called with the HDF5 lock held, to create its datasets.
+    void add_channel(Channel* channel, const std::function<void(HighFive::File&)>& setup);
+
+    // Unregister a channel, writing out anything it still has queued. Blocks until done.
+    void remove_channel(Channel* channel);
+
+    const std::string& filename() const { return filename_; }
+
+    // The HDF5 library isn't built thread safe by default. Any HDF5 call made outside of a
+    // channel's write() must hold this lock, as telemetry writers may be running concurrently.
+    static std::mutex& hdf5_mutex();
+
+private:
+    std::string filename_;
+    std::unique_ptr<HighFive::File> file_;
+
+    std::mutex channels_mutex_;
+    std::vector<Channel*> channels_;
+
+    std::atomic<bool> running_{true};
+    std::thread writer_;
+
+    void writer_loop();
+    void flush(Channel* channel);
+};
+
+} // namespace just
+
+#endif // __JUST__TELEMETRY_HPP__
@@ -0,0 +1,128 @@
+#ifndef __JUST__TRACE_HPP__
+#define __JUST__TRACE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Timeline tracing of scoped events, compiled in with the JUST_ENABLE_TRACING CMake option and
+// exported as Chrome Trace Event JSON (viewable in chrome://tracing or ui.perfetto.dev).
+//
+// Code is instrumented with the JUST_TRACE_* macros below, which expand to nothing unless
+// JUST_ENABLE_TRACING is defined. When compiled in, events are only recorded while the global
+// tracer is enabled.
+#ifdef JUST_ENABLE_TRACING
+#define JUST_TRACE_CONCAT_(a, b) a##b
+#define JUST_TRACE_CONCAT(a, b) JUST_TRACE_CONCAT_(a, b)
+// Trace the rest of the enclosing scope as an event. 'name' must be a string literal.
+#define JUST_TRACE_SCOPE(name) \
+    ::just::Tracer::Scope JUST_TRACE_CONCAT(just_trace_scope_, __LINE__)(::just::Tracer::global(), \
+                                                                         (name))
+// Name the calling thread in the trace
+#define JUST_TRACE_THREAD_NAME(name) ::just::Tracer::global().set_thread_name(name)
+#else
+#define JUST_TRACE_SCOPE(name) do {} while (0)
+#define JUST_TRACE_THREAD_NAME(name) do {} while (0)
+#endif
+
+namespace just
+{
+
+// Records complete (begin and duration) events into per thread buffers.
+//
+// Each thread appends to a fixed size buffer of its own without any locking, the buffers are only
+// shared (under a lock) to register a thread's first event and when exporting. Once a thread's
+// buffer is full its later events are dropped and counted, the trace keeps the start of the run.
+class Tracer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Scope
+    {
+    public:
+        Scope(Tracer& tracer, const char* name)
+            : tracer_(tracer.enabled() ? &tracer : nullptr), name_(name)
+        {
+            if (tracer_) {
+                start_ = Clock::now();
+            }
+        }
+        ~Scope()
+        {
+            if (tracer_) {
+                tracer_->record(name_, start_, Clock::now());
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Tracer* tracer_;
+        const char* name_;
+        Clock::time_point start_;
+    };
+
+    explicit Tracer(size_t events_per_thread = 1 << 20);
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // The tracer used by the JUST_TRACE_* macros
+    static Tracer& global();
+
+    void enable(bool enable) { enabled_.store(enable, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // 'name' must outlive the tracer (i.e. be a string literal)
+    void record(const char* name, Clock::time_point start, Clock::time_point end);
+    void set_thread_name(const std::string& name);
+
+    // Number of events recorded/dropped so far, across all threads
+    size_t size() const;
+    size_t dropped() const;
+
+    // Export every event recorded so far. Safe to call while other threads are still recording,
+    // their later events are simply not included.
+    void write_json(std::ostream& out) const;
+    // Returns false if the file couldn't be written
+    bool write_json(const std::string& filename) const;
+
+private:
+    struct Event
+    {
+        const char* name;
+        int64_t start_ns;      // since the tracer was created
+        int64_t duration_ns;
+    };
+
+    struct ThreadBuffer
+    {
+        uint32_t tid;
+        std::string name;
+        std::unique_ptr<Event[]> events;
+        std::atomic<size_t> size{0};
+        std::atomic<size_t> dropped{0};
+    };
+
+    uint64_t id_;
+    size_t events_per_thread_;
+    Clock::time_point epoch_;
+    std::atomic<bool> enabled_{false};
+
+    // Guards the list of buffers (not their contents)
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+    ThreadBuffer& local_buffer();
+};
+
+} // namespace just
+
+#endif // __JUST__TRACE_HPP__
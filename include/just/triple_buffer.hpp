@@ -0,0 +1,73 @@
+#ifndef __JUST__TRIPLE_BUFFER_HPP__
+#define __JUST__TRIPLE_BUFFER_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace just
+{
+
+// Lock-free triple buffer, handing the latest of a stream of values from one thread to another.
+//
+// Exactly one thread may write and exactly one (other) thread may read. The writer fills in the
+// back buffer and publishes it by swapping it with the middle one, the reader takes the middle one
+// by swapping it with the front buffer it reads from. Neither side ever waits for the other: the
+// writer runs at its own rate and values the reader was too slow for are simply skipped.
+//
+// Buffers are reused rather than reset, so the writer can keep (and incrementally update) whatever
+// it allocated in them. Note the write buffer holds an earlier value, not necessarily the last one
+// published.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side. The buffer to fill in before the next publish().
+    T& write_buffer() { return buffers_[back_]; }
+
+    // Writer side. Hand the write buffer to the reader, replacing the previous value if the
+    // reader hasn't taken it yet.
+    void publish()
+    {
+        back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side. Switch to the latest published value, if there is one the reader hasn't
+    // taken yet. Returns whether read_buffer() changed.
+    bool update()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // Reader side. The value taken by the last update(), or a default constructed T before the
+    // first one.
+    const T& read_buffer() const { return buffers_[front_]; }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+    // The middle index is tagged with whether it was published since the reader last took it
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<T, 3> buffers_;
+
+    // Writer owned
+    alignas(CACHE_LINE) uint8_t back_{0};
+    // Shared
+    alignas(CACHE_LINE) std::atomic<uint8_t> middle_{1};
+    // Reader owned
+    alignas(CACHE_LINE) uint8_t front_{2};
+};
+
+} // namespace just
+
+#endif // __JUST__TRIPLE_BUFFER_HPP__
@@ -0,0 +1,165 @@
+#ifndef __JUST__VFH_LOGGER_HPP__
+#define __JUST__VFH_LOGGER_HPP__
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "highfive/highfive.hpp"
+
+#include "agent.hpp"
+#include "spsc_ring.hpp"
+#include "telemetry.hpp"
+
+namespace just
+{
+
+// Logs the internals of a VFHAgent to HDF5, as a channel of a Telemetry sink.
+//
+// The agent fills in a fixed size record over the course of a step, between begin_step() and
+// end_step(). Records travel through a lock-free SPSC ring to the telemetry's writer thread, which
+// appends them in large multi-step blocks, so no HDF5 calls are made from the control loop.
+//
+// The full grid history is logged as periodic keyframes plus per step deltas of the cells that
+// changed. The agent only sends the changed cells, the writer keeps its own copy of the grid to
+// produce keyframes from. Grid steps are keyed by the agent's step, like the columns below: the
+// grid after step s is that of the last grid step at or before s, rebuilt from the latest keyframe
+// at or before it, followed by the deltas of the grid steps after that keyframe (up to and
+// including it). Keyframes are also written out of turn when the agent resumes logging after
+// shedding it.
+//
+// Layout, relative to the logger's group (the file root for a file of its own, or the agent's
+// name in a shared telemetry file), with one column per logged step. Not every step of the agent
+// is logged (see agent_steps), so columns of different agents don't line up:
+//   vfh_agent/window_histogram   uint8 [WINDOW_SIZE_SQUARED, steps]
+//   vfh_agent/polar_histogram    float [K, steps]
+//   vfh_agent/packed_motion      float [4, steps] (angle, speed, x, y)
+//   vfh_agent/agent_steps        uint64 [steps], the agent's step (counting from 0) of each column
+//   vfh_agent/full_histogram/    (attributes: width, height, keyframe_interval)
+//       keyframes                uint8 [width * height, keyframes]
+//       keyframe_steps           uint64 [keyframes], the agent's step of each keyframe
+//       steps                    uint64 [grid steps], the agent's step of each grid step
+//       delta_counts             uint32 [grid steps], number of changed cells per grid step
+//       delta_cells              uint32 [total deltas], index into the grid of each change
+//       delta_values             uint8 [total deltas], new value of each change
+class VFHAgent::Logger : public Telemetry::Channel
+{
+public:
+    struct Options
+    {
+        // Grid steps between keyframes
+        size_t keyframe_interval{100};
+        // Deflate level (0-9) for the grid history, 0 disables compression
+        unsigned compression{0};
+    };
+
+    // Number of steps written to the file at once, also used as the chunk size
+    static constexpr size_t BLOCK_STEPS = 256;
+    // Number of steps that may be queued up before the agent has to wait on the writer
+    static constexpr size_t RING_CAPACITY = 1024;
+    // Number of changed grid cells that may be queued up
+    static constexpr size_t CELL_RING_CAPACITY = 1 << 16;
+
+    // Log to a file of our own
+    Logger(const std::string& filename, unsigned grid_width, unsigned grid_height, Options options);
+    // Log to a group of a shared telemetry file
+    Logger(Telemetry& telemetry,
+           const std::string& group,
+           unsigned grid_width,
+           unsigned grid_height,
+           Options options);
+    ~Logger() override;
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Start logging the agent's step number 'step', which everything logged until end_step() is
+    // tagged with
+    void begin_step(uint64_t step);
+    void log_polar_histogram(const std::array<float, K>& polar_histogram);
+    void log_window(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window);
+    // NOTE: only the cells in grid.changed_cells() are logged, the grid must be tracking changes
+    // and be cleared at the start of each step
+    void log_full_grid(const HistogramGrid& grid);
+    // Log every cell of the grid, rather than the changed ones, and write a keyframe of it. For the
+    // first step logged after some that weren't, whose changes never reached the logger.
+    void log_grid_keyframe(const HistogramGrid& grid);
+    void log_motion(float angle, float speed, float x, float y);
+
+    // Hand the data logged during this step over to the writer thread
+    void end_step();
+
+    // Telemetry::Channel
+    bool drain() override;
+    bool ready() const override;
+    void write() override;
+
+private:
+    struct Record
+    {
+        enum Flags : uint8_t
+        {
+            WINDOW = 1 << 0,
+            POLAR_HISTOGRAM = 1 << 1,
+            MOTION = 1 << 2,
+            GRID = 1 << 3,
+            // The grid updates are the whole grid, and a keyframe is due regardless of the interval
+            KEYFRAME = 1 << 4,
+        };
+
+        uint8_t flags{0};
+        uint32_t grid_updates{0};   // number of entries in the cell ring belonging to this step
+        std::array<uint8_t, WINDOW_SIZE_SQUARED> window;
+        std::array<float, K> polar_histogram;
+        std::array<float, 4> motion;
+        uint64_t step{0};
+    };
+
+    struct CellUpdate
+    {
+        uint32_t cell;
+        uint8_t value;
+    };
+
+    // Cached dataset handles, looking datasets up by name for every write is surprisingly
+    // expensive. Only ever touched from the telemetry's writer.
+    struct Datasets;
+
+    Options options_;
+    std::unique_ptr<Telemetry> owned_telemetry_;
+    Telemetry* telemetry_;
+    std::unique_ptr<Datasets> datasets_;
+
+    // Producer (agent) side
+    Record pending_;
+    SpscRing<Record> ring_;
+    SpscRing<CellUpdate> cell_ring_;
+    std::atomic<bool> failed_{false};
+
+    // Consumer (writer) side
+    std::vector<Record> batch_;
+    // Cell updates are drained eagerly (a single step may have more than fit in the ring),
+    // and consumed from the front as the records they belong to are written
+    std::vector<CellUpdate> cell_backlog_;
+    size_t cell_backlog_start_{0};
+    std::vector<uint8_t> shadow_grid_;
+    // Number of grid steps written, which keyframe_interval counts in
+    size_t grid_step_{0};
+
+    void init(const std::string& group, unsigned grid_width, unsigned grid_height);
+    void push_cell(CellUpdate update);
+    void write_batch();
+    void write_grid_deltas();
+
+    // Append the records in batch_ with the given flag as columns of a [rows, steps] dataset.
+    // 'get' returns a record's column data.
+    template <typename T, size_t N, typename Getter>
+    void append_columns(HighFive::DataSet& dataset, uint8_t flag, Getter get);
+};
+
+} // namespace just
+
+#endif // __JUST__VFH_LOGGER_HPP__
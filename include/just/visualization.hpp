@@ -1,9 +1,24 @@
 #ifndef __JUST__VISULAIZATION_HPP__
 #define __JUST__VISULAIZATION_HPP__
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numeric>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "box2d/box2d.h"
 #include "raylib.h"
+#include "toml++/toml.hpp"
+
+#include "grid_snapshot.hpp"
+#include "occupancy_map.hpp"
+#include "spatial_hash.hpp"
+#include "world_model.hpp"
 
 namespace just
 {
@@ -21,6 +36,9 @@ public:
                       float x,
                       float y,
                       float theta) const = 0;
+    // Radius of a circle around the visualization's center bounding it, in meters
+    virtual float radius() const = 0;
+    virtual Color color() const = 0;
 };
 
 struct RectangleViz : public Visualization
@@ -50,6 +68,9 @@ public:
         DrawRectanglePro(rect, vec, theta, color_);
     }
 
+    float radius() const override { return std::hypot(width_, height_) / 2.0f; }
+    Color color() const override { return color_; }
+
 private:
     float width_;
     float height_;
@@ -78,11 +99,137 @@ public:
         DrawCircleV(vec, scale * radius_, color_);
     }
 
+    float radius() const override { return radius_; }
+    Color color() const override { return color_; }
+
 private:
     float radius_;
     Color color_;
 };
 
+// Live view of a HistogramGrid (e.g. an agent's map), drawn over the scene with the certainty of
+// each cell as the opacity of 'color'. The grid is seen through GridSnapshots, so the simulation
+// can keep updating it on another thread.
+//
+// The grid is mirrored in a GPU texture, one pixel per cell. Uploading all of it every frame is far
+// too slow for large grids, so update() only uploads the tiles whose version changed since it last
+// saw them, each with its own UpdateTextureRec. As an agent only changes the few tiles around it
+// per step, keeping the view live costs next to nothing.
+class GridOverlay
+{
+public:
+    explicit GridOverlay(Color color)
+    {
+        for (size_t cv = 0; cv < palette_.size(); ++cv) {
+            palette_[cv] = Fade(color, static_cast<float>(cv) / HistogramGrid::CV_MAX);
+        }
+        pixels_.resize(HistogramGrid::TILE_SIZE * HistogramGrid::TILE_SIZE);
+    }
+
+    ~GridOverlay()
+    {
+        if (texture_.id != 0) {
+            UnloadTexture(texture_);
+        }
+    }
+
+    GridOverlay(const GridOverlay&) = delete;
+    GridOverlay& operator=(const GridOverlay&) = delete;
+
+    // Upload the tiles of 'snapshot' that changed since the last update.
+    // Returns the number of tiles uploaded.
+    size_t update(const GridSnapshot& snapshot)
+    {
+        if (snapshot.cells.empty()) {
+            return 0;
+        }
+        if (texture_.id == 0) {
+            Image image = GenImageColor(snapshot.width, snapshot.height, BLANK);
+            texture_ = LoadTextureFromImage(image);
+            UnloadImage(image);
+            width_ = snapshot.width;
+            height_ = snapshot.height;
+            x_min_ = snapshot.x_min;
+            y_min_ = snapshot.y_min;
+            tile_versions_.assign(snapshot.tile_versions.size(), 0);
+        }
+
+        size_t uploaded = 0;
+        for (uint32_t tile = 0; tile < tile_versions_.size(); ++tile) {
+            if (tile_versions_[tile] != snapshot.tile_versions[tile]) {
+                upload_tile(snapshot, tile);
+                tile_versions_[tile] = snapshot.tile_versions[tile];
+                ++uploaded;
+            }
+        }
+        return uploaded;
+    }
+
+    void draw(float screen_w, float screen_h, float scale) const
+    {
+        if (texture_.id == 0) {
+            return;
+        }
+        // Cells are centered on their (integer) coordinates
+        float width = width_;
+        float height = height_;
+        Rectangle dest;
+        dest.x = screen_w / 2.0f + scale * (x_min_ - 0.5f);
+        dest.y = screen_h / 2.0f - scale * (y_min_ + height - 0.5f);
+        dest.width = scale * width;
+        dest.height = scale * height;
+        // The grid's first row is its bottom one, hence the flip (negative height) of the source
+        DrawTexturePro(texture_, {0.0f, 0.0f, width, -height}, dest, {0.0f, 0.0f}, 0.0f, WHITE);
+    }
+
+private:
+    Texture2D texture_{};
+    unsigned width_{0};
+    unsigned height_{0};
+    int x_min_{0};
+    int y_min_{0};
+    // Version of every tile as of its last upload
+    std::vector<uint64_t> tile_versions_;
+    // Color of every certainty value
+    std::array<Color, HistogramGrid::CV_MAX + 1> palette_;
+    // Staging for a tile's pixels
+    std::vector<Color> pixels_;
+
+    void upload_tile(const GridSnapshot& snapshot, uint32_t tile)
+    {
+        constexpr unsigned TILE_SIZE = HistogramGrid::TILE_SIZE;
+        unsigned col = tile % snapshot.tiles_wide * TILE_SIZE;
+        unsigned row = tile / snapshot.tiles_wide * TILE_SIZE;
+        unsigned cols = std::min(TILE_SIZE, width_ - col);
+        unsigned rows = std::min(TILE_SIZE, height_ - row);
+
+        for (unsigned r = 0; r < rows; ++r) {
+            const uint8_t* cells = snapshot.cells.data() + (row + r) * width_ + col;
+            std::transform(cells, cells + cols, pixels_.begin() + r * cols, [this](uint8_t cv) {
+                return palette_[cv];
+            });
+        }
+
+        Rectangle rect;
+        rect.x = col;
+        rect.y = row;
+        rect.width = cols;
+        rect.height = rows;
+        UpdateTextureRec(texture_, rect, pixels_.data());
+    }
+};
+
+// The window, and how the world is mapped onto it.
+//
+// Visualizations draw themselves in base screen coordinates: 'scale' pixels per meter with the
+// world's origin at the center of the window. A 2D camera (panned and zoomed with the mouse, see
+// update_camera()) maps those onto the window, so what is drawn between begin_world() and
+// end_world() follows it while anything else (e.g. text) stays put.
+//
+// Worlds can be much larger than the window, so nothing off screen is submitted: agents drawn with
+// draw_viz() are culled against the view, and the static layer finds what's visible through a
+// SpatialHash. When zoomed out far enough for small static objects to shrink to a few pixels,
+// those are aggregated (level of detail) into coarse cells drawn as one rectangle each.
 class Visualizer
 {
 public:
@@ -91,13 +238,21 @@ public:
     {
         InitWindow(width_, height_, "just");
         SetTargetFPS(fps);
+        reset_camera();
     }
 
     ~Visualizer()
     {
+        if (static_layer_.id != 0) {
+            UnloadRenderTexture(static_layer_);
+        }
         CloseWindow();
     }
 
+    // Owns the window
+    Visualizer(const Visualizer&) = delete;
+    Visualizer& operator=(const Visualizer&) = delete;
+
     bool should_close() const
     {
         return WindowShouldClose();
@@ -114,6 +269,87 @@ public:
         EndDrawing();
     }
 
+    // Draw in world (camera) space, between begin_drawing() and end_drawing()
+    void begin_world() const
+    {
+        BeginMode2D(camera_);
+    }
+
+    void end_world() const
+    {
+        EndMode2D();
+    }
+
+    // Camera.
+    // The view starts centered on the world's origin at 'scale' pixels per meter.
+    // Call once per frame to pan (dragging with the right mouse button) and zoom (the wheel,
+    // about the mouse cursor).
+    void update_camera()
+    {
+        float wheel = GetMouseWheelMove();
+        if (wheel != 0.0f) {
+            zoom_at(GetMousePosition(), std::pow(ZOOM_STEP, wheel));
+        }
+        if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
+            Vector2 delta = GetMouseDelta();
+            if (delta.x != 0.0f || delta.y != 0.0f) {
+                pan(delta);
+            }
+        }
+    }
+
+    // Move the view by 'delta' pixels, as if dragging the world along
+    void pan(Vector2 delta)
+    {
+        camera_.target.x -= delta.x / camera_.zoom;
+        camera_.target.y -= delta.y / camera_.zoom;
+        static_dirty_ = true;
+    }
+
+    // Zoom by 'factor', keeping the point under 'screen_point' where it is
+    void zoom_at(Vector2 screen_point, float factor)
+    {
+        camera_.target = to_base(screen_point);
+        camera_.offset = screen_point;
+        camera_.zoom = std::clamp(camera_.zoom * factor, MIN_ZOOM, MAX_ZOOM);
+        static_dirty_ = true;
+    }
+
+    void reset_camera()
+    {
+        camera_.offset = {width_ / 2.0f, height_ / 2.0f};
+        camera_.target = {width_ / 2.0f, height_ / 2.0f};
+        camera_.rotation = 0.0f;
+        camera_.zoom = 1.0f;
+        static_dirty_ = true;
+    }
+
+    float zoom() const
+    {
+        return camera_.zoom;
+    }
+
+    // The part of the world on screen, in meters
+    b2AABB visible_box() const
+    {
+        Vector2 top_left = to_base({0.0f, 0.0f});
+        Vector2 bottom_right = to_base({width_, height_});
+        b2AABB box;
+        box.lowerBound = {(top_left.x - width_ / 2.0f) / scale_,
+                          (height_ / 2.0f - bottom_right.y) / scale_};
+        box.upperBound = {(bottom_right.x - width_ / 2.0f) / scale_,
+                          (height_ / 2.0f - top_left.y) / scale_};
+        return box;
+    }
+
+    // Whether any of a circle (in meters) is on screen
+    bool visible(float x, float y, float radius) const
+    {
+        b2AABB view = visible_box();
+        return x + radius >= view.lowerBound.x && x - radius <= view.upperBound.x
+               && y + radius >= view.lowerBound.y && y - radius <= view.upperBound.y;
+    }
+
     RectangleViz create_rectangle_viz(float width, float height, const std::string& color) const
     {
         return RectangleViz(width, height, string_to_color(color));
@@ -124,15 +360,231 @@ public:
         return CircleViz(radius, string_to_color(color));
     }
 
+    std::unique_ptr<GridOverlay> create_grid_overlay(const std::string& color) const
+    {
+        return std::make_unique<GridOverlay>(string_to_color(color));
+    }
+
+    // Bring the overlay up to date with the snapshot of its grid and draw it, in world space
+    void draw_grid_overlay(GridOverlay& overlay, const GridSnapshot& snapshot) const
+    {
+        overlay.update(snapshot);
+        overlay.draw(width_, height_, scale_);
+    }
+
+    // Draw a visualization in world space, unless it's off screen
     void draw_viz(float x, float y, float theta, const Visualization& viz) const
     {
-        viz.draw(width_, height_, scale_, x, y, theta);
+        if (visible(x, y, viz.radius())) {
+            viz.draw(width_, height_, scale_, x, y, theta);
+        }
+    }
+
+    // The static layer: visualizations that never move, such as obstacles and markers.
+    // Rather than drawing each of them every frame, the visible ones are rendered once into a
+    // texture which then takes a single draw call per frame, however many there are. The texture
+    // is only rendered again when the layer changes, or the view does.
+    void add_static_viz(float x, float y, float theta, std::unique_ptr<Visualization> viz)
+    {
+        static_vizs_.push_back({x, y, theta, std::move(viz)});
+        static_dirty_ = true;
+        static_index_dirty_ = true;
+    }
+
+    size_t static_viz_count() const
+    {
+        return static_vizs_.size();
+    }
+
+    // Render the static layer again on the next draw_static_layer()
+    void invalidate_static_layer()
+    {
+        static_dirty_ = true;
+    }
+
+    // Draw the static layer, between begin_drawing() and end_drawing() but outside of world space
+    // (the layer already is as seen through the camera)
+    void draw_static_layer()
+    {
+        if (static_dirty_) {
+            render_static_layer();
+        }
+        // Render textures are stored upside down (OpenGL's origin is the bottom left), hence the
+        // negative height of the source rectangle
+        DrawTextureRec(static_layer_.texture, {0.0f, 0.0f, width_, -height_}, {0.0f, 0.0f}, WHITE);
+    }
+
+    // Static visualizations and aggregated cells drawn by the last render of the static layer
+    size_t static_draws() const
+    {
+        return static_draws_;
     }
 
 private:
+    static constexpr float ZOOM_STEP = 1.1;
+    static constexpr float MIN_ZOOM = 1.0 / 1024.0;
+    static constexpr float MAX_ZOOM = 64.0;
+
+    // Side of the static layer's spatial hash cells, in meters
+    static constexpr float STATIC_CELL_SIZE = 8.0;
+    // Level of detail: level l aggregates static visualizations that fit within cells of
+    // LOD_CELL_SIZE * 2^l meters. The level in use is the finest whose cells are at least
+    // LOD_CELL_PIXELS wide on screen, with no aggregation while even the finest cells are. This
+    // bounds what's drawn by the window's area rather than the number of objects in view.
+    static constexpr float LOD_CELL_SIZE = 1.0;
+    static constexpr float LOD_CELL_PIXELS = 8.0;
+    static constexpr int LOD_LEVELS = 16;
+
+    struct StaticViz
+    {
+        float x;
+        float y;
+        float theta;
+        std::unique_ptr<Visualization> viz;
+    };
+
+    struct AggregateCell
+    {
+        int x;
+        int y;
+        Color color;
+    };
+
     float width_;
     float height_;
     float scale_;
+    Camera2D camera_{};
+
+    std::vector<StaticViz> static_vizs_;
+    RenderTexture2D static_layer_{};
+    bool static_dirty_{true};
+    size_t static_draws_{0};
+
+    // Spatial index and levels of detail of the static layer, rebuilt when it changes
+    bool static_index_dirty_{true};
+    SpatialHash static_hash_{STATIC_CELL_SIZE};
+    std::vector<std::vector<AggregateCell>> lod_cells_;
+    // Static visualizations, largest first
+    std::vector<uint32_t> by_size_;
+
+    // Screen coordinates to base (pre camera) ones
+    Vector2 to_base(Vector2 screen_point) const
+    {
+        return {camera_.target.x + (screen_point.x - camera_.offset.x) / camera_.zoom,
+                camera_.target.y + (screen_point.y - camera_.offset.y) / camera_.zoom};
+    }
+
+    static float lod_cell_size(int level)
+    {
+        return LOD_CELL_SIZE * std::ldexp(1.0f, level);
+    }
+
+    // Level of detail for the current zoom, -1 for none
+    int lod_level() const
+    {
+        float pixels_per_meter = scale_ * camera_.zoom;
+        if (LOD_CELL_SIZE * pixels_per_meter >= LOD_CELL_PIXELS) {
+            return -1;
+        }
+        int level = std::ceil(std::log2(LOD_CELL_PIXELS / (LOD_CELL_SIZE * pixels_per_meter)));
+        return std::min(level, LOD_LEVELS - 1);
+    }
+
+    void build_static_index()
+    {
+        std::vector<b2AABB> boxes;
+        boxes.reserve(static_vizs_.size());
+        for (const auto& [x, y, theta, viz] : static_vizs_) {
+            float r = viz->radius();
+            boxes.push_back({{x - r, y - r}, {x + r, y + r}});
+        }
+        static_hash_.build(boxes);
+
+        by_size_.resize(static_vizs_.size());
+        std::iota(by_size_.begin(), by_size_.end(), 0);
+        std::sort(by_size_.begin(), by_size_.end(), [this](uint32_t a, uint32_t b) {
+            return static_vizs_[a].viz->radius() > static_vizs_[b].viz->radius();
+        });
+
+        // Each cell takes the color of the first visualization in it
+        lod_cells_.assign(LOD_LEVELS, {});
+        for (int level = 0; level < LOD_LEVELS; ++level) {
+            float cell_size = lod_cell_size(level);
+            std::unordered_map<uint64_t, size_t> cells;
+            for (const auto& [x, y, theta, viz] : static_vizs_) {
+                if (2.0f * viz->radius() > cell_size) {
+                    continue;
+                }
+                int cx = std::floor(x / cell_size);
+                int cy = std::floor(y / cell_size);
+                uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32)
+                               | static_cast<uint32_t>(cy);
+                if (cells.emplace(key, lod_cells_[level].size()).second) {
+                    lod_cells_[level].push_back({cx, cy, viz->color()});
+                }
+            }
+        }
+        static_index_dirty_ = false;
+    }
+
+    void render_static_layer()
+    {
+        if (static_layer_.id == 0) {
+            static_layer_ = LoadRenderTexture(width_, height_);
+        }
+        if (static_index_dirty_) {
+            build_static_index();
+        }
+
+        b2AABB view = visible_box();
+        int level = lod_level();
+        static_draws_ = 0;
+
+        BeginTextureMode(static_layer_);
+        ClearBackground(BLANK);
+        BeginMode2D(camera_);
+        if (level < 0) {
+            static_hash_.query(view, [this](uint32_t idx) {
+                const auto& [x, y, theta, viz] = static_vizs_[idx];
+                if (visible(x, y, viz->radius())) {
+                    viz->draw(width_, height_, scale_, x, y, theta);
+                    ++static_draws_;
+                }
+            });
+        } else {
+            // Too small to make out at this zoom, drawn as the cells they fall in
+            float cell_size = lod_cell_size(level);
+            for (const AggregateCell& cell : lod_cells_[level]) {
+                float x = cell.x * cell_size;
+                float y = cell.y * cell_size;
+                if (x + cell_size < view.lowerBound.x || x > view.upperBound.x
+                    || y + cell_size < view.lowerBound.y || y > view.upperBound.y) {
+                    continue;
+                }
+                Rectangle rect;
+                rect.x = width_ / 2.0f + scale_ * x;
+                rect.y = height_ / 2.0f - scale_ * (y + cell_size);
+                rect.width = scale_ * cell_size;
+                rect.height = scale_ * cell_size;
+                DrawRectangleRec(rect, cell.color);
+                ++static_draws_;
+            }
+            // The rest are still drawn as themselves
+            for (uint32_t idx : by_size_) {
+                const auto& [x, y, theta, viz] = static_vizs_[idx];
+                if (2.0f * viz->radius() <= cell_size) {
+                    break;
+                }
+                if (visible(x, y, viz->radius())) {
+                    viz->draw(width_, height_, scale_, x, y, theta);
+                    ++static_draws_;
+                }
+            }
+        }
+        EndMode2D();
+        EndTextureMode();
+        static_dirty_ = false;
+    }
 
     Color string_to_color(const std::string& color) const {
         if (color == "red") {
@@ -147,6 +599,40 @@ private:
     }
 };
 
+// Create the visualization described by the 'shape' (and size/color) fields of a TOML config.
+// Returns nullptr if they are missing or invalid.
+inline std::unique_ptr<Visualization> viz_factory(const toml::table& config,
+                                                  const Visualizer& visualizer)
+{
+    if (auto viz_shape_opt = config["shape"].value<std::string>()) {
+        std::string color = config["color"].value_or("blue");
+        if (*viz_shape_opt == "box") {
+            float width = config["width"].value_or(1);
+            float height = config["height"].value_or(1);
+            auto viz = visualizer.create_rectangle_viz(width, height, color);
+            return std::make_unique<RectangleViz>(viz);
+        } else if (*viz_shape_opt == "circle") {
+            float radius = config["radius"].value_or(1.0);
+            auto viz = visualizer.create_circle_viz(radius, color);
+            return std::make_unique<CircleViz>(viz);
+        }
+    }
+
+    return nullptr;
+}
+
+// Add the occupied parts of a map to the visualizer's static layer, a box per rectangle of
+// OccupancyMap::rectangles()
+inline void add_map_vizs(const OccupancyMap& map, const std::string& color, Visualizer& visualizer)
+{
+    for (const b2AABB& box : map.rectangles()) {
+        b2Vec2 center = box.GetCenter();
+        b2Vec2 size = box.upperBound - box.lowerBound;
+        auto viz = visualizer.create_rectangle_viz(size.x, size.y, color);
+        visualizer.add_static_viz(center.x, center.y, 0.0, std::make_unique<RectangleViz>(viz));
+    }
+}
+
 } // namespace just
 
 #endif // __JUST__VISULAIZATION_HPP__
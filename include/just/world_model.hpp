@@ -4,6 +4,9 @@
 #include <cstdint>
 #include <optional>
 #include <array>
+#include <span>
+#include <algorithm>
+#include <vector>
 
 namespace just
 {
@@ -26,6 +29,9 @@ public:
     const uint8_t* data() const { return data_; };
     unsigned width() const { return width_; };
     unsigned height() const { return height_; };
+    // Cartesian coordinates of the cell at data()[0], the grid's bottom left corner
+    int x_min() const { return x_min_; }
+    int y_min() const { return y_min_; }
 
     // Public facing, bounds checked element access (cartesian coords).
     // Returns nullopt if the requested x/y is out of bounds.
@@ -40,10 +46,36 @@ public:
     // returns false if the percept couldn't be processed, true otherwise
     bool add_percept(int x0, int y0, float theta, float distance, bool detected);
 
+    // Change tracking.
+    // When enabled, the index (into data()) of every cell whose value changes is recorded until
+    // cleared. A cell changing multiple times is recorded multiple times.
+    void track_changes(bool enable) { track_changes_ = enable; }
+    const std::vector<uint32_t>& changed_cells() const { return changed_cells_; }
+    void clear_changed_cells() { changed_cells_.clear(); }
+
+    // Dirty tiles.
+    // Coarser change tracking, for consumers that only need to know which areas of the grid
+    // changed, such as a live view of the grid uploading it to the GPU piece by piece. The grid is
+    // split into square tiles of TILE_SIZE cells (smaller at the right and top edges) and, when
+    // enabled, a tile is marked dirty whenever one of its cells changes. This is independent of
+    // the changed cells above, each has its own consumers.
+    static constexpr unsigned TILE_SIZE = 32;
+    void track_dirty_tiles(bool enable);
+    unsigned tiles_wide() const { return (width_ + TILE_SIZE - 1) / TILE_SIZE; }
+    unsigned tiles_high() const { return (height_ + TILE_SIZE - 1) / TILE_SIZE; }
+    // Indices (col + row * tiles_wide()) of the tiles dirtied since the last call, each once.
+    // Clears them.
+    std::vector<uint32_t> take_dirty_tiles();
+
     // Get a subset of the grid
     template <size_t W, size_t H>
     std::optional<std::array<uint8_t, W * H>> subgrid(int x, int y) const;
 
+    // Copy a subset of the grid into a caller provided (row major) buffer.
+    // Returns false, leaving the buffer untouched, if the subgrid is out of bounds.
+    template <size_t W, size_t H>
+    bool copy_subgrid(int x, int y, std::span<uint8_t, W * H> out) const;
+
 private:
     // array data/info
     uint8_t* data_;
@@ -56,18 +88,38 @@ private:
     int y_max_;
     int y_min_;
 
+    bool track_changes_{false};
+    std::vector<uint32_t> changed_cells_;
+
+    bool track_dirty_tiles_{false};
+    std::vector<uint8_t> tile_dirty_;
+    std::vector<uint32_t> dirty_tiles_;
+
     // Looks up a value in the internal array, using cartesian coords as the reference system.
     // DOES NOT do any bounds checking, to allow a single bounds check (before fn calls)
     // for multiple array accesses.
     uint8_t& unsafe_at(int x, int y);
     const uint8_t& unsafe_at(int x, int y) const;
+    inline uint32_t unsafe_index(int x, int y) const;
 
     inline void increment_cell(int x, int y);
     inline void decrement_cell(int x, int y);
+    inline void mark_dirty(uint32_t idx);
 };
 
 template <size_t W, size_t H>
 std::optional<std::array<uint8_t, W * H>> HistogramGrid::subgrid(int x, int y) const
+{
+    std::array<uint8_t, W * H> subarray;
+    if (!copy_subgrid<W, H>(x, y, subarray)) {
+        return std::nullopt;
+    }
+
+    return { subarray };
+}
+
+template <size_t W, size_t H>
+bool HistogramGrid::copy_subgrid(int x, int y, std::span<uint8_t, W * H> out) const
 {
     int sub_x_max = x + W / 2;
     int sub_y_max = y + H / 2;
@@ -77,22 +129,18 @@ std::optional<std::array<uint8_t, W * H>> HistogramGrid::subgrid(int x, int y) c
     int sub_y_min = H % 2 ? y - H / 2 : y - (H / 2 - 1);
 
     if (sub_x_max > x_max_ || sub_y_max > y_max_ || sub_x_min < x_min_ || sub_y_min < y_min_) {
-        return std::nullopt;
+        return false;
     }
 
-    std::array<uint8_t, W * H> subarray;
-    size_t idx = 0;
+    // Rows of the subgrid are contiguous in the underlying array
+    auto out_it = out.begin();
     for (int y = sub_y_min; y <= sub_y_max; ++y) {
-        for (int x = sub_x_min; x <= sub_x_max; ++x) {
-            subarray.at(idx) = unsafe_at(x, y);
-            ++idx;
-        }
+        out_it = std::copy_n(&unsafe_at(sub_x_min, y), W, out_it);
     }
 
-    return { subarray };
+    return true;
 }
 
-
 } // namespace just
 
 #endif // __JUST__WORLD_MODEL_HPP__
@@ -16,14 +16,20 @@ def main():
         description='Create an animation of the window & polar histograms from a JUST log file',
     )
     parser.add_argument('-a', '--agent-name', default='jerry')
+    parser.add_argument('-f', '--file', default=None,
+                        help='shared telemetry file (the agent\'s own log file if not given)')
     parser.add_argument('--fps', default=100, type=int)
 
     args = parser.parse_args()
 
-    with h5py.File(f'/tmp/just/{args.agent_name}/log.h5', 'r') as file:  # TODO: parameterize
+    # A shared telemetry file has a group per agent, an agent's own log file keeps it at the root
+    filename = args.file or f'/tmp/just/{args.agent_name}/log.h5'
+    prefix = f'{args.agent_name}/' if args.file else ''
 
-        dset1 = file['vfh_agent/polar_histogram']
-        dset2 = np.array(file['vfh_agent/window_histogram'])
+    with h5py.File(filename, 'r') as file:
+
+        dset1 = file[f'{prefix}vfh_agent/polar_histogram']
+        dset2 = np.array(file[f'{prefix}vfh_agent/window_histogram'])
         theta = np.linspace(0.0, 2 * np.pi, dset1.shape[0], endpoint=False)
 
         window_size = 30
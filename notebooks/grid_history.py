@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Rebuild the histogram grid of a JUST VFH agent log at any step, from keyframes and deltas."""
+
+import argparse
+
+import matplotlib.pyplot as plt
+import numpy as np
+import h5py
+
+# pylint: disable=no-member
+
+class GridHistory:
+    """Reconstructs the full histogram grid from the keyframe/delta encoded grid history."""
+
+    def __init__(self, file, group='vfh_agent/full_histogram'):
+        grid = file[group]
+        self.width = int(grid.attrs['width'])
+        self.height = int(grid.attrs['height'])
+        self.keyframes = grid['keyframes']
+        # Both keyed by the agent's step, which skips the steps that weren't logged
+        self.keyframe_steps = np.array(grid['keyframe_steps'])
+        self.grid_steps = np.array(grid['steps'])
+        counts = np.array(grid['delta_counts'], dtype=np.uint64)
+        self.delta_offsets = np.concatenate(([0], np.cumsum(counts)))
+        self.delta_cells = grid['delta_cells']
+        self.delta_values = grid['delta_values']
+
+    @property
+    def last_step(self):
+        """The agent's step of the last grid step in the log."""
+        return int(self.grid_steps[-1])
+
+    def at(self, step):
+        """The grid (as a height x width array) as of the agent's given step, i.e. after the last
+        grid step logged at or before it."""
+        last = np.searchsorted(self.grid_steps, step, side='right') - 1
+        if last < 0:
+            raise IndexError(f'no grid logged at or before step {step}')
+
+        k = np.searchsorted(self.keyframe_steps, step, side='right') - 1
+        grid = np.array(self.keyframes[:, k])
+
+        first = np.searchsorted(self.grid_steps, self.keyframe_steps[k])
+        start = int(self.delta_offsets[first + 1])
+        end = int(self.delta_offsets[last + 1])
+        if end > start:
+            # Later deltas overwrite earlier ones. Which of the repeated indices of a fancy indexing
+            # assignment wins is unspecified, so only each cell's last delta is assigned: the
+            # first occurrence of each cell in the reversed deltas.
+            cells = np.asarray(self.delta_cells[start:end])[::-1]
+            values = np.asarray(self.delta_values[start:end])[::-1]
+            cells, last = np.unique(cells, return_index=True)
+            grid[cells] = values[last]
+
+        return grid.reshape(self.height, self.width)
+
+
+def main():
+    """The main fn."""
+    parser = argparse.ArgumentParser(
+        description='Plot the histogram grid of a JUST log file at a given step',
+    )
+    parser.add_argument('-a', '--agent-name', default='jerry')
+    parser.add_argument('-f', '--file', default=None,
+                        help='shared telemetry file (the agent\'s own log file if not given)')
+    parser.add_argument('-s', '--step', default=-1, type=int)
+
+    args = parser.parse_args()
+
+    # A shared telemetry file has a group per agent, an agent's own log file keeps it at the root
+    filename = args.file or f'/tmp/just/{args.agent_name}/log.h5'
+    prefix = f'{args.agent_name}/' if args.file else ''
+
+    with h5py.File(filename, 'r') as file:
+        history = GridHistory(file, f'{prefix}vfh_agent/full_histogram')
+        step = args.step if args.step >= 0 else history.last_step
+        plt.imshow(history.at(step), interpolation='none', origin='lower')
+        plt.title(f'{args.agent_name}, step {step}')
+        plt.show()
+
+if __name__ == '__main__':
+    main()
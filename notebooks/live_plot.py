@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Live plot of a VFH agent's window & polar histograms, read from a running JUST simulation.
+
+The simulation publishes to POSIX shared memory when `live_stream` is set in the `[world]` table
+of its config (see include/just/live_stream.hpp for the layout). The reader only ever maps the
+segment read-only, so it can be started and stopped at any time without affecting the run.
+"""
+
+import argparse
+import mmap
+import struct
+import time
+
+from matplotlib import animation
+import matplotlib.pyplot as plt
+import numpy as np
+
+# pylint: disable=no-member
+
+MAGIC = 0x4a555354
+VERSION = 1
+HEADER_FIELDS = (
+    'magic', 'version', 'slot_count', 'slot_size', 'slots_offset', 'k', 'window_size',
+    'name_size', 'name_offset', 'step_offset', 'flags_offset', 'motion_offset',
+    'polar_histogram_offset', 'window_offset', 'slots_used',
+)
+HEADER_FORMAT = f'<{len(HEADER_FIELDS)}I'
+
+FLAG_WINDOW = 1 << 0
+FLAG_POLAR_HISTOGRAM = 1 << 1
+FLAG_MOTION = 1 << 2
+
+
+class LiveStreamReader:
+    """Attaches to the shared memory segment of a JUST live stream."""
+
+    def __init__(self, name='/just_live'):
+        path = '/dev/shm/' + name.lstrip('/')
+        with open(path, 'rb') as file:
+            self.memory = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+
+        values = struct.unpack_from(HEADER_FORMAT, self.memory, 0)
+        self.header = dict(zip(HEADER_FIELDS, values))
+        if self.header['magic'] != MAGIC or self.header['version'] != VERSION:
+            self.close()
+            raise ValueError(f'{path} is not a compatible JUST live stream')
+
+    def close(self):
+        """Detach from the stream."""
+        self.memory.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    @property
+    def size(self):
+        """Number of slots claimed by agents."""
+        return struct.unpack_from('<I', self.memory, HEADER_FIELDS.index('slots_used') * 4)[0]
+
+    def _sequence(self, base):
+        return struct.unpack_from('<Q', self.memory, base)[0]
+
+    def read(self, slot, max_retries=100):
+        """The latest step of an agent as a dict, or None if there is nothing (consistent) yet."""
+        if slot >= self.size:
+            return None
+
+        header = self.header
+        base = header['slots_offset'] + slot * header['slot_size']
+        for _ in range(max_retries):
+            before = self._sequence(base)
+            if before == 0:
+                return None
+            if before % 2 == 1:
+                time.sleep(0)
+                continue
+
+            raw = self.memory[base:base + header['slot_size']]
+            if self._sequence(base) != before:
+                continue
+
+            name = raw[header['name_offset']:header['name_offset'] + header['name_size']]
+            window_cells = header['window_size'] ** 2
+            return {
+                'name': name.split(b'\0', 1)[0].decode(),
+                'step': struct.unpack_from('<Q', raw, header['step_offset'])[0],
+                'flags': struct.unpack_from('<I', raw, header['flags_offset'])[0],
+                'motion': np.frombuffer(raw, np.float32, 4, header['motion_offset']),
+                'polar_histogram': np.frombuffer(raw, np.float32, header['k'],
+                                                 header['polar_histogram_offset']),
+                'window': np.frombuffer(raw, np.uint8, window_cells,
+                                        header['window_offset']).reshape(
+                                            header['window_size'], header['window_size']),
+            }
+
+        return None
+
+    def find(self, agent_name):
+        """The slot of the named agent, or None."""
+        for slot in range(self.size):
+            record = self.read(slot)
+            if record is not None and record['name'] == agent_name:
+                return slot
+        return None
+
+
+def main():
+    """The main fn."""
+    parser = argparse.ArgumentParser(
+        description='Live plot of the window & polar histograms of a running JUST simulation',
+    )
+    parser.add_argument('-a', '--agent-name', default='jerry')
+    parser.add_argument('-s', '--stream', default='/just_live',
+                        help='shared memory name, as set by `live_stream` in the world config')
+    parser.add_argument('--fps', default=30, type=int)
+
+    args = parser.parse_args()
+
+    with LiveStreamReader(args.stream) as reader:
+        slot = reader.find(args.agent_name)
+        if slot is None:
+            raise SystemExit(f'No agent named {args.agent_name} in {args.stream}')
+
+        k = reader.header['k']
+        window_size = reader.header['window_size']
+        theta = np.linspace(0.0, 2 * np.pi, k, endpoint=False)
+
+        fig = plt.figure()
+        axes = [plt.subplot(1, 2, 1, projection='polar'), plt.subplot(1, 2, 2)]
+        bars = axes[0].bar(theta, np.zeros(k))
+        window = axes[1].imshow(
+            np.zeros((window_size, window_size)),
+            interpolation='none',
+            origin='lower',
+            vmin=0,
+            vmax=20,
+        )
+        title = fig.suptitle('')
+
+        def animate(_):
+            record = reader.read(slot)
+            if record is None:
+                return bars, window
+            if record['flags'] & FLAG_POLAR_HISTOGRAM:
+                histogram = record['polar_histogram']
+                for value, bar in zip(histogram, bars):     # pylint: disable=disallowed-name
+                    bar.set_height(value)
+                axes[0].set_ylim(0, max(histogram.max(), 1.0))
+            if record['flags'] & FLAG_WINDOW:
+                window.set_data(record['window'])
+            if record['flags'] & FLAG_MOTION:
+                angle, speed, x, y = record['motion']
+                title.set_text(f'{record["name"]} step {record["step"]}: '
+                               f'({x:.1f}, {y:.1f}) heading {np.degrees(angle):.0f} deg, '
+                               f'speed {speed:.2f}')
+            return bars, window
+
+        # Keep a reference until the window closes, the animation stops when garbage collected
+        anim = animation.FuncAnimation(fig, animate, interval=1000 // args.fps,
+                                       cache_frame_data=False, blit=False)
+        plt.show()
+        anim.pause()
+
+if __name__ == '__main__':
+    main()
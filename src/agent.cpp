@@ -1,50 +1,29 @@
 #include <string_view>
 #include <exception>
-#include <filesystem>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
 
 #include "just/agent.hpp"
+#include "just/deadline_monitor.hpp"
+#include "just/flight_recorder.hpp"
+#include "just/global_planner.hpp"
+#include "just/kernels.hpp"
+#include "just/live_stream.hpp"
+#include "just/trace.hpp"
+#include "just/vfh_logger.hpp"
 
 namespace just
 {
 
-Agent::Agent(const toml::table& config, b2World* world)
+Agent::Agent(const toml::table& config, PhysicsWorld* world)
+    : body_(world->create_body(config))
 {
-    b2BodyDef body_def;
-    body_def.type = b2_dynamicBody;
-    body_def.position.Set(config["x"].value_or(0.0), config["y"].value_or(0.0));
-    body_def.angle = config["theta"].value_or(0.0);
-    body_ = world->CreateBody(&body_def);
-
-    std::string_view shape_str = config["shape"].value_or("circle");
-    if (shape_str == "circle") {
-        b2CircleShape shape;
-        shape.m_radius = config["radius"].value_or(1.0);
-
-        b2FixtureDef fixture_def;
-        fixture_def.shape = &shape;
-        fixture_def.density = config["density"].value_or(1.0);
-        body_->CreateFixture(&fixture_def);
-
-    } else if (shape_str == "box") {
-        b2PolygonShape shape;
-        shape.SetAsBox(config["width"].value_or(1.0) / 2, config["height"].value_or(1.0) / 2);
-
-        b2FixtureDef fixture_def;
-        fixture_def.shape = &shape;
-        fixture_def.density = config["density"].value_or(1.0);
-        body_->CreateFixture(&fixture_def);
-    } else {
-        throw std::runtime_error("Agent constructed with invalid 'shape' field in TOML config");
-    }
-}
-
-Agent::~Agent()
-{
-    b2World* world = body_->GetWorld();
-    world->DestroyBody(body_);
 }
 
-PatrolAgent::PatrolAgent(const toml::table& config, b2World* world)
+PatrolAgent::PatrolAgent(const toml::table& config, PhysicsWorld* world)
     : Agent(config, world)
 {
     a_ = {config["x"].value_or(0.0f), config["y"].value_or(0.0f)};
@@ -60,124 +39,86 @@ void PatrolAgent::step(float delta_t)
 
     // TODO: this is ugly, whatever
     if (reverse_) {
-        goal = body_->GetLocalPoint(a_);
+        goal = body_->local_point(a_);
         if (goal.Length() < tolerance_) {
             reverse_ = !reverse_;
-            goal = body_->GetLocalPoint(b_);
+            goal = body_->local_point(b_);
         }
     } else {
-        goal = body_->GetLocalPoint(b_);
+        goal = body_->local_point(b_);
         if (goal.Length() < tolerance_) {
             reverse_ = !reverse_;
-            goal = body_->GetLocalPoint(a_);
+            goal = body_->local_point(a_);
         }
     }
 
     goal.Normalize();
     goal *= speed_;
 
-    body_->SetLinearVelocity(goal);
-    body_->SetAngularVelocity(0.0f);
+    body_->set_linear_velocity(goal);
+    body_->set_angular_velocity(0.0f);
 }
 
 
-VFHAgent::VFHAgent(const toml::table& config, b2World* world)
+VFHAgent::VFHAgent(const toml::table& config,
+                   PhysicsWorld* world,
+                   Telemetry* telemetry,
+                   LiveStream* live_stream)
     : Agent(config, world),
       grid_(*config["grid"]["width"].value<unsigned>(), *config["grid"]["width"].value<unsigned>()),
       sensor_(*config["sensor"]["count"].value<unsigned>(),
               *config["sensor"]["range"].value<float>(),
-              body_),
+              world,
+              body_.get()),
+      name_(config["name"].value_or(std::string("vfh"))),
       valley_threshold_(*config["valley_threshold"].value<float>()),
-      v_max_(config["speed"].value_or(1.0))
+      v_max_(config["speed"].value_or(1.0)),
+      profiler_(name_,
+                {"sense", "grid_update", "planning", "window", "polar_histogram", "smoothing",
+                 "steering", "logging"})
 {
     if (config["logging"].value_or(true)) {
-        std::string filename = "/tmp/just/" + *config["name"].value<std::string>() + "/log.h5";
-        logger_ = std::make_unique<Logger>(filename, grid_.height() * grid_.width());
+        std::string name = *config["name"].value<std::string>();
+        Logger::Options options;
+        options.keyframe_interval = config["log_keyframe_interval"].value_or(100);
+        options.compression = config["log_compression"].value_or(0);
+        if (telemetry) {
+            logger_ = std::make_unique<Logger>(*telemetry,
+                                               name,
+                                               grid_.width(),
+                                               grid_.height(),
+                                               options);
+        } else {
+            std::string filename = "/tmp/just/" + name + "/log.h5";
+            logger_ = std::make_unique<Logger>(filename, grid_.width(), grid_.height(), options);
+        }
+        grid_.track_changes(true);
+    }
+    if (auto recorder_options = FlightRecorder::options_from_config(config)) {
+        recorder_ = std::make_unique<FlightRecorder>(*recorder_options);
+    }
+    if (live_stream) {
+        std::string name = config["name"].value_or(std::string());
+        live_ = std::make_unique<LivePublisher>(live_stream->add_publisher(name));
+    }
+    if (auto deadline_options = DeadlineMonitor::options_from_config(config)) {
+        deadline_ = std::make_unique<DeadlineMonitor>(*deadline_options);
     }
     goal_ = {*config["goal"]["x"].value<float>(), *config["goal"]["y"].value<float>()};
+    subgoal_ = goal_;
+    if (auto planner_options = GlobalPlanner::options_from_config(config)) {
+        planner_ = std::make_unique<GlobalPlanner>(*planner_options, grid_, goal_);
+        grid_.track_changes(true);
+    }
 }
 
-
-VFHAgent::Logger::Logger(const std::string& filename, unsigned grid_size)
-{
-    std::filesystem::path path(filename);
-    std::filesystem::create_directories(path.parent_path());
-
-    unsigned file_opts = HighFive::File::OpenOrCreate | HighFive::File::Truncate;
-    file_ = std::make_unique<HighFive::File>(filename, file_opts);
-
-    // TODO: remove hardcoding
-    HighFive::DataSpace polar_histogram_dataspace({K, 0}, {K, HighFive::DataSpace::UNLIMITED});
-    HighFive::DataSetCreateProps polar_histogram_props;
-    polar_histogram_props.add(HighFive::Chunking(std::vector<hsize_t>{K, 1}));
-    file_->createDataSet("/vfh_agent/polar_histogram",
-                         polar_histogram_dataspace,
-                         HighFive::create_datatype<float>(),
-                         polar_histogram_props);
-
-    HighFive::DataSpace window_histogram_dataspace(
-        {WINDOW_SIZE_SQUARED, 0},
-        {WINDOW_SIZE_SQUARED, HighFive::DataSpace::UNLIMITED});
-    HighFive::DataSetCreateProps window_histogram_props;
-    window_histogram_props.add(HighFive::Chunking(std::vector<hsize_t>{WINDOW_SIZE_SQUARED, 1}));
-    file_->createDataSet("/vfh_agent/window_histogram",
-                         window_histogram_dataspace,
-                         HighFive::create_datatype<uint8_t>(),
-                         window_histogram_props);
-
-    file_->createDataSet("/vfh_agent/full_histogram",
-                         {grid_size},
-                         HighFive::create_datatype<uint8_t>());
-
-    HighFive::DataSpace packed_dataspace({4, 0}, {4, HighFive::DataSpace::UNLIMITED});
-    HighFive::DataSetCreateProps packed_props;
-    packed_props.add(HighFive::Chunking(std::vector<hsize_t>{4, 1}));
-    auto packed_dataset = file_->createDataSet("/vfh_agent/packed_motion",
-                                             packed_dataspace,
-                                             HighFive::create_datatype<float>(),
-                                             packed_props);
-    packed_dataset.createAttribute("angle_index", 0);
-    packed_dataset.createAttribute("speed_index", 1);
-    packed_dataset.createAttribute("x_index", 2);
-    packed_dataset.createAttribute("y_index", 3);
-}
-
-void VFHAgent::Logger::log_polar_histogram(const std::array<float, K>& polar_histogram)
-{
-    auto dataset = file_->getDataSet("/vfh_agent/polar_histogram");
-    auto dims = dataset.getDimensions();
-    dims.at(1) += 1;
-    dataset.resize(dims);
-    dataset.select({0, dims.at(1) - 1}, {K, 1}).write(polar_histogram);
-}
-
-void VFHAgent::Logger::log_window(const std::array<uint8_t, WINDOW_SIZE_SQUARED>& window)
-{
-    auto dataset = file_->getDataSet("/vfh_agent/window_histogram");
-    auto dims = dataset.getDimensions();
-    dims.at(1) += 1;
-    dataset.resize(dims);
-    dataset.select({0, dims.at(1) - 1}, {WINDOW_SIZE_SQUARED, 1}).write(window);
-}
-
-void VFHAgent::Logger::log_full_grid(const HistogramGrid& grid)
-{
-    auto dataset = file_->getDataSet("/vfh_agent/full_histogram");
-    dataset.write(grid.data());
-}
-
-void VFHAgent::Logger::log_motion(float angle, float speed, float x, float y)
+// Out of line, as Logger, FlightRecorder, LivePublisher, DeadlineMonitor and GlobalPlanner are
+// incomplete in the header
+VFHAgent::~VFHAgent()
 {
-    // TODO: update this to match
-    (void)speed;
-
-    auto dataset = file_->getDataSet("/vfh_agent/packed_motion");
-    auto dims = dataset.getDimensions();
-    dims.at(1) += 1;
-    dataset.resize(dims);
-    std::array<float, 4> packed{angle, speed, x, y};
-    dataset.select({0, dims.at(1) - 1}, {4, 1}).write(packed);
-    ++steering_idx_;
+#ifdef JUST_ENABLE_PROFILING
+    profiler_.report(std::cout);
+#endif
 }
 
 void VFHAgent::step(float delta_t)
@@ -188,42 +129,102 @@ void VFHAgent::step(float delta_t)
     // time. It also matches the case of a rotating LIDAR or RADAR, as an added bonus.
     (void)delta_t;
 
+    JUST_TRACE_SCOPE("vfh_step");
+    JUST_PROFILE_BEGIN_STEP(profiler_);
+    auto start = std::chrono::steady_clock::now();
+
+    if (recorder_) {
+        recorder_->begin_step(delta_t);
+    }
+
     sense();
+    if (planner_) {
+        plan();
+    }
     if (logger_) {
-        logger_->log_full_grid(grid_);
+        JUST_PROFILE_PHASE(profiler_, LOGGING);
+        if (!logging()) {
+            // Shedding it, the changes are dropped rather than piling up until logging resumes
+            grid_keyframe_due_ = true;
+        } else {
+            logger_->begin_step(step_);
+            if (grid_keyframe_due_) {
+                // Then the whole grid is logged, as the changes of the steps in between are lost
+                logger_->log_grid_keyframe(grid_);
+                grid_keyframe_due_ = false;
+            } else {
+                logger_->log_full_grid(grid_);
+            }
+        }
+        grid_.clear_changed_cells();
     }
 
-    auto polar_histogram_opt = create_polar_histogram();
+    bool use_cached = deadline_
+                      && deadline_->shedding(DeadlineMonitor::ShedLevel::CACHED_POLAR_HISTOGRAM)
+                      && last_polar_histogram_;
+    if (!use_cached) {
+        last_polar_histogram_ = create_polar_histogram();
+    }
+    const auto& polar_histogram_opt = last_polar_histogram_;
+
     if (!polar_histogram_opt) {
         // Hit the edge of the map, not much to be done about it.
         // TODO: figure out what's to be done about it?
 
         // Sit still and question life choices.
-        body_->SetLinearVelocity({0.0f, 0.0f});
-        body_->SetAngularVelocity(0.0f);
-        return;
-    }
+        body_->set_linear_velocity({0.0f, 0.0f});
+        body_->set_angular_velocity(0.0f);
+        log_step(nullptr, {0.0, 0.0});
+    } else {
+        auto command = compute_steering(*polar_histogram_opt);
+        log_step(&*polar_histogram_opt, command);
 
-    if (logger_) {
-        logger_->log_polar_histogram(*polar_histogram_opt);
+        auto [angle, speed] = command;
+        b2Vec2 vel{speed * std::cos(angle), speed * std::sin(angle)};
+        body_->set_linear_velocity(vel);
     }
 
-    auto [angle, speed] = compute_steering(*polar_histogram_opt);
+    JUST_PROFILE_END_STEP(profiler_);
+    ++step_;
 
-    if (logger_) {
-        b2Vec2 position = body_->GetPosition();
-        logger_->log_motion(angle, speed, position.x, position.y);
+    if (deadline_ && deadline_->record(std::chrono::steady_clock::now() - start)) {
+        std::cout << "Agent " << name_ << " is shedding load: "
+                  << DeadlineMonitor::level_name(deadline_->level()) << " ("
+                  << deadline_->overruns() << " overruns of " << deadline_->steps()
+                  << " steps)" << std::endl;
+    }
+}
+
+void VFHAgent::dump_flight_recorder()
+{
+    if (recorder_) {
+        recorder_->dump("request");
     }
+}
 
-    b2Vec2 vel{speed * std::cos(angle), speed * std::sin(angle)};
-    body_->SetLinearVelocity(vel);
+bool VFHAgent::logging() const
+{
+    return logger_ && !(deadline_ && deadline_->shedding(DeadlineMonitor::ShedLevel::SKIP_LOGGING));
 }
 
 void VFHAgent::sense()
 {
-    auto sensor_readings = sensor_.sense_all();
+    JUST_TRACE_SCOPE("sense");
+    std::vector<UltrasonicArray::SensorReading> sensor_readings;
+    {
+        JUST_PROFILE_PHASE(profiler_, SENSE);
+        if (deadline_ && deadline_->shedding(DeadlineMonitor::ShedLevel::REDUCE_BEAMS)) {
+            // The beams fired rotate from step to step, so the whole array is still covered
+            float fraction = deadline_->options().beam_fraction;
+            size_t count = std::ceil(fraction * sensor_.beam_count());
+            sensor_readings = sensor_.sense_some(std::max<size_t>(count, 1));
+        } else {
+            sensor_readings = sensor_.sense_all();
+        }
+    }
 
-    b2Vec2 position = body_->GetPosition();
+    JUST_PROFILE_PHASE(profiler_, GRID_UPDATE);
+    b2Vec2 position = body_->position();
     int x = std::lround(position.x);
     int y = std::lround(position.y);
 
@@ -236,81 +237,193 @@ void VFHAgent::sense()
     }
 }
 
-std::optional<std::array<float, VFHAgent::K>> VFHAgent::create_polar_histogram()
+void VFHAgent::plan()
 {
-    b2Vec2 position = body_->GetPosition();
-    int x = std::lround(position.x);
-    int y = std::lround(position.y);
+    JUST_TRACE_SCOPE("planning");
+    JUST_PROFILE_PHASE(profiler_, PLANNING);
+    planner_->update_cells(grid_, grid_.changed_cells());
+    // With a logger, the changes are cleared once it has had them
+    if (!logger_) {
+        grid_.clear_changed_cells();
+    }
+    subgoal_ = planner_->subgoal(body_->position());
+}
 
-    auto window_grid_opt = grid_.subgrid<WINDOW_SIZE, WINDOW_SIZE>(x, y);
+std::optional<std::array<float, VFHAgent::K>> VFHAgent::create_polar_histogram()
+{
+    JUST_TRACE_SCOPE("polar_histogram");
+    std::optional<std::array<uint8_t, WINDOW_SIZE_SQUARED>> window_grid_opt;
+    {
+        JUST_PROFILE_PHASE(profiler_, WINDOW);
+        b2Vec2 position = body_->position();
+        int x = std::lround(position.x);
+        int y = std::lround(position.y);
+        window_grid_opt = grid_.subgrid<WINDOW_SIZE, WINDOW_SIZE>(x, y);
+    }
     if (!window_grid_opt) {
         // Hit the edge of the map, unable to create polar histogram
         return std::nullopt;
     }
 
-    if (logger_) {
-        logger_->log_window(*window_grid_opt);
-    }
-
-    std::array<float, K> sectors{};
-    SubgridAdapter window(std::move(*window_grid_opt));
-
-    // construct the polar histogram
-    size_t sector_idx;
-    float beta, m, cv, d;
-    int x_j, y_i;
-    int offset = WINDOW_SIZE % 2 ? 0 : 1;
-    for (size_t i = 0; i < WINDOW_SIZE; ++i) {
-        y_i = offset + i - (WINDOW_SIZE / 2);
-        for (size_t j = 0; j < WINDOW_SIZE; ++j) {
-            x_j = offset + j - (WINDOW_SIZE / 2);
-            if (x_j == 0 && y_i == 0) {
-                continue;
-            }
-            beta = std::atan2(y_i, x_j);
-            while (beta < 0.0) {
-                beta += 2 * M_PI;
-            }
-            cv = static_cast<float>(window.at(j,i));
-            d = std::sqrt(x_j * x_j + y_i * y_i);
-            m = cv * cv * (A - B * d);
-            sector_idx = std::lround(beta / ALPHA);
-            if (sector_idx >= K) {
-                sector_idx -= K;
-            }
-            sectors.at(sector_idx) += m;
+    {
+        JUST_PROFILE_PHASE(profiler_, LOGGING);
+        if (logging()) {
+            logger_->log_window(*window_grid_opt);
+        }
+        if (recorder_) {
+            recorder_->record_window(*window_grid_opt);
+        }
+        if (live_) {
+            live_->publish_window(*window_grid_opt);
         }
     }
 
-    // smooth the polar histogram
-    int h_prime, idx;
+    std::array<uint32_t, K> sectors;
+    {
+        JUST_PROFILE_PHASE(profiler_, POLAR_HISTOGRAM);
+        project_window(*window_grid_opt, sectors);
+    }
+
+    JUST_PROFILE_PHASE(profiler_, SMOOTHING);
     std::array<float, K> smoothed_sectors;
-    for (int i = 0; i < K; ++i) {
-        h_prime = 0;
-        for (int l = -L; l <= L; ++l) {
-            idx = i + l;
-
-            if (idx < 0) {
-                idx += K;
-            } else if (idx >= K) {
-                idx -= K;
-            }
+    smooth_sectors(sectors, smoothed_sectors);
 
-            // Slight difference from the paper here:
-            // I think there's a typo/error in the original publicaion (equation 5)
-            h_prime += sectors.at(idx) * (1 + L - std::abs(l));
+    return { smoothed_sectors };
+}
+
+void VFHAgent::log_step(const std::array<float, K>* polar_histogram, SteeringCommand command)
+{
+    JUST_PROFILE_PHASE(profiler_, LOGGING);
+    b2Vec2 position = body_->position();
+
+    if (logging()) {
+        // The logger only keeps the steps that produced a polar histogram
+        if (polar_histogram) {
+            logger_->log_polar_histogram(*polar_histogram);
+            logger_->log_motion(command.angle, command.speed, position.x, position.y);
+        }
+        logger_->end_step();
+    }
+    if (recorder_) {
+        if (polar_histogram) {
+            recorder_->record_polar_histogram(*polar_histogram);
+        }
+        recorder_->record_motion(command.angle, command.speed, position.x, position.y);
+        recorder_->end_step(command.speed == 0.0, body_->in_contact());
+    }
+    if (live_) {
+        if (polar_histogram) {
+            live_->publish_polar_histogram(*polar_histogram);
         }
-        h_prime /= 2 * L + 1;
-        smoothed_sectors.at(i) = h_prime;
+        live_->publish_motion(command.angle, command.speed, position.x, position.y);
+        live_->end_step();
     }
+}
 
-    return { smoothed_sectors };
+namespace
+{
+
+// The sector and magnitude weight (A - B * d) of every cell in the active window only depend on
+// the cell's position relative to the agent, so they are computed once up front.
+// This turns the polar projection into a branch free pass over the window.
+// Weights are rounded to integers, which at up to A (~10^4) loses next to nothing.
+struct ProjectionTable
+{
+    std::array<uint8_t, VFHAgent::WINDOW_SIZE_SQUARED> sector;
+    std::array<uint16_t, VFHAgent::WINDOW_SIZE_SQUARED> weight;
+};
+
+const ProjectionTable& projection_table()
+{
+    static const ProjectionTable table = [] {
+        constexpr size_t WINDOW_SIZE = VFHAgent::WINDOW_SIZE;
+        ProjectionTable t{};
+
+        float beta, d;
+        int x_j, y_i;
+        size_t sector_idx;
+        int offset = WINDOW_SIZE % 2 ? 0 : 1;
+        for (size_t i = 0; i < WINDOW_SIZE; ++i) {
+            y_i = offset + i - (WINDOW_SIZE / 2);
+            for (size_t j = 0; j < WINDOW_SIZE; ++j) {
+                x_j = offset + j - (WINDOW_SIZE / 2);
+                size_t idx = i * WINDOW_SIZE + j;
+                if (x_j == 0 && y_i == 0) {
+                    // The agent's own cell doesn't contribute to any sector
+                    t.sector.at(idx) = 0;
+                    t.weight.at(idx) = 0;
+                    continue;
+                }
+                beta = std::atan2(y_i, x_j);
+                while (beta < 0.0) {
+                    beta += 2 * M_PI;
+                }
+                d = std::sqrt(x_j * x_j + y_i * y_i);
+                sector_idx = std::lround(beta / VFHAgent::ALPHA);
+                if (sector_idx >= VFHAgent::K) {
+                    sector_idx -= VFHAgent::K;
+                }
+                t.sector.at(idx) = sector_idx;
+                t.weight.at(idx) = std::max(0L, std::lround(VFHAgent::A - VFHAgent::B * d));
+            }
+        }
+
+        // Sectors and their smoothing are accumulated in 32 bits. Make sure a window at full
+        // certainty fits, with the weights of the L sectors either side of one.
+        std::array<uint64_t, VFHAgent::K> weight_sums{};
+        for (size_t idx = 0; idx < VFHAgent::WINDOW_SIZE_SQUARED; ++idx) {
+            weight_sums[t.sector[idx]] += t.weight[idx];
+        }
+        constexpr uint64_t CV_MAX = HistogramGrid::CV_MAX;
+        constexpr uint64_t SMOOTHING_SUM = (VFHAgent::L + 1) * (VFHAgent::L + 1);
+        uint64_t worst = *std::max_element(weight_sums.begin(), weight_sums.end());
+        if (worst * CV_MAX * CV_MAX * SMOOTHING_SUM > std::numeric_limits<uint32_t>::max()) {
+            throw std::logic_error("VFH polar histogram would overflow 32 bits");
+        }
+        return t;
+    }();
+    return table;
+}
+
+} // namespace
+
+void VFHAgent::project_window(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window,
+                              std::span<uint32_t, K> sectors)
+{
+    const auto& table = projection_table();
+
+    std::fill(sectors.begin(), sectors.end(), 0);
+    kernels().project_window(window.data(),
+                             table.sector.data(),
+                             table.weight.data(),
+                             WINDOW_SIZE_SQUARED,
+                             sectors.data());
+}
+
+void VFHAgent::smooth_sectors(std::span<const uint32_t, K> sectors, std::span<float, K> smoothed)
+{
+    kernels().smooth_sectors(sectors.data(), smoothed.data());
 }
 
 VFHAgent::SteeringCommand VFHAgent::compute_steering(const std::array<float, K>& polar_histogram)
 {
-    // Get the target sector
-    b2Vec2 goal_local = body_->GetLocalPoint(goal_);
+    JUST_TRACE_SCOPE("steering");
+    JUST_PROFILE_PHASE(profiler_, STEERING);
+    size_t k_target = target_sector(body_->local_point(subgoal_));
+
+    auto heading_opt = select_heading(polar_histogram, k_target, valley_threshold_);
+    if (!heading_opt) {
+        // The only way this can happen is if *all* sectors are above the threshold.
+        // When this is the case there is nothing we can (should?) do,
+        // other than return a zero'ed out steering command;
+        return {0.0, 0.0};
+    }
+
+    return steering_command(polar_histogram, *heading_opt, valley_threshold_, v_max_);
+}
+
+size_t VFHAgent::target_sector(b2Vec2 goal_local)
+{
     float goal_theta = std::atan2(goal_local.y, goal_local.x);
     while (goal_theta < 0.0) {
         goal_theta += 2 * M_PI;
@@ -319,9 +432,15 @@ VFHAgent::SteeringCommand VFHAgent::compute_steering(const std::array<float, K>&
     if (k_target >= K) {
         k_target -= K;
     }
+    return k_target;
+}
 
+std::optional<size_t> VFHAgent::select_heading(std::span<const float, K> polar_histogram,
+                                               size_t k_target,
+                                               float valley_threshold)
+{
     size_t heading;    // sector of the output steering angle
-    bool target_in_valley = polar_histogram.at(k_target) <= valley_threshold_;
+    bool target_in_valley = polar_histogram[k_target] <= valley_threshold;
 
     if (target_in_valley) {
         heading = k_target;
@@ -334,20 +453,18 @@ VFHAgent::SteeringCommand VFHAgent::compute_steering(const std::array<float, K>&
         // Find the left edge of the peak (exclusive)
         do {
             l = l != 0 ? l - 1 : K - 1;
-        } while (polar_histogram.at(l) > valley_threshold_ && l != k_target);
+        } while (polar_histogram[l] > valley_threshold && l != k_target);
 
         if (l == k_target) {
-            // The only way this can happen is if *all* sectors are above the threshold.
-            // When this is the case there is nothing we can (should?) do,
-            // other than return a zero'ed out steering command;
+            // *All* sectors are above the threshold, there is no valley to select.
             // Note that this check should only be necessary once (on the left side in this case)
-            return {0.0, 0.0};
+            return std::nullopt;
         }
 
         // Find the right edge of the peak (exclusive)
         do {
             r = r != K - 1 ? r + 1 : 0;
-        } while (polar_histogram.at(r) > valley_threshold_);
+        } while (polar_histogram[r] > valley_threshold);
 
         size_t distance_l = l <= k_target ? k_target - l : k_target + K - l;
         size_t distance_r = r >= k_target ? r - k_target : r + K - k_target;
@@ -358,7 +475,7 @@ VFHAgent::SteeringCommand VFHAgent::compute_steering(const std::array<float, K>&
 
             do {
                 k_f = k_f != 0 ? k_f - 1 : K - 1;
-            } while (polar_histogram.at(k_f) <= valley_threshold_);
+            } while (polar_histogram[k_f] <= valley_threshold);
 
             k_f = k_f != K - 1 ? k_f + 1 : 0;
 
@@ -384,7 +501,7 @@ VFHAgent::SteeringCommand VFHAgent::compute_steering(const std::array<float, K>&
 
             do {
                 k_f = k_f != K - 1 ? k_f + 1 : 0;
-            } while (polar_histogram.at(k_f) <= valley_threshold_);
+            } while (polar_histogram[k_f] <= valley_threshold);
 
             k_f = k_f != 0 ? k_f - 1 : K - 1;
 
@@ -404,6 +521,14 @@ VFHAgent::SteeringCommand VFHAgent::compute_steering(const std::array<float, K>&
         }
     }
 
+    return heading;
+}
+
+VFHAgent::SteeringCommand VFHAgent::steering_command(std::span<const float, K> polar_histogram,
+                                                     size_t heading,
+                                                     float valley_threshold,
+                                                     float v_max)
+{
     // h_m is intended to be emperically determined (per the paper).
     // Here we will simply use the valley threshold as a heuristic to make tuning easier.
     // Note that the min of h_c and h_m is not needed, as it is not possible for h_c to exceed
@@ -411,9 +536,80 @@ VFHAgent::SteeringCommand VFHAgent::compute_steering(const std::array<float, K>&
     //
     // TODO: determine emperically?
 
-    float v = v_max_ * (1 - polar_histogram.at(heading) / (valley_threshold_ * 1.1));
+    float v = v_max * (1 - polar_histogram[heading] / (valley_threshold * 1.1));
 
     return {heading * ALPHA, v};
 }
 
+DWAAgent::DWAAgent(const toml::table& config, PhysicsWorld* world)
+    : Agent(config, world),
+      grid_(*config["grid"]["width"].value<unsigned>(),
+            *config["grid"]["height"].value<unsigned>()),
+      sensor_(*config["sensor"]["count"].value<unsigned>(),
+              *config["sensor"]["range"].value<float>(),
+              world,
+              body_.get()),
+      dwa_(DynamicWindow::options_from_config(config)),
+      goal_(*config["goal"]["x"].value<float>(), *config["goal"]["y"].value<float>())
+{
+    if (auto planner_options = GlobalPlanner::options_from_config(config)) {
+        planner_ = std::make_unique<GlobalPlanner>(*planner_options, grid_, goal_);
+        grid_.track_changes(true);
+    }
+}
+
+// Out of line, as GlobalPlanner is incomplete in the header
+DWAAgent::~DWAAgent() = default;
+
+void DWAAgent::step(float delta_t)
+{
+    JUST_TRACE_SCOPE("dwa_step");
+    b2Vec2 position = body_->position();
+    int x = std::lround(position.x);
+    int y = std::lround(position.y);
+
+    {
+        JUST_TRACE_SCOPE("sense");
+        for (const auto& [distance, angle] : sensor_.sense_all()) {
+            if (distance < 0.0) {
+                grid_.add_percept(x, y, angle, sensor_.max_range(), false);
+            } else {
+                grid_.add_percept(x, y, angle, distance, true);
+            }
+        }
+    }
+
+    b2Vec2 goal = goal_;
+    if (planner_) {
+        JUST_TRACE_SCOPE("planning");
+        planner_->update_cells(grid_, grid_.changed_cells());
+        grid_.clear_changed_cells();
+        goal = planner_->subgoal(position);
+    }
+
+    JUST_TRACE_SCOPE("dwa");
+    std::optional<DynamicWindow::Velocity> velocity_opt;
+    if (grid_.copy_subgrid<DynamicWindow::WINDOW_SIZE, DynamicWindow::WINDOW_SIZE>(x, y, window_)) {
+        velocity_opt = dwa_.choose(window_,
+                                   position - b2Vec2(x, y),
+                                   body_->angle(),
+                                   velocity_,
+                                   goal - position,
+                                   delta_t);
+    }
+    if (velocity_opt) {
+        velocity_ = *velocity_opt;
+    } else {
+        // At the edge of the map or unable to avoid a collision, brake as hard as possible
+        const auto& options = dwa_.options();
+        velocity_.speed = std::max(velocity_.speed - options.max_accel * delta_t, 0.0f);
+        velocity_.turn_rate = 0.0;
+    }
+
+    float heading = body_->angle();
+    body_->set_linear_velocity(
+        {velocity_.speed * std::cos(heading), velocity_.speed * std::sin(heading)});
+    body_->set_angular_velocity(velocity_.turn_rate);
+}
+
 } // namespace just
@@ -0,0 +1,351 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "doctest/doctest.h"
+
+#include "just/agent_system.hpp"
+#include "just/flight_recorder.hpp"
+#include "just/global_planner.hpp"
+#include "just/live_stream.hpp"
+#include "just/trace.hpp"
+
+namespace just
+{
+
+AgentSystem::AgentSystem(PhysicsWorld* world, LiveStream* live_stream)
+    : world_(world),
+      live_stream_(live_stream)
+{
+}
+
+// Out of line, as FlightRecorder, GlobalPlanner and LivePublisher are incomplete in the header
+AgentSystem::~AgentSystem() = default;
+
+size_t AgentSystem::add_vfh_agent(const toml::table& config)
+{
+    // Rather than quietly running the agent without them (logging is on unless turned off)
+    if (config["logging"].value_or(true)) {
+        throw std::invalid_argument("Batched agents can't log, set 'logging = false'");
+    }
+    if (config["deadline"].is_table()) {
+        throw std::invalid_argument("Batched agents have no deadline monitor, remove [deadline]");
+    }
+
+    // Everything that may throw is built before any of it is stored, so a bad config can't leave
+    // the per agent vectors out of step
+    std::unique_ptr<PhysicsBody> body = world_->create_body(config);
+
+    // NOTE: mirrors VFHAgent, which uses the grid width for both dimensions
+    unsigned grid_size = *config["grid"]["width"].value<unsigned>();
+    auto grid = std::make_unique<HistogramGrid>(grid_size, grid_size);
+    UltrasonicArray sensor(*config["sensor"]["count"].value<unsigned>(),
+                           *config["sensor"]["range"].value<float>(),
+                           world_,
+                           body.get());
+    b2Vec2 goal(*config["goal"]["x"].value<float>(), *config["goal"]["y"].value<float>());
+    std::unique_ptr<FlightRecorder> recorder;
+    if (auto recorder_options = FlightRecorder::options_from_config(config)) {
+        recorder = std::make_unique<FlightRecorder>(*recorder_options);
+    }
+    std::unique_ptr<GlobalPlanner> planner;
+    if (auto planner_options = GlobalPlanner::options_from_config(config)) {
+        planner = std::make_unique<GlobalPlanner>(*planner_options, *grid, goal);
+        grid->track_changes(true);
+    }
+    std::unique_ptr<LivePublisher> publisher;
+    if (live_stream_) {
+        std::string name = config["name"].value_or(std::string());
+        publisher = std::make_unique<LivePublisher>(live_stream_->add_publisher(name));
+    }
+
+    bodies_.push_back(std::move(body));
+    grids_.push_back(std::move(grid));
+    sensors_.push_back(std::move(sensor));
+    goals_.push_back(goal);
+    valley_thresholds_.push_back(*config["valley_threshold"].value<float>());
+    v_maxs_.push_back(config["speed"].value_or(1.0));
+    recorders_.push_back(std::move(recorder));
+    planners_.push_back(std::move(planner));
+    publishers_.push_back(std::move(publisher));
+
+    size_t n = bodies_.size();
+    cell_x_.resize(n);
+    cell_y_.resize(n);
+    target_sectors_.resize(n);
+    window_valid_.resize(n);
+    windows_.resize(n * WINDOW_SIZE_SQUARED);
+    sectors_.resize(n * K);
+    polar_histograms_.resize(n * K);
+    commands_.resize(n);
+
+    return n - 1;
+}
+
+void AgentSystem::step(float delta_t)
+{
+    // TODO: use delta_t to fire the sensors in series (see VFHAgent::step)
+    JUST_TRACE_SCOPE("agent_system_step");
+
+    gather_poses();
+    {
+        JUST_TRACE_SCOPE("sense");
+        sense();
+    }
+    {
+        JUST_TRACE_SCOPE("global_plan");
+        plan();
+    }
+    {
+        JUST_TRACE_SCOPE("plan");
+        extract_windows();
+        project();
+        smooth();
+        steer();
+    }
+    apply_commands();
+    record(delta_t);
+    publish();
+}
+
+void AgentSystem::dump_flight_recorders()
+{
+    for (auto& recorder : recorders_) {
+        if (recorder) {
+            recorder->dump("request");
+        }
+    }
+}
+
+void AgentSystem::gather_poses()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        const PhysicsBody* body = bodies_[i].get();
+        b2Vec2 position = body->position();
+        cell_x_[i] = std::lround(position.x);
+        cell_y_[i] = std::lround(position.y);
+        target_sectors_[i] = VFHAgent::target_sector(body->local_point(goals_[i]));
+    }
+}
+
+void AgentSystem::sense()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        auto sensor_readings = sensors_[i].sense_all();
+        HistogramGrid& grid = *grids_[i];
+        float max_range = sensors_[i].max_range();
+
+        for (const auto& [distance, angle] : sensor_readings) {
+            if (distance < 0.0) {
+                grid.add_percept(cell_x_[i], cell_y_[i], angle, max_range, false);
+            } else {
+                grid.add_percept(cell_x_[i], cell_y_[i], angle, distance, true);
+            }
+        }
+    }
+}
+
+void AgentSystem::plan()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        GlobalPlanner* planner = planners_[i].get();
+        if (!planner) {
+            continue;
+        }
+
+        // Without logging, nothing else needs the grid's changes once the planner has them
+        HistogramGrid& grid = *grids_[i];
+        planner->update_cells(grid, grid.changed_cells());
+        grid.clear_changed_cells();
+        const PhysicsBody* body = bodies_[i].get();
+        b2Vec2 subgoal = planner->subgoal(body->position());
+        target_sectors_[i] = VFHAgent::target_sector(body->local_point(subgoal));
+    }
+}
+
+void AgentSystem::extract_windows()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        window_valid_[i] = grids_[i]->copy_subgrid<WINDOW_SIZE, WINDOW_SIZE>(cell_x_[i],
+                                                                            cell_y_[i],
+                                                                            window(i));
+    }
+}
+
+void AgentSystem::project()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        if (window_valid_[i]) {
+            VFHAgent::project_window(window(i), sectors(i));
+        }
+    }
+}
+
+void AgentSystem::smooth()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        if (window_valid_[i]) {
+            VFHAgent::smooth_sectors(sectors(i), polar_histogram(i));
+        }
+    }
+}
+
+void AgentSystem::steer()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        if (!window_valid_[i]) {
+            commands_[i] = {0.0, 0.0};
+            continue;
+        }
+
+        auto heading_opt = VFHAgent::select_heading(polar_histogram(i),
+                                                    target_sectors_[i],
+                                                    valley_thresholds_[i]);
+        if (heading_opt) {
+            commands_[i] = VFHAgent::steering_command(polar_histogram(i),
+                                                      *heading_opt,
+                                                      valley_thresholds_[i],
+                                                      v_maxs_[i]);
+        } else {
+            commands_[i] = {0.0, 0.0};
+        }
+    }
+}
+
+void AgentSystem::apply_commands()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        if (!window_valid_[i]) {
+            // Hit the edge of the map, same as VFHAgent: sit still
+            bodies_[i]->set_linear_velocity({0.0f, 0.0f});
+            bodies_[i]->set_angular_velocity(0.0f);
+            continue;
+        }
+
+        auto [angle, speed] = commands_[i];
+        bodies_[i]->set_linear_velocity({speed * std::cos(angle), speed * std::sin(angle)});
+    }
+}
+
+void AgentSystem::record(float delta_t)
+{
+    for (size_t i = 0; i < size(); ++i) {
+        FlightRecorder* recorder = recorders_[i].get();
+        if (!recorder) {
+            continue;
+        }
+
+        recorder->begin_step(delta_t);
+        if (window_valid_[i]) {
+            recorder->record_window(window(i));
+            recorder->record_polar_histogram(polar_histogram(i));
+        }
+        b2Vec2 position = bodies_[i]->position();
+        auto [angle, speed] = commands_[i];
+        recorder->record_motion(angle, speed, position.x, position.y);
+        recorder->end_step(speed == 0.0, bodies_[i]->in_contact());
+    }
+}
+
+void AgentSystem::publish()
+{
+    for (size_t i = 0; i < size(); ++i) {
+        LivePublisher* publisher = publishers_[i].get();
+        if (!publisher) {
+            continue;
+        }
+
+        if (window_valid_[i]) {
+            publisher->publish_window(window(i));
+            publisher->publish_polar_histogram(polar_histogram(i));
+        }
+        b2Vec2 position = bodies_[i]->position();
+        auto [angle, speed] = commands_[i];
+        publisher->publish_motion(angle, speed, position.x, position.y);
+        publisher->end_step();
+    }
+}
+
+std::span<uint8_t, AgentSystem::WINDOW_SIZE_SQUARED> AgentSystem::window(size_t idx)
+{
+    return std::span<uint8_t, WINDOW_SIZE_SQUARED>(&windows_[idx * WINDOW_SIZE_SQUARED],
+                                                   WINDOW_SIZE_SQUARED);
+}
+
+std::span<uint32_t, AgentSystem::K> AgentSystem::sectors(size_t idx)
+{
+    return std::span<uint32_t, K>(&sectors_[idx * K], K);
+}
+
+std::span<float, AgentSystem::K> AgentSystem::polar_histogram(size_t idx)
+{
+    return std::span<float, K>(&polar_histograms_[idx * K], K);
+}
+
+} // namespace just
+
+TEST_CASE("AgentSystem matches VFHAgent") {
+    toml::table config{
+        {"name", "batched"},
+        {"type", "vfh"},
+        {"logging", false},
+        {"grid", toml::table{{"width", 100}, {"height", 100}}},
+        {"sensor", toml::table{{"count", 24}, {"range", 25.0}}},
+        {"goal", toml::table{{"x", 20.0}, {"y", 0.0}}},
+        {"valley_threshold", 10000.0},
+        {"speed", 5.0},
+        {"shape", "circle"},
+        {"radius", 1.0},
+        {"x", -20.0},
+        {"y", 0.0},
+    };
+
+    SUBCASE("Steering straight for the goal") {}
+    SUBCASE("Steering for global planner subgoals") {
+        config.insert("planner", toml::table{{"cell_size", 5}, {"lookahead", 5.0}});
+    }
+
+    // Each agent gets its own (identical) world so they can't sense each other
+    auto create_world = [] {
+        auto world = std::make_unique<just::Box2DWorld>();
+        world->add_obstacle(toml::table{
+            {"shape", "box"},
+            {"width", 4.0},
+            {"height", 10.0},
+            {"y", 1.0},
+        });
+        return world;
+    };
+
+    auto single_world = create_world();
+    auto batched_world = create_world();
+
+    just::VFHAgent agent(config, single_world.get());
+    just::AgentSystem system(batched_world.get());
+    REQUIRE(system.add_vfh_agent(config) == 0);
+    REQUIRE(system.size() == 1);
+
+    const float delta_t = 0.02;
+    for (int i = 0; i < 200; ++i) {
+        agent.step(delta_t);
+        system.step(delta_t);
+        single_world->step(delta_t);
+        batched_world->step(delta_t);
+
+        b2Vec2 single_position = agent.get_body()->position();
+        b2Vec2 batched_position = system.get_body(0)->position();
+        REQUIRE(single_position.x == batched_position.x);
+        REQUIRE(single_position.y == batched_position.y);
+    }
+
+    // Sanity check that the agent actually went somewhere
+    CHECK(agent.get_body()->position().x > -20.0);
+
+    // Logging and deadlines would be silently ignored, so they're rejected
+    toml::table logging = config;
+    logging.insert_or_assign("logging", true);
+    CHECK_THROWS_AS(system.add_vfh_agent(logging), std::invalid_argument);
+    toml::table deadline = config;
+    deadline.insert("deadline", toml::table{{"budget", 0.005}});
+    CHECK_THROWS_AS(system.add_vfh_agent(deadline), std::invalid_argument);
+    CHECK(system.size() == 1);
+}
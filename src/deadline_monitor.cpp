@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "doctest/doctest.h"
+
+#include "just/deadline_monitor.hpp"
+
+namespace just
+{
+
+std::optional<DeadlineMonitor::Options> DeadlineMonitor::options_from_config(
+    const toml::table& agent_config)
+{
+    const toml::table* table = agent_config["deadline"].as_table();
+    if (!table) {
+        return std::nullopt;
+    }
+
+    Options options;
+    options.budget = (*table)["budget"].value_or(options.budget);
+    options.escalate_after = (*table)["escalate_after"].value_or(options.escalate_after);
+    options.recover_after = (*table)["recover_after"].value_or(options.recover_after);
+    options.beam_fraction = (*table)["beam_fraction"].value_or(options.beam_fraction);
+    return options;
+}
+
+DeadlineMonitor::DeadlineMonitor(Options options)
+    : options_(options),
+      budget_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::duration<float>(options.budget)))
+{
+    if (options_.budget <= 0.0 || options_.escalate_after == 0 || options_.recover_after == 0) {
+        throw std::invalid_argument(
+            "DeadlineMonitor budget, escalate_after and recover_after must be positive");
+    }
+    if (options_.beam_fraction <= 0.0 || options_.beam_fraction > 1.0) {
+        throw std::invalid_argument("DeadlineMonitor beam_fraction must be in (0, 1]");
+    }
+}
+
+bool DeadlineMonitor::record(std::chrono::nanoseconds step_time)
+{
+    ++steps_;
+    worst_ = std::max(worst_, step_time);
+
+    ShedLevel previous = level_;
+    if (step_time > budget_) {
+        ++overruns_;
+        ++consecutive_overruns_;
+        consecutive_within_budget_ = 0;
+        if (consecutive_overruns_ >= options_.escalate_after
+            && level_ != ShedLevel::CACHED_POLAR_HISTOGRAM) {
+            level_ = static_cast<ShedLevel>(static_cast<uint8_t>(level_) + 1);
+            consecutive_overruns_ = 0;
+        }
+    } else {
+        ++consecutive_within_budget_;
+        consecutive_overruns_ = 0;
+        if (consecutive_within_budget_ >= options_.recover_after && level_ != ShedLevel::NONE) {
+            level_ = static_cast<ShedLevel>(static_cast<uint8_t>(level_) - 1);
+            consecutive_within_budget_ = 0;
+        }
+    }
+    return level_ != previous;
+}
+
+const char* DeadlineMonitor::level_name(ShedLevel level)
+{
+    switch (level) {
+    case ShedLevel::NONE:
+        return "none";
+    case ShedLevel::SKIP_LOGGING:
+        return "skip logging";
+    case ShedLevel::REDUCE_BEAMS:
+        return "reduce beams";
+    case ShedLevel::CACHED_POLAR_HISTOGRAM:
+        return "cached polar histogram";
+    }
+    return "unknown";
+}
+
+} // namespace just
+
+TEST_CASE("DeadlineMonitor sheds and recovers") {
+    using namespace std::chrono_literals;
+    using ShedLevel = just::DeadlineMonitor::ShedLevel;
+
+    just::DeadlineMonitor::Options options;
+    options.budget = 0.001;
+    options.escalate_after = 2;
+    options.recover_after = 3;
+    just::DeadlineMonitor monitor(options);
+
+    // Isolated overruns are counted, but don't shed anything
+    CHECK_FALSE(monitor.record(2ms));
+    CHECK_FALSE(monitor.record(500us));
+    CHECK_FALSE(monitor.record(2ms));
+    CHECK(monitor.level() == ShedLevel::NONE);
+    CHECK(monitor.overruns() == 2);
+    CHECK(monitor.worst() == 2ms);
+
+    // Sustained overload escalates one level at a time, up to the last
+    CHECK(monitor.record(2ms));
+    CHECK(monitor.level() == ShedLevel::SKIP_LOGGING);
+    for (int i = 0; i < 10; ++i) {
+        monitor.record(5ms);
+    }
+    CHECK(monitor.level() == ShedLevel::CACHED_POLAR_HISTOGRAM);
+    CHECK(monitor.shedding(ShedLevel::SKIP_LOGGING));
+    CHECK(monitor.shedding(ShedLevel::REDUCE_BEAMS));
+
+    // And recovers one level at a time once back within budget
+    monitor.record(100us);
+    monitor.record(100us);
+    CHECK(monitor.record(100us));
+    CHECK(monitor.level() == ShedLevel::REDUCE_BEAMS);
+    CHECK_FALSE(monitor.shedding(ShedLevel::CACHED_POLAR_HISTOGRAM));
+    for (int i = 0; i < 6; ++i) {
+        monitor.record(100us);
+    }
+    CHECK(monitor.level() == ShedLevel::NONE);
+    CHECK(monitor.steps() == 23);
+
+    options.beam_fraction = 0.0;
+    CHECK_THROWS_AS(just::DeadlineMonitor{options}, std::invalid_argument);
+}
+
+TEST_CASE("DeadlineMonitor options from config") {
+    CHECK_FALSE(just::DeadlineMonitor::options_from_config(toml::table{{"name", "a"}}));
+
+    toml::table config{
+        {"name", "a"},
+        {"deadline", toml::table{{"budget", 0.005}, {"recover_after", 10}}},
+    };
+    auto options = just::DeadlineMonitor::options_from_config(config);
+    REQUIRE(options);
+    CHECK(options->budget == doctest::Approx(0.005));
+    CHECK(options->recover_after == 10);
+    CHECK(options->escalate_after == 3);
+}
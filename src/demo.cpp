@@ -3,78 +3,75 @@
 #include <string_view>
 #include <memory>
 #include <utility>
+#include <optional>
+#include <string>
+#include <exception>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include "raylib.h"
 #include "raymath.h"
-#include "box2d/box2d.h"
 #include "toml++/toml.hpp"
 
 #include "just/agent.hpp"
+#include "just/agent_system.hpp"
+#include "just/grid_snapshot.hpp"
+#include "just/live_stream.hpp"
+#include "just/occupancy_map.hpp"
+#include "just/physics.hpp"
+#include "just/scenario.hpp"
+#include "just/scheduler.hpp"
+#include "just/telemetry.hpp"
+#include "just/trace.hpp"
+#include "just/triple_buffer.hpp"
 #include "just/world_model.hpp"
 #include "just/visualization.hpp"
 
-std::unique_ptr<just::Visualization> viz_factory(const toml::table& config,
-                                                 const just::Visualizer& visualizer)
+struct AgentPose
 {
-    if (auto viz_shape_opt = config["shape"].value<std::string>()) {
-        std::string color = config["color"].value_or("blue");
-        if (*viz_shape_opt == "box") {
-            float width = config["width"].value_or(1);
-            float height = config["height"].value_or(1);
-            auto viz = visualizer.create_rectangle_viz(width, height, color);
-            return std::make_unique<just::RectangleViz>(viz);
-        } else if (*viz_shape_opt == "circle") {
-            float radius = config["radius"].value_or(1.0);
-            auto viz = visualizer.create_circle_viz(radius, color);
-            return std::make_unique<just::CircleViz>(viz);
-        }
-    }
-
-    return nullptr;
-}
+    b2Vec2 position;
+    float angle;
+};
 
-std::unique_ptr<just::Agent> agent_factory(const toml::table& agent_config, b2World* world)
+// What the render thread draws, published by the simulation thread after every physics step.
+// Obstacles and markers never move, those are drawn from the visualizer's static layer instead.
+struct Snapshot
+{
+    double time{0.0};
+    // Individually stepped agents first, then batched ones
+    std::vector<AgentPose> agents;
+    // One per grid overlay
+    std::vector<just::GridSnapshot> grids;
+};
+
+std::unique_ptr<just::Agent> agent_factory(const toml::table& agent_config,
+                                           just::PhysicsWorld* world,
+                                           just::Telemetry* telemetry,
+                                           just::LiveStream* live_stream)
 {
     if (auto agent_type_opt = agent_config["type"].value<std::string>()) {
         if (*agent_type_opt == "vfh") {
-            return std::make_unique<just::VFHAgent>(agent_config, world);
+            return std::make_unique<just::VFHAgent>(agent_config, world, telemetry, live_stream);
         } else if (*agent_type_opt == "patrol") {
             return std::make_unique<just::PatrolAgent>(agent_config, world);
+        } else if (*agent_type_opt == "dwa") {
+            return std::make_unique<just::DWAAgent>(agent_config, world);
         }
     }
 
     return nullptr;
 }
 
-b2Body* obstacle_body_factory(const toml::table& obstacle_config, b2World* world)
+// The map of agents that keep one, for drawing it
+just::HistogramGrid* grid_of(just::Agent* agent)
 {
-    // Obstacle
-    b2BodyDef body_def;
-    body_def.type = b2_staticBody;
-    body_def.position.Set(obstacle_config["x"].value_or(0.0), obstacle_config["y"].value_or(0.0));
-    body_def.angle = obstacle_config["theta"].value_or(0.0);
-    b2Body* body = world->CreateBody(&body_def);
-
-    b2FixtureDef fixture_def;
-    fixture_def.density = obstacle_config["density"].value_or(1.0);
-    std::string_view shape_str = obstacle_config["shape"].value_or("box");
-    if (shape_str == "circle") {
-        b2CircleShape shape;
-        shape.m_radius = obstacle_config["radius"].value_or(1.0);
-        fixture_def.shape = &shape;
-        body->CreateFixture(&fixture_def);
-    } else if (shape_str == "box") {
-        b2PolygonShape shape;
-        float width = obstacle_config["width"].value_or(1.0) / 2.0;
-        float height = obstacle_config["height"].value_or(1.0) / 2.0;
-        shape.SetAsBox(width, height);
-        fixture_def.shape = &shape;
-        body->CreateFixture(&fixture_def);
-    } else {
-        return nullptr;
+    if (auto vfh_agent = dynamic_cast<just::VFHAgent*>(agent)) {
+        return &vfh_agent->grid();
+    } else if (auto dwa_agent = dynamic_cast<just::DWAAgent*>(agent)) {
+        return &dwa_agent->grid();
     }
-
-    return body;
+    return nullptr;
 }
 
 int main(int argc, char** argv)
@@ -93,6 +90,14 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    // A [scenario] table generates agents and obstacles on top of the config's own
+    try {
+        just::expand_scenario(config);
+    } catch (const std::exception& err) {
+        std::cerr << "Error: " << err.what() << std::endl;
+        return 6;
+    }
+
     int width = config["world"]["width"].value_or(1000);
     int height = config["world"]["height"].value_or(1000);
     float scale = config["world"]["scale"].value_or(10.0);
@@ -100,14 +105,76 @@ int main(int argc, char** argv)
 
     just::Visualizer visualizer(width, height, scale, fps);
 
-    b2World* world = new b2World({0.0, 0.0});
+    // Optionally, trace the simulation loop and write it out as Chrome Trace Event JSON at exit
+    std::optional<std::string> trace_file = config["world"]["trace"].value<std::string>();
+#ifdef JUST_ENABLE_TRACING
+    if (trace_file) {
+        JUST_TRACE_THREAD_NAME("main");
+        just::Tracer::global().enable(true);
+    }
+#else
+    if (trace_file) {
+        std::cout << "Built without JUST_ENABLE_TRACING, not writing a trace" << std::endl;
+    }
+#endif
+
+    // Box2D unless the config asks for another backend, e.g. "kinematic" for large swarms
+    std::unique_ptr<just::PhysicsWorld> world;
+    try {
+        const toml::table* world_config = config["world"].as_table();
+        world = just::make_physics_world(world_config ? *world_config : toml::table{});
+    } catch (const std::exception& err) {
+        std::cerr << "Error: " << err.what() << std::endl;
+        return 4;
+    }
+
+    // Physics runs at a fixed rate, agents at their own 'control_rate' (every physics step if
+    // unset)
+    float physics_rate = config["world"]["physics_rate"].value_or(static_cast<float>(fps));
+    float control_rate = config["world"]["control_rate"].value_or(0.0f);
+    just::Scheduler scheduler(physics_rate, [&world](float delta_t) {
+        JUST_TRACE_SCOPE("world_step");
+        world->step(delta_t);
+    });
+
+    // Optionally, all agents log to a single shared telemetry file
+    std::unique_ptr<just::Telemetry> telemetry;
+    if (auto telemetry_file = config["world"]["telemetry"].value<std::string>()) {
+        telemetry = std::make_unique<just::Telemetry>(*telemetry_file);
+    }
+
+    // Optionally, every agent's steps are published to shared memory for live plotting
+    std::unique_ptr<just::LiveStream> live_stream;
+    if (auto live_stream_name = config["world"]["live_stream"].value<std::string>()) {
+        size_t slot_count = 0;
+        if (toml::array* agent_configs = config["agents"].as_array()) {
+            slot_count = agent_configs->size();
+        }
+        live_stream = std::make_unique<just::LiveStream>(*live_stream_name, slot_count);
+    }
+
+    // When batched, VFH agents are stepped together by an AgentSystem instead of one at a time
+    bool batched = config["world"]["batched"].value_or(false);
+    auto agent_system = std::make_unique<just::AgentSystem>(world.get(), live_stream.get());
+    std::vector<std::unique_ptr<just::Visualization>> system_vizs;
+    // Live views of the maps of agents with 'grid_overlay' set, toggled with G. Their grids are
+    // snapshotted on the simulation thread and drawn as overlays on the render thread.
+    std::vector<just::GridSnapshotter> grid_snapshotters;
+    std::vector<std::unique_ptr<just::GridOverlay>> grid_overlays;
+    bool show_grid_overlays = true;
 
     // Agent
     using AgentPair = std::pair<std::unique_ptr<just::Agent>, std::unique_ptr<just::Visualization>>;
     std::vector<AgentPair> agent_pairs;
+    bool invalid_agent = false;
     if (toml::array* agent_configs = config["agents"].as_array()) {
-        agent_configs->for_each([&agent_pairs, &world, &visualizer](toml::table agent_config) {
-            auto viz_ptr = viz_factory(agent_config, visualizer);
+        agent_configs->for_each([&agent_pairs, &world, &visualizer, batched, &agent_system,
+                                 &system_vizs, &grid_snapshotters, &grid_overlays, &scheduler,
+                                 control_rate, &invalid_agent,
+                                 &telemetry, &live_stream](toml::table agent_config) {
+            auto viz_ptr = just::viz_factory(agent_config, visualizer);
+            bool grid_overlay = agent_config["grid_overlay"].value_or(false);
+            std::string color = agent_config["color"].value_or("blue");
 
             if (!viz_ptr) {
                 std::cout << "Agent visualization options are missing or invalid, "
@@ -117,7 +184,40 @@ int main(int argc, char** argv)
                 return;
             }
 
-            auto agent_ptr = agent_factory(agent_config, world);
+            // Agents validate their configs as they're built, an invalid one ends the demo once
+            // every agent has been tried (so all the errors are reported at once)
+            auto report = [&](const std::exception& err) {
+                std::cerr << "Error: " << err.what() << ", in agent: "
+                          << agent_config["name"].value_or("<name missing>") << std::endl;
+                invalid_agent = true;
+            };
+
+            if (batched && agent_config["type"].value_or(std::string()) == "vfh") {
+                size_t idx;
+                try {
+                    idx = agent_system->add_vfh_agent(agent_config);
+                } catch (const std::exception& err) {
+                    report(err);
+                    return;
+                }
+                system_vizs.push_back(std::move(viz_ptr));
+                if (grid_overlay) {
+                    grid_snapshotters.emplace_back(agent_system->grid(idx));
+                    grid_overlays.push_back(visualizer.create_grid_overlay(color));
+                }
+                return;
+            }
+
+            std::unique_ptr<just::Agent> agent_ptr;
+            try {
+                agent_ptr = agent_factory(agent_config,
+                                          world.get(),
+                                          telemetry.get(),
+                                          live_stream.get());
+            } catch (const std::exception& err) {
+                report(err);
+                return;
+            }
 
             if (!agent_ptr) {
                 std::cout << "Agent type is missing or invalid, skipping agent: "
@@ -125,19 +225,39 @@ int main(int argc, char** argv)
                           << std::endl;
                 return;
             }
+            just::Agent* agent = agent_ptr.get();
+            if (grid_overlay) {
+                if (just::HistogramGrid* grid = grid_of(agent)) {
+                    grid_snapshotters.emplace_back(*grid);
+                    grid_overlays.push_back(visualizer.create_grid_overlay(color));
+                } else {
+                    std::cout << "Agent has no grid to overlay: "
+                              << agent_config["name"].value_or("<name missing>")
+                              << std::endl;
+                }
+            }
+            scheduler.add_task(agent_config["control_rate"].value_or(control_rate),
+                               [agent](float delta_t) { agent->step(delta_t); });
             agent_pairs.emplace_back(std::move(agent_ptr), std::move(viz_ptr));
         });
-        if (agent_pairs.empty()) {
+        if (invalid_agent) {
+            return 3;
+        }
+        if (agent_pairs.empty() && agent_system->size() == 0) {
             std::cout << "Error parsing 'agents' array in config, exiting" << std::endl;
             return 3;
         }
     }
 
-    using ObstacleTuple = std::tuple<float, float, std::unique_ptr<just::Visualization>>;
-    std::vector<ObstacleTuple> obstacles;
+    if (agent_system->size() > 0) {
+        just::AgentSystem* system = agent_system.get();
+        scheduler.add_task(control_rate, [system](float delta_t) { system->step(delta_t); });
+    }
+
+    // Obstacles and markers never move, so they go into the visualizer's static layer
     if (toml::array* obstacle_configs = config["obstacles"].as_array()) {
-        obstacle_configs->for_each([&obstacles, &world, &visualizer](toml::table obstacle_config) {
-            auto viz_ptr = viz_factory(obstacle_config, visualizer);
+        obstacle_configs->for_each([&world, &visualizer](toml::table obstacle_config) {
+            auto viz_ptr = just::viz_factory(obstacle_config, visualizer);
 
             if (!viz_ptr) {
                 std::cout << "Obstacle visualization options are missing or invalid, "
@@ -146,9 +266,10 @@ int main(int argc, char** argv)
                 return;
             }
 
-            if (auto body_ptr = obstacle_body_factory(obstacle_config, world)) {
-                const auto& [x, y] = body_ptr->GetPosition();
-                obstacles.emplace_back(x, y, std::move(viz_ptr));
+            if (world->add_obstacle(obstacle_config)) {
+                float x = obstacle_config["x"].value_or(0.0);
+                float y = obstacle_config["y"].value_or(0.0);
+                visualizer.add_static_viz(x, y, 0.0, std::move(viz_ptr));
             } else {
                 std::cout << "Obstacle body options are missing or invalid, "
                           << "skipping obstacle."
@@ -157,11 +278,26 @@ int main(int argc, char** argv)
         });
     }
 
-    using MarkerTuple = std::tuple<float, float, std::unique_ptr<just::Visualization>>;
-    std::vector<MarkerTuple> markers;
+    // Optionally, static obstacles read from an occupancy image (e.g. a floor plan). Occupied
+    // pixels are merged into rectangles, so the map takes far fewer bodies than cells.
+    if (const toml::table* map_config = config["map"].as_table()) {
+        std::string image = (*map_config)["image"].value_or(std::string());
+        try {
+            auto options = just::OccupancyMap::options_from_config(*map_config);
+            auto map = just::OccupancyMap::load(image, options);
+            size_t boxes = world->add_occupancy_map(map);
+            just::add_map_vizs(map, (*map_config)["color"].value_or("white"), visualizer);
+            std::cout << "Loaded map '" << image << "' (" << map.width() << "x" << map.height()
+                      << " pixels) as " << boxes << " boxes" << std::endl;
+        } catch (const std::exception& err) {
+            std::cerr << "Error: " << err.what() << std::endl;
+            return 5;
+        }
+    }
+
     if (toml::array* marker_configs = config["markers"].as_array()) {
-        marker_configs->for_each([&markers, &visualizer](toml::table marker_config) {
-            auto viz_ptr = viz_factory(marker_config, visualizer);
+        marker_configs->for_each([&visualizer](toml::table marker_config) {
+            auto viz_ptr = just::viz_factory(marker_config, visualizer);
 
             if (!viz_ptr) {
                 std::cout << "Marker visualization options are missing or invalid, "
@@ -173,45 +309,141 @@ int main(int argc, char** argv)
             float x = marker_config["x"].value_or(0.0);
             float y = marker_config["y"].value_or(0.0);
 
-            markers.emplace_back(x, y, std::move(viz_ptr));
+            visualizer.add_static_viz(x, y, 0.0, std::move(viz_ptr));
         });
     }
 
-    b2Vec2 pos;
-    float rot;
-    while (!WindowShouldClose()) {
-        float delta = GetFrameTime();
-        world->Step(delta, 10, 8);
+    // Drawn in the order of the snapshots' agent poses
+    std::vector<const just::Visualization*> agent_vizs;
+    for (const auto& [agent_ptr, viz_ptr] : agent_pairs) {
+        agent_vizs.push_back(viz_ptr.get());
+    }
+    for (const auto& viz_ptr : system_vizs) {
+        agent_vizs.push_back(viz_ptr.get());
+    }
 
-        visualizer.begin_drawing();
+    // The simulation runs on a thread of its own, publishing a snapshot of the scene after every
+    // physics step, while this thread (which owns the window) draws the latest one. Neither waits
+    // for the other, so slow frames or vsync no longer slow down the simulation. In real time it
+    // keeps pace with the clock, otherwise it runs as fast as it can.
+    bool realtime = config["world"]["realtime"].value_or(true);
+    just::TripleBuffer<Snapshot> snapshots;
+    std::atomic<bool> running{true};
+    std::atomic<bool> dump_requested{false};
+    std::thread simulation([&] {
+        JUST_TRACE_THREAD_NAME("simulation");
+        using Clock = std::chrono::steady_clock;
+        auto step_period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<float>(scheduler.physics_dt()));
+        auto last = Clock::now();
+        size_t published_steps = 0;
+        while (running.load(std::memory_order_relaxed)) {
+            if (dump_requested.exchange(false, std::memory_order_relaxed)) {
+                for (const auto& [agent_ptr, viz_ptr] : agent_pairs) {
+                    agent_ptr->dump_flight_recorder();
+                }
+                agent_system->dump_flight_recorders();
+            }
 
-        const char* txt = "Hello Just";
-        int txt_width = MeasureText(txt, 36);
-        DrawText(txt, (width - txt_width) / 2.0, 0, 36, GRAY);
+            auto now = Clock::now();
+            if (realtime) {
+                scheduler.advance(std::chrono::duration<float>(now - last).count());
+                last = now;
+            } else {
+                scheduler.advance(scheduler.physics_dt());
+            }
+
+            if (scheduler.physics_steps() != published_steps) {
+                JUST_TRACE_SCOPE("snapshot");
+                Snapshot& snapshot = snapshots.write_buffer();
+                snapshot.time = scheduler.time();
+                snapshot.agents.clear();
+                for (const auto& [agent_ptr, viz_ptr] : agent_pairs) {
+                    const auto body = agent_ptr->get_body();
+                    snapshot.agents.push_back({body->position(), body->angle()});
+                }
+                for (size_t i = 0; i < agent_system->size(); ++i) {
+                    const auto body = agent_system->get_body(i);
+                    snapshot.agents.push_back({body->position(), body->angle()});
+                }
+                snapshot.grids.resize(grid_snapshotters.size());
+                for (size_t i = 0; i < grid_snapshotters.size(); ++i) {
+                    grid_snapshotters[i].write(snapshot.grids[i]);
+                }
+                snapshots.publish();
+                published_steps = scheduler.physics_steps();
+            }
 
-        for (const auto& [x, y, viz_ptr] : obstacles) {
-            visualizer.draw_viz(x, y, 0.0, *viz_ptr);
+            if (realtime) {
+                std::this_thread::sleep_until(now + step_period);
+            }
         }
+    });
 
-        for (const auto& [x, y, viz_ptr] : markers) {
-            visualizer.draw_viz(x, y, 0.0, *viz_ptr);
+    while (!WindowShouldClose()) {
+        if (IsKeyPressed(KEY_D)) {
+            std::cout << "Dumping flight recorders" << std::endl;
+            dump_requested.store(true, std::memory_order_relaxed);
+        }
+        if (IsKeyPressed(KEY_G)) {
+            show_grid_overlays = !show_grid_overlays;
         }
 
-        for (const auto& [agent_ptr, viz_ptr] : agent_pairs) {
-            const auto body = agent_ptr->get_body();
+        visualizer.update_camera();
+
+        snapshots.update();
+        const Snapshot& snapshot = snapshots.read_buffer();
+
+        JUST_TRACE_SCOPE("render");
+        visualizer.begin_drawing();
+
+        visualizer.draw_static_layer();
 
-            pos = body->GetPosition();
-            rot = -body->GetAngle() * RAD2DEG;
-            visualizer.draw_viz(pos.x, pos.y, rot, *viz_ptr);
+        visualizer.begin_world();
+        if (show_grid_overlays) {
+            for (size_t i = 0; i < snapshot.grids.size(); ++i) {
+                visualizer.draw_grid_overlay(*grid_overlays[i], snapshot.grids[i]);
+            }
+        }
 
-            agent_ptr->step(delta);
+        for (size_t i = 0; i < snapshot.agents.size(); ++i) {
+            const AgentPose& pose = snapshot.agents[i];
+            visualizer.draw_viz(pose.position.x,
+                                pose.position.y,
+                                -pose.angle * RAD2DEG,
+                                *agent_vizs[i]);
         }
+        visualizer.end_world();
+
+        const char* txt = "Hello Just";
+        int txt_width = MeasureText(txt, 36);
+        DrawText(txt, (width - txt_width) / 2.0, 0, 36, GRAY);
+        DrawText(TextFormat("t = %.1f s", snapshot.time), 10, 10, 20, GRAY);
 
         visualizer.end_drawing();
     }
 
+    running.store(false, std::memory_order_relaxed);
+    simulation.join();
+
+    grid_overlays.clear();
+    grid_snapshotters.clear();
     agent_pairs.clear();
-    delete world;
+    agent_system.reset();
+    live_stream.reset();
+    telemetry.reset();
+    world.reset();
+
+#ifdef JUST_ENABLE_TRACING
+    // After tearing down, so the final logger flushes make it into the trace
+    if (trace_file) {
+        if (just::Tracer::global().write_json(*trace_file)) {
+            std::cout << "Wrote trace to " << *trace_file << std::endl;
+        } else {
+            std::cerr << "Failed to write trace to " << *trace_file << std::endl;
+        }
+    }
+#endif
 
     return 0;
 }
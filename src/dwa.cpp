@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "doctest/doctest.h"
+
+#include "just/agent.hpp"
+#include "just/dwa.hpp"
+#include "just/kernels.hpp"
+#include "just/kinematic_world.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+constexpr size_t W = DynamicWindow::WINDOW_SIZE;
+// Window coordinates of the agent's own cell, see HistogramGrid::copy_subgrid
+constexpr int CENTER = W % 2 ? W / 2 : W / 2 - 1;
+constexpr float FAR = std::numeric_limits<float>::max();
+
+// The 'k'th of 'n' evenly spaced values from 'lo' to 'hi'
+float lattice(float lo, float hi, unsigned k, unsigned n)
+{
+    return n == 1 ? (lo + hi) / 2.0f : lo + (hi - lo) * k / (n - 1);
+}
+
+} // namespace
+
+DynamicWindow::Options DynamicWindow::options_from_config(const toml::table& agent_config)
+{
+    Options options;
+    options.max_speed = agent_config["speed"].value_or(options.max_speed);
+
+    const toml::table* table = agent_config["dwa"].as_table();
+    if (!table) {
+        return options;
+    }
+    options.speed_samples = (*table)["speed_samples"].value_or(options.speed_samples);
+    options.turn_samples = (*table)["turn_samples"].value_or(options.turn_samples);
+    options.horizon = (*table)["horizon"].value_or(options.horizon);
+    options.time_step = (*table)["time_step"].value_or(options.time_step);
+    options.max_accel = (*table)["max_accel"].value_or(options.max_accel);
+    options.max_turn_rate = (*table)["max_turn_rate"].value_or(options.max_turn_rate);
+    options.max_turn_accel = (*table)["max_turn_accel"].value_or(options.max_turn_accel);
+    options.threshold = (*table)["threshold"].value_or(options.threshold);
+    options.radius = (*table)["radius"].value_or(options.radius);
+    options.heading_weight = (*table)["heading_weight"].value_or(options.heading_weight);
+    options.clearance_weight = (*table)["clearance_weight"].value_or(options.clearance_weight);
+    options.progress_weight = (*table)["progress_weight"].value_or(options.progress_weight);
+    return options;
+}
+
+DynamicWindow::DynamicWindow(Options options)
+    : options_(options)
+{
+    if (options_.speed_samples == 0 || options_.turn_samples == 0) {
+        throw std::invalid_argument("DynamicWindow needs at least one speed and turn sample");
+    }
+    if (options_.time_step <= 0.0 || options_.horizon < options_.time_step) {
+        throw std::invalid_argument("DynamicWindow horizon must be at least one time_step");
+    }
+    if (options_.max_speed <= 0.0 || options_.max_accel <= 0.0 || options_.max_turn_rate < 0.0
+        || options_.max_turn_accel < 0.0) {
+        throw std::invalid_argument("DynamicWindow speed and acceleration limits must be positive");
+    }
+    // Arcs that don't collide within the horizon are taken to be safe, which only holds if the
+    // agent can stop within it
+    if (options_.max_speed / options_.max_accel > options_.horizon) {
+        throw std::invalid_argument("DynamicWindow horizon is too short to brake from max_speed");
+    }
+
+    rollout_steps_ = std::lround(options_.horizon / options_.time_step);
+    size_t samples = options_.speed_samples * options_.turn_samples;
+    for (auto* values : {&speed_, &turn_rate_, &x_, &y_, &cos_, &sin_, &cos_step_, &sin_step_,
+                         &clearance_}) {
+        values->resize(samples);
+    }
+}
+
+std::optional<DynamicWindow::Velocity> DynamicWindow::choose(
+    std::span<const uint8_t, WINDOW_SIZE_SQUARED> window,
+    b2Vec2 offset,
+    float heading,
+    Velocity current,
+    b2Vec2 goal,
+    float delta_t)
+{
+    compute_distances(window);
+    sample(current, delta_t);
+    rollout(offset, heading);
+
+    // An agent already closer than 'radius' to an obstacle may still move, as long as it doesn't
+    // get any closer
+    float limit = std::min(options_.radius, distance_[CENTER * W + CENTER]);
+    float reach = options_.max_speed * options_.horizon;
+    float clearance_cap = std::max(reach, 2 * options_.radius);
+    b2Vec2 target = goal + offset;
+    float distance = (target - offset).Length();
+
+    std::optional<size_t> best;
+    float best_score = 0.0;
+    for (size_t i = 0; i < sample_count(); ++i) {
+        if (clearance_[i] < limit) {
+            continue;
+        }
+
+        b2Vec2 to_target{target.x - x_[i], target.y - y_[i]};
+        float bearing = std::atan2(to_target.y, to_target.x);
+        float error = std::remainder(bearing - std::atan2(sin_[i], cos_[i]), 2 * M_PI);
+        float score = options_.heading_weight * (1.0 - std::abs(error) / M_PI)
+                      + options_.clearance_weight * std::min(clearance_[i], clearance_cap)
+                            / clearance_cap
+                      + options_.progress_weight * (distance - to_target.Length()) / reach;
+        if (!best || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    if (!best) {
+        return std::nullopt;
+    }
+    return Velocity{speed_[*best], turn_rate_[*best]};
+}
+
+void DynamicWindow::compute_distances(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window)
+{
+    // Two pass chamfer distance transform, with steps of 1 and sqrt(2)
+    constexpr float DIAGONAL = M_SQRT2;
+    for (size_t idx = 0; idx < WINDOW_SIZE_SQUARED; ++idx) {
+        distance_[idx] = window[idx] >= options_.threshold ? 0.0f : FAR;
+    }
+    auto relax = [this](size_t idx, size_t row, size_t col, float step) {
+        if (row < W && col < W) {
+            distance_[idx] = std::min(distance_[idx], distance_[row * W + col] + step);
+        }
+    };
+    for (size_t row = 0; row < W; ++row) {
+        for (size_t col = 0; col < W; ++col) {
+            size_t idx = row * W + col;
+            // Relies on unsigned wrap around to skip neighbours before the first row/column
+            relax(idx, row, col - 1, 1.0);
+            relax(idx, row - 1, col - 1, DIAGONAL);
+            relax(idx, row - 1, col, 1.0);
+            relax(idx, row - 1, col + 1, DIAGONAL);
+        }
+    }
+    for (size_t row = W; row-- > 0;) {
+        for (size_t col = W; col-- > 0;) {
+            size_t idx = row * W + col;
+            relax(idx, row, col + 1, 1.0);
+            relax(idx, row + 1, col + 1, DIAGONAL);
+            relax(idx, row + 1, col, 1.0);
+            relax(idx, row + 1, col - 1, DIAGONAL);
+        }
+    }
+}
+
+void DynamicWindow::sample(Velocity current, float delta_t)
+{
+    float speed_lo = std::clamp(current.speed - options_.max_accel * delta_t,
+                                0.0f,
+                                options_.max_speed);
+    float speed_hi = std::clamp(current.speed + options_.max_accel * delta_t,
+                                speed_lo,
+                                options_.max_speed);
+    float turn_lo = std::clamp(current.turn_rate - options_.max_turn_accel * delta_t,
+                               -options_.max_turn_rate,
+                               options_.max_turn_rate);
+    float turn_hi = std::clamp(current.turn_rate + options_.max_turn_accel * delta_t,
+                               turn_lo,
+                               options_.max_turn_rate);
+
+    size_t i = 0;
+    for (unsigned s = 0; s < options_.speed_samples; ++s) {
+        for (unsigned t = 0; t < options_.turn_samples; ++t, ++i) {
+            speed_[i] = lattice(speed_lo, speed_hi, s, options_.speed_samples);
+            turn_rate_[i] = lattice(turn_lo, turn_hi, t, options_.turn_samples);
+            cos_step_[i] = std::cos(turn_rate_[i] * options_.time_step);
+            sin_step_[i] = std::sin(turn_rate_[i] * options_.time_step);
+        }
+    }
+}
+
+void DynamicWindow::rollout(b2Vec2 offset, float heading)
+{
+    size_t n = sample_count();
+    std::fill(x_.begin(), x_.end(), offset.x);
+    std::fill(y_.begin(), y_.end(), offset.y);
+    std::fill(cos_.begin(), cos_.end(), std::cos(heading));
+    std::fill(sin_.begin(), sin_.end(), std::sin(heading));
+    std::fill(clearance_.begin(), clearance_.end(), distance_[CENTER * W + CENTER]);
+
+    float dt = options_.time_step;
+    for (size_t step = 0; step < rollout_steps_; ++step) {
+        kernels().rollout_step(n,
+                               dt,
+                               speed_.data(),
+                               cos_step_.data(),
+                               sin_step_.data(),
+                               cos_.data(),
+                               sin_.data(),
+                               x_.data(),
+                               y_.data());
+
+        // Arcs that leave the window aren't scored any further, nothing is known about beyond it
+        for (size_t i = 0; i < n; ++i) {
+            int col = static_cast<int>(std::floor(x_[i] + 0.5f)) + CENTER;
+            int row = static_cast<int>(std::floor(y_[i] + 0.5f)) + CENTER;
+            if (col >= 0 && row >= 0 && col < static_cast<int>(W) && row < static_cast<int>(W)) {
+                clearance_[i] = std::min(clearance_[i], distance_[row * W + col]);
+            }
+        }
+    }
+}
+
+} // namespace just
+
+namespace
+{
+
+constexpr size_t W = just::DynamicWindow::WINDOW_SIZE;
+constexpr uint8_t OBSTACLE = 15;
+
+// Window cell at (x, y) relative to the agent's cell
+uint8_t& cell(std::array<uint8_t, W * W>& window, int x, int y)
+{
+    constexpr int center = W % 2 ? W / 2 : W / 2 - 1;
+    return window.at((y + center) * W + x + center);
+}
+
+} // namespace
+
+TEST_CASE("DynamicWindow clearance map") {
+    just::DynamicWindow dwa(just::DynamicWindow::Options{});
+    std::array<uint8_t, W * W> window{};
+    cell(window, 3, 0) = OBSTACLE;
+    // Below the threshold, doesn't count
+    cell(window, -3, 0) = 3;
+    dwa.choose(window, {0.0, 0.0}, 0.0, {}, {10.0, 0.0}, 0.1);
+
+    constexpr int center = W % 2 ? W / 2 : W / 2 - 1;
+    auto distance = [&dwa](int x, int y) {
+        return dwa.clearance_map()[(y + center) * W + x + center];
+    };
+    CHECK(distance(3, 0) == 0.0);
+    CHECK(distance(0, 0) == doctest::Approx(3.0));
+    CHECK(distance(3, 1) == doctest::Approx(1.0));
+    CHECK(distance(4, -1) == doctest::Approx(M_SQRT2));
+    CHECK(distance(-3, 0) == doctest::Approx(6.0));
+}
+
+TEST_CASE("DynamicWindow heads for the goal") {
+    just::DynamicWindow::Options options;
+    just::DynamicWindow dwa(options);
+    CHECK(dwa.sample_count() == options.speed_samples * options.turn_samples);
+    std::array<uint8_t, W * W> window{};
+
+    // Straight ahead, as fast as the acceleration allows
+    auto velocity = dwa.choose(window, {0.0, 0.0}, 0.0, {}, {10.0, 0.0}, 0.1);
+    REQUIRE(velocity);
+    CHECK(velocity->speed == doctest::Approx(options.max_accel * 0.1));
+    CHECK(velocity->turn_rate == doctest::Approx(0.0));
+
+    // Turning left, for a goal to the left. Or right, when facing the other way.
+    velocity = dwa.choose(window, {0.0, 0.0}, 0.0, {}, {0.0, 10.0}, 0.1);
+    REQUIRE(velocity);
+    CHECK(velocity->turn_rate > 0.0);
+    velocity = dwa.choose(window, {0.0, 0.0}, M_PI, {}, {0.0, 10.0}, 0.1);
+    REQUIRE(velocity);
+    CHECK(velocity->turn_rate < 0.0);
+}
+
+TEST_CASE("DynamicWindow avoids obstacles") {
+    just::DynamicWindow::Options options;
+    just::DynamicWindow dwa(options);
+    std::array<uint8_t, W * W> window{};
+
+    // A wall across the way, at full speed the agent has to slow down rather than run into it
+    for (int y = -10; y <= 10; ++y) {
+        cell(window, 3, y) = OBSTACLE;
+    }
+    auto velocity = dwa.choose(window, {0.0, 0.0}, 0.0, {options.max_speed, 0.0}, {10.0, 0.0}, 0.1);
+    REQUIRE(velocity);
+    CHECK(velocity->speed < options.max_speed);
+
+    // Boxed in at speed, there's no way out
+    window.fill(0);
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            cell(window, x, y) = x || y ? OBSTACLE : 0;
+        }
+    }
+    CHECK_FALSE(dwa.choose(window, {0.0, 0.0}, 0.0, {options.max_speed, 0.0}, {10.0, 0.0}, 0.1));
+    // When stopped, it can at least stay within its own cell
+    velocity = dwa.choose(window, {0.0, 0.0}, 0.0, {}, {10.0, 0.0}, 0.1);
+    REQUIRE(velocity);
+    CHECK(velocity->speed * options.horizon < 0.5);
+}
+
+TEST_CASE("DynamicWindow options") {
+    just::DynamicWindow::Options defaults;
+    auto options = just::DynamicWindow::options_from_config(toml::table{{"speed", 3.0}});
+    CHECK(options.max_speed == 3.0);
+    CHECK(options.turn_samples == defaults.turn_samples);
+
+    options = just::DynamicWindow::options_from_config(toml::table{
+        {"dwa", toml::table{{"turn_samples", 5}, {"radius", 2.0}}},
+    });
+    CHECK(options.turn_samples == 5);
+    CHECK(options.radius == 2.0);
+
+    options.max_accel = 0.1;
+    CHECK_THROWS_AS(just::DynamicWindow{options}, std::invalid_argument);
+}
+
+TEST_CASE("DWAAgent drives around an obstacle") {
+    // Squarely in the way, which takes the global planner to get around
+    just::KinematicWorld world(just::KinematicWorld::Options{});
+    world.add_obstacle(toml::table{{"shape", "circle"}, {"radius", 3.0}});
+    just::DWAAgent agent(toml::table{
+                             {"grid", toml::table{{"width", 100}, {"height", 100}}},
+                             {"sensor", toml::table{{"count", 36}, {"range", 25.0}}},
+                             {"goal", toml::table{{"x", 20.0}, {"y", 0.0}}},
+                             {"speed", 3.0},
+                             {"planner", toml::table{{"cell_size", 2}, {"lookahead", 6.0}}},
+                             {"shape", "circle"},
+                             {"radius", 1.0},
+                             {"x", -20.0},
+                             {"y", 0.0},
+                         },
+                         &world);
+
+    const float delta_t = 0.05;
+    bool collided = false;
+    for (int i = 0; i < 1000 && (agent.get_body()->position() - b2Vec2(20.0, 0.0)).Length() > 1.0;
+         ++i) {
+        agent.step(delta_t);
+        world.step(delta_t);
+        collided |= agent.get_body()->in_contact();
+    }
+    CHECK((agent.get_body()->position() - b2Vec2(20.0, 0.0)).Length() <= 1.0);
+    CHECK_FALSE(collided);
+}
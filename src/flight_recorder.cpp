@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+
+#include "doctest/doctest.h"
+#include "highfive/highfive.hpp"
+
+#include "just/flight_recorder.hpp"
+#include "just/telemetry.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+// Write 'columns' (one per record) as a fixed size [rows, columns] dataset
+template <typename T, size_t N, typename Getter>
+void write_columns(HighFive::Group& group,
+                   const std::string& name,
+                   size_t columns,
+                   Getter get)
+{
+    std::vector<T> buffer(N * columns);
+    for (size_t col = 0; col < columns; ++col) {
+        const std::array<T, N>* data = get(col);
+        if (!data) {
+            continue;
+        }
+        for (size_t row = 0; row < N; ++row) {
+            buffer[row * columns + col] = (*data)[row];
+        }
+    }
+
+    auto dataset = group.createDataSet(name,
+                                       HighFive::DataSpace({N, columns}),
+                                       HighFive::create_datatype<T>());
+    dataset.write_raw(buffer.data());
+}
+
+} // namespace
+
+std::optional<FlightRecorder::Options> FlightRecorder::options_from_config(
+    const toml::table& agent_config)
+{
+    const toml::table* table = agent_config["flight_recorder"].as_table();
+    if (!table) {
+        return std::nullopt;
+    }
+
+    Options options;
+    options.duration = (*table)["duration"].value_or(options.duration);
+    options.max_rate = (*table)["max_rate"].value_or(options.max_rate);
+    options.cooldown = (*table)["cooldown"].value_or(options.cooldown);
+    std::string name = agent_config["name"].value_or(std::string("agent"));
+    options.directory = (*table)["directory"].value_or("/tmp/just/" + name);
+    return options;
+}
+
+FlightRecorder::FlightRecorder(Options options)
+    : options_(std::move(options))
+{
+    if (options_.duration <= 0.0 || options_.max_rate <= 0.0) {
+        throw std::invalid_argument("FlightRecorder duration and max_rate must be positive");
+    }
+    records_.resize(std::ceil(options_.duration * options_.max_rate));
+}
+
+void FlightRecorder::begin_step(float delta_t)
+{
+    time_ += delta_t;
+
+    Record& record = records_[head_];
+    record.time = time_;
+    record.flags = 0;
+
+    head_ = (head_ + 1) % records_.size();
+    count_ = std::min(count_ + 1, records_.size());
+}
+
+void FlightRecorder::record_window(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window)
+{
+    Record& record = current();
+    std::copy(window.begin(), window.end(), record.window.begin());
+    record.flags |= WINDOW;
+}
+
+void FlightRecorder::record_polar_histogram(std::span<const float, K> polar_histogram)
+{
+    Record& record = current();
+    std::copy(polar_histogram.begin(), polar_histogram.end(), record.polar_histogram.begin());
+    record.flags |= POLAR_HISTOGRAM;
+}
+
+void FlightRecorder::record_motion(float angle, float speed, float x, float y)
+{
+    Record& record = current();
+    record.motion = {angle, speed, x, y};
+    record.flags |= MOTION;
+}
+
+void FlightRecorder::end_step(bool stuck, bool in_contact)
+{
+    // Only the transitions are interesting, an agent that stays stuck would dump forever otherwise
+    if (stuck && !was_stuck_) {
+        trigger("stuck");
+    }
+    if (in_contact && !was_in_contact_) {
+        trigger("collision");
+    }
+    was_stuck_ = stuck;
+    was_in_contact_ = in_contact;
+}
+
+std::optional<std::string> FlightRecorder::trigger(std::string_view reason)
+{
+    if (last_dump_ && time_ - *last_dump_ < options_.cooldown) {
+        return std::nullopt;
+    }
+    return dump(reason);
+}
+
+std::string FlightRecorder::dump(std::string_view reason)
+{
+    last_dump_ = time_;
+
+    // Oldest first, only the records within 'duration' of the latest step (the ring holds more
+    // when stepping slower than max_rate)
+    std::vector<const Record*> records;
+    records.reserve(count_);
+    size_t first = (head_ + records_.size() - count_) % records_.size();
+    for (size_t i = 0; i < count_; ++i) {
+        const Record& record = records_[(first + i) % records_.size()];
+        if (time_ - record.time < options_.duration) {
+            records.push_back(&record);
+        }
+    }
+
+    std::filesystem::create_directories(options_.directory);
+    std::string filename = options_.directory + "/flight_" + std::to_string(dump_count_++) + "_"
+                           + std::string(reason) + ".h5";
+
+    std::vector<double> times;
+    std::vector<uint8_t> flags;
+    for (const Record* record : records) {
+        times.push_back(record->time);
+        flags.push_back(record->flags);
+    }
+    auto with_flag = [&records](uint8_t flag, auto member) {
+        return [&records, flag, member](size_t col) {
+            const Record* record = records[col];
+            return record->flags & flag ? &(record->*member) : nullptr;
+        };
+    };
+
+    std::lock_guard lock(Telemetry::hdf5_mutex());
+    HighFive::File file(filename, HighFive::File::OpenOrCreate | HighFive::File::Truncate);
+    file.createAttribute("reason", std::string(reason));
+    file.createAttribute("time", time_);
+
+    HighFive::Group group = file.createGroup("vfh_agent");
+    group.createDataSet("time", times);
+    group.createDataSet("flags", flags);
+    write_columns<uint8_t, WINDOW_SIZE_SQUARED>(group,
+                                                "window_histogram",
+                                                records.size(),
+                                                with_flag(WINDOW, &Record::window));
+    write_columns<float, K>(group,
+                            "polar_histogram",
+                            records.size(),
+                            with_flag(POLAR_HISTOGRAM, &Record::polar_histogram));
+    write_columns<float, 4>(group,
+                            "packed_motion",
+                            records.size(),
+                            with_flag(MOTION, &Record::motion));
+
+    auto motion = group.getDataSet("packed_motion");
+    motion.createAttribute("angle_index", 0);
+    motion.createAttribute("speed_index", 1);
+    motion.createAttribute("x_index", 2);
+    motion.createAttribute("y_index", 3);
+
+    return filename;
+}
+
+FlightRecorder::Record& FlightRecorder::current()
+{
+    // NOTE: only valid after begin_step()
+    return records_[(head_ + records_.size() - 1) % records_.size()];
+}
+
+} // namespace just
+
+TEST_CASE("FlightRecorder keeps the most recent steps") {
+    just::FlightRecorder::Options options;
+    options.duration = 1.0;
+    options.max_rate = 10.0;
+    options.cooldown = 0.5;
+    options.directory = (std::filesystem::temp_directory_path() / "just_flight_test").string();
+    just::FlightRecorder recorder(options);
+    REQUIRE(recorder.capacity() == 10);
+
+    std::array<float, just::FlightRecorder::K> polar_histogram{};
+    for (int i = 0; i < 25; ++i) {
+        recorder.begin_step(0.1);
+        polar_histogram[0] = i;
+        recorder.record_polar_histogram(polar_histogram);
+        recorder.record_motion(0.0, 1.0, i, 0.0);
+        recorder.end_step(false, false);
+    }
+    CHECK(recorder.size() == 10);
+    CHECK(recorder.time() == doctest::Approx(2.5));
+
+    SUBCASE("Triggers respect the cooldown") {
+        CHECK(recorder.trigger("test"));
+        CHECK_FALSE(recorder.trigger("test"));
+        for (int i = 0; i < 6; ++i) {
+            recorder.begin_step(0.1);
+            recorder.end_step(false, false);
+        }
+        CHECK(recorder.trigger("test"));
+    }
+
+    SUBCASE("Only the start of a stuck/collision period triggers") {
+        std::filesystem::remove_all(options.directory);
+        for (int i = 0; i < 20; ++i) {
+            recorder.begin_step(0.1);
+            recorder.end_step(true, false);
+        }
+        size_t dumps = std::distance(std::filesystem::directory_iterator(options.directory),
+                                     std::filesystem::directory_iterator());
+        CHECK(dumps == 1);
+    }
+
+    SUBCASE("Dumps contain the last 'duration' seconds, oldest first") {
+        std::string filename = recorder.dump("test");
+
+        HighFive::File file(filename, HighFive::File::ReadOnly);
+        CHECK(file.getAttribute("reason").read<std::string>() == "test");
+
+        auto time = file.getDataSet("vfh_agent/time").read<std::vector<double>>();
+        REQUIRE(time.size() == 10);
+        CHECK(time.front() == doctest::Approx(1.6));
+        CHECK(time.back() == doctest::Approx(2.5));
+
+        auto flags = file.getDataSet("vfh_agent/flags").read<std::vector<uint8_t>>();
+        CHECK(flags.front() == (just::FlightRecorder::POLAR_HISTOGRAM
+                                | just::FlightRecorder::MOTION));
+
+        auto polar = file.getDataSet("vfh_agent/polar_histogram")
+                         .read<std::vector<std::vector<float>>>();
+        REQUIRE(polar.size() == just::FlightRecorder::K);
+        CHECK(polar[0].front() == 15);
+        CHECK(polar[0].back() == 24);
+    }
+
+    std::filesystem::remove_all(options.directory);
+}
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "doctest/doctest.h"
+
+#include "just/global_planner.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+constexpr uint32_t INF = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t STRAIGHT = 10;
+constexpr uint32_t DIAGONAL = 14;
+
+// INF stays INF
+uint32_t add(uint32_t a, uint32_t b)
+{
+    return a >= INF - b ? INF : a + b;
+}
+
+} // namespace
+
+std::optional<GlobalPlanner::Options> GlobalPlanner::options_from_config(
+    const toml::table& agent_config)
+{
+    const toml::table* table = agent_config["planner"].as_table();
+    if (!table) {
+        return std::nullopt;
+    }
+
+    Options options;
+    options.cell_size = (*table)["cell_size"].value_or(options.cell_size);
+    options.threshold = (*table)["threshold"].value_or(options.threshold);
+    options.lookahead = (*table)["lookahead"].value_or(options.lookahead);
+    return options;
+}
+
+GlobalPlanner::GlobalPlanner(Options options, const HistogramGrid& grid, b2Vec2 goal)
+    : options_(options),
+      x_min_(grid.x_min()),
+      y_min_(grid.y_min()),
+      width_(grid.width()),
+      height_(grid.height()),
+      goal_(goal)
+{
+    if (options_.cell_size == 0 || options_.threshold == 0 || options_.lookahead <= 0.0) {
+        throw std::invalid_argument(
+            "GlobalPlanner cell_size, threshold and lookahead must be positive");
+    }
+
+    blocks_x_ = (width_ + options_.cell_size - 1) / options_.cell_size;
+    blocks_y_ = (height_ + options_.cell_size - 1) / options_.cell_size;
+    size_t blocks = blocks_x_ * blocks_y_;
+    blocked_counts_.assign(blocks, 0);
+    g_.assign(blocks, INF);
+    rhs_.assign(blocks, INF);
+
+    // Both the grid and the search start out from scratch, so anything already in the grid is
+    // simply counted in
+    occupied_.assign(width_ * height_, false);
+    for (uint32_t idx = 0; idx < width_ * height_; ++idx) {
+        if (grid.data()[idx] >= options_.threshold) {
+            occupied_[idx] = true;
+            ++blocked_counts_[(idx % width_) / options_.cell_size
+                              + (idx / width_) / options_.cell_size * blocks_x_];
+        }
+    }
+
+    goal_block_ = block_of(goal);
+    rhs_[goal_block_] = 0;
+    open_.push({{0, 0}, goal_block_});
+}
+
+void GlobalPlanner::update_cells(const HistogramGrid& grid, std::span<const uint32_t> changed_cells)
+{
+    for (uint32_t idx : changed_cells) {
+        bool occupied = grid.data()[idx] >= options_.threshold;
+        if (occupied == occupied_[idx]) {
+            continue;
+        }
+        occupied_[idx] = occupied;
+
+        uint32_t block = (idx % width_) / options_.cell_size
+                         + (idx / width_) / options_.cell_size * blocks_x_;
+        uint32_t& count = blocked_counts_[block];
+        count += occupied ? 1 : -1;
+        // Only the transitions between free and blocked matter to the search
+        if (count == (occupied ? 1 : 0)) {
+            changed_blocks_.push_back(block);
+        }
+    }
+}
+
+b2Vec2 GlobalPlanner::subgoal(b2Vec2 position)
+{
+    uint32_t start = block_of(position);
+    if (last_start_) {
+        // Keys already queued were computed for the previous start, rather than updating them
+        // all, the heuristic's change is accounted for in every key from here on
+        km_ += heuristic(*last_start_, start);
+    }
+    last_start_ = start;
+
+    // Edges into and out of a changed block change, so it and its neighbours need updating
+    for (uint32_t block : changed_blocks_) {
+        update_vertex(block, start);
+        for_each_neighbour(block, [&](uint32_t neighbour, Cost) {
+            update_vertex(neighbour, start);
+        });
+    }
+    changed_blocks_.clear();
+
+    compute_shortest_path(start);
+
+    has_path_ = g_[start] < INF;
+    if (!has_path_) {
+        return goal_;
+    }
+
+    // Follow the path downhill until 'lookahead' along it
+    uint32_t current = start;
+    float travelled = 0.0;
+    while (current != goal_block_ && travelled < options_.lookahead) {
+        uint32_t next = current;
+        Cost best = INF;
+        for_each_neighbour(current, [&](uint32_t neighbour, Cost) {
+            Cost through = add(cost(current, neighbour), g_[neighbour]);
+            if (through < best) {
+                best = through;
+                next = neighbour;
+            }
+        });
+        if (next == current) {
+            break;
+        }
+        bool diagonal = next % blocks_x_ != current % blocks_x_
+                        && next / blocks_x_ != current / blocks_x_;
+        travelled += (diagonal ? M_SQRT2 : 1.0) * options_.cell_size;
+        current = next;
+    }
+
+    return current == goal_block_ ? goal_ : center_of(current);
+}
+
+uint32_t GlobalPlanner::block_of(b2Vec2 position) const
+{
+    // Clamped, so positions off the grid plan from (or to) its edge
+    long col = std::clamp<long>(std::lround(position.x) - x_min_, 0, width_ - 1);
+    long row = std::clamp<long>(std::lround(position.y) - y_min_, 0, height_ - 1);
+    return col / options_.cell_size + row / options_.cell_size * blocks_x_;
+}
+
+b2Vec2 GlobalPlanner::center_of(uint32_t block) const
+{
+    // The last row/column of blocks may be cut short by the edge of the grid
+    unsigned bx = block % blocks_x_;
+    unsigned by = block / blocks_x_;
+    unsigned col_end = std::min((bx + 1) * options_.cell_size, width_);
+    unsigned row_end = std::min((by + 1) * options_.cell_size, height_);
+    float col = (bx * options_.cell_size + col_end - 1) / 2.0;
+    float row = (by * options_.cell_size + row_end - 1) / 2.0;
+    return {x_min_ + col, y_min_ + row};
+}
+
+GlobalPlanner::Cost GlobalPlanner::heuristic(uint32_t a, uint32_t b) const
+{
+    // Octile distance, exact for 8 connected moves on a free grid
+    Cost dx = std::abs(static_cast<int>(a % blocks_x_) - static_cast<int>(b % blocks_x_));
+    Cost dy = std::abs(static_cast<int>(a / blocks_x_) - static_cast<int>(b / blocks_x_));
+    return STRAIGHT * std::max(dx, dy) + (DIAGONAL - STRAIGHT) * std::min(dx, dy);
+}
+
+GlobalPlanner::Cost GlobalPlanner::cost(uint32_t a, uint32_t b) const
+{
+    // Leaving a blocked block is allowed, the agent may well be in one next to an obstacle
+    if (is_blocked(b)) {
+        return INF;
+    }
+    return a % blocks_x_ == b % blocks_x_ || a / blocks_x_ == b / blocks_x_ ? STRAIGHT : DIAGONAL;
+}
+
+GlobalPlanner::Key GlobalPlanner::key(uint32_t block, uint32_t start) const
+{
+    uint64_t k2 = std::min(g_[block], rhs_[block]);
+    return {k2 + heuristic(start, block) + km_, k2};
+}
+
+template <typename Fn>
+void GlobalPlanner::for_each_neighbour(uint32_t block, Fn&& fn) const
+{
+    int bx = block % blocks_x_;
+    int by = block / blocks_x_;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int x = bx + dx;
+            int y = by + dy;
+            if ((dx || dy) && x >= 0 && y >= 0 && x < static_cast<int>(blocks_x_)
+                && y < static_cast<int>(blocks_y_)) {
+                fn(x + y * blocks_x_, dx && dy ? DIAGONAL : STRAIGHT);
+            }
+        }
+    }
+}
+
+void GlobalPlanner::update_vertex(uint32_t block, uint32_t start)
+{
+    if (block != goal_block_) {
+        Cost rhs = INF;
+        for_each_neighbour(block, [&](uint32_t neighbour, Cost) {
+            rhs = std::min(rhs, add(cost(block, neighbour), g_[neighbour]));
+        });
+        rhs_[block] = rhs;
+    }
+    if (g_[block] != rhs_[block]) {
+        open_.push({key(block, start), block});
+    }
+}
+
+void GlobalPlanner::compute_shortest_path(uint32_t start)
+{
+    while (!open_.empty()
+           && (open_.top().key < key(start, start) || rhs_[start] != g_[start])) {
+        Entry entry = open_.top();
+        open_.pop();
+
+        uint32_t block = entry.block;
+        if (g_[block] == rhs_[block]) {
+            // Stale, made consistent since it was queued
+            continue;
+        }
+        Key current = key(block, start);
+        if (entry.key < current) {
+            open_.push({current, block});
+            continue;
+        }
+
+        ++expansions_;
+        if (g_[block] > rhs_[block]) {
+            g_[block] = rhs_[block];
+        } else {
+            g_[block] = INF;
+            update_vertex(block, start);
+        }
+        for_each_neighbour(block, [&](uint32_t neighbour, Cost) {
+            update_vertex(neighbour, start);
+        });
+    }
+
+    // Stale entries pile up as blocks are requeued, so once they dominate the queue is rebuilt
+    // from the blocks that are actually inconsistent
+    if (open_.size() > 4 * g_.size()) {
+        std::vector<Entry> entries;
+        for (uint32_t block = 0; block < g_.size(); ++block) {
+            if (g_[block] != rhs_[block]) {
+                entries.push_back({key(block, start), block});
+            }
+        }
+        open_ = decltype(open_)(std::greater<Entry>(), std::move(entries));
+    }
+}
+
+} // namespace just
+
+namespace
+{
+
+// Mark a wall of obstacle cells in the grid, the way repeated detections would.
+// Each detection also clears the cell before it, so columns are filled in from the right.
+void add_wall(just::HistogramGrid& grid, int x0, int y0, int x1, int y1)
+{
+    for (int x = x1; x >= x0; --x) {
+        for (int y = y0; y <= y1; ++y) {
+            for (int i = 0; i < 2; ++i) {
+                grid.add_percept(x - 1, y, 0.0, 1.0, true);
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("GlobalPlanner plans around obstacles") {
+    just::HistogramGrid grid(101, 101);
+    grid.track_changes(true);
+    just::GlobalPlanner::Options options;
+    options.cell_size = 5;
+    options.lookahead = 5.0;
+    just::GlobalPlanner planner(options, grid, {40.0, 0.0});
+    CHECK(planner.blocks_wide() == 21);
+    CHECK(planner.blocks_high() == 21);
+
+    // Nothing known, straight at the goal
+    b2Vec2 subgoal = planner.subgoal({-40.0, 0.0});
+    REQUIRE(planner.has_path());
+    // The center of the next block east
+    CHECK(subgoal.x == doctest::Approx(-33.0));
+    CHECK(subgoal.y == doctest::Approx(2.0));
+
+    // A wall straight across the way, open to the north
+    add_wall(grid, 0, -50, 1, 20);
+    planner.update_cells(grid, grid.changed_cells());
+    grid.clear_changed_cells();
+    CHECK(planner.blocked(10, 10));
+    CHECK_FALSE(planner.blocked(10, 20));
+
+    // Far from the wall, the path still heads east but has to round its end eventually
+    subgoal = planner.subgoal({-40.0, 0.0});
+    REQUIRE(planner.has_path());
+    CHECK(subgoal.x > -40.0);
+    subgoal = planner.subgoal({-5.0, 0.0});
+    CHECK(subgoal.y > 0.0);
+    // The whole way round, over the top of the wall
+    b2Vec2 position{-5.0, 0.0};
+    for (int i = 0; i < 40 && (position - b2Vec2{40.0, 0.0}).Length() > 1.0; ++i) {
+        position = planner.subgoal(position);
+        CHECK(grid.at(std::lround(position.x), std::lround(position.y)).value_or(0)
+              < options.threshold);
+    }
+    CHECK(position.x == doctest::Approx(40.0));
+
+    // Walled in completely, there is no path and the goal is returned as is
+    add_wall(grid, 30, -50, 31, 50);
+    planner.update_cells(grid, grid.changed_cells());
+    subgoal = planner.subgoal({-40.0, 0.0});
+    CHECK_FALSE(planner.has_path());
+    CHECK(subgoal.x == 40.0);
+
+    // Clearing the wall (by repeated misses) opens it back up
+    grid.clear_changed_cells();
+    for (int y = -50; y <= 50; ++y) {
+        for (int i = 0; i < 2 * just::HistogramGrid::CV_INC; ++i) {
+            grid.add_percept(29, y, 0.0, 3.0, false);
+        }
+    }
+    planner.update_cells(grid, grid.changed_cells());
+    planner.subgoal({-40.0, 0.0});
+    CHECK(planner.has_path());
+}
+
+TEST_CASE("GlobalPlanner repairs incrementally") {
+    just::HistogramGrid grid(201, 201);
+    grid.track_changes(true);
+    just::GlobalPlanner::Options options;
+    options.cell_size = 5;
+    // A long wall between the agent and the goal, which makes for a costly search
+    add_wall(grid, 0, -100, 1, 80);
+    grid.clear_changed_cells();
+    just::GlobalPlanner planner(options, grid, {90.0, -90.0});
+    planner.subgoal({-90.0, -90.0});
+
+    // An obstacle turning up just ahead of the agent only needs the search around it repaired,
+    // far fewer expansions than planning from scratch
+    add_wall(grid, -100, -70, -60, -69);
+    planner.update_cells(grid, grid.changed_cells());
+    uint64_t before = planner.expansions();
+    b2Vec2 repaired = planner.subgoal({-85.0, -85.0});
+    uint64_t repair = planner.expansions() - before;
+    REQUIRE(planner.has_path());
+
+    just::GlobalPlanner fresh(options, grid, {90.0, -90.0});
+    b2Vec2 replanned = fresh.subgoal({-85.0, -85.0});
+    CHECK(repair < fresh.expansions() / 2);
+    // To the same effect
+    CHECK(repaired.x == doctest::Approx(replanned.x));
+    CHECK(repaired.y == doctest::Approx(replanned.y));
+
+    // Moving along the path with nothing changing costs next to nothing
+    before = planner.expansions();
+    planner.subgoal(repaired);
+    CHECK(planner.expansions() - before < fresh.expansions() / 10);
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+
+#include "doctest/doctest.h"
+
+#include "just/grid_snapshot.hpp"
+
+namespace just
+{
+
+GridSnapshotter::GridSnapshotter(HistogramGrid& grid)
+    : grid_(&grid)
+{
+    grid.track_dirty_tiles(true);
+    // Snapshots start out at version 0, so their first write copies every tile
+    tile_versions_.assign(grid.tiles_wide() * grid.tiles_high(), version_);
+}
+
+size_t GridSnapshotter::write(GridSnapshot& snapshot)
+{
+    const HistogramGrid& grid = *grid_;
+    unsigned tiles_wide = grid.tiles_wide();
+
+    std::vector<uint32_t> dirty_tiles = grid_->take_dirty_tiles();
+    if (!dirty_tiles.empty()) {
+        ++version_;
+        for (uint32_t tile : dirty_tiles) {
+            tile_versions_[tile] = version_;
+        }
+    }
+
+    if (snapshot.cells.size() != static_cast<size_t>(grid.width()) * grid.height()) {
+        snapshot.width = grid.width();
+        snapshot.height = grid.height();
+        snapshot.tiles_wide = tiles_wide;
+        snapshot.x_min = grid.x_min();
+        snapshot.y_min = grid.y_min();
+        snapshot.cells.assign(static_cast<size_t>(grid.width()) * grid.height(), 0);
+        snapshot.tile_versions.assign(tile_versions_.size(), 0);
+    }
+
+    constexpr unsigned TILE_SIZE = HistogramGrid::TILE_SIZE;
+    size_t copied = 0;
+    for (uint32_t tile = 0; tile < tile_versions_.size(); ++tile) {
+        if (snapshot.tile_versions[tile] == tile_versions_[tile]) {
+            continue;
+        }
+        unsigned col = tile % tiles_wide * TILE_SIZE;
+        unsigned row = tile / tiles_wide * TILE_SIZE;
+        unsigned cols = std::min(TILE_SIZE, grid.width() - col);
+        unsigned rows = std::min(TILE_SIZE, grid.height() - row);
+        for (unsigned r = row; r < row + rows; ++r) {
+            size_t offset = static_cast<size_t>(r) * grid.width() + col;
+            std::copy_n(grid.data() + offset, cols, snapshot.cells.begin() + offset);
+        }
+        snapshot.tile_versions[tile] = tile_versions_[tile];
+        ++copied;
+    }
+    return copied;
+}
+
+} // namespace just
+
+TEST_CASE("GridSnapshotter") {
+    constexpr unsigned TILE = just::HistogramGrid::TILE_SIZE;
+    just::HistogramGrid grid(3 * TILE, 2 * TILE + 7);
+    grid.add_percept(0, 0, 0.0, 5.0, true);
+
+    just::GridSnapshotter snapshotter(grid);
+    auto matches = [&grid](const just::GridSnapshot& snapshot) {
+        return snapshot.width == grid.width() && snapshot.height == grid.height()
+               && std::equal(snapshot.cells.begin(), snapshot.cells.end(), grid.data());
+    };
+
+    // The first write copies everything, including what was in the grid beforehand
+    just::GridSnapshot a;
+    CHECK(snapshotter.write(a) == grid.tiles_wide() * grid.tiles_high());
+    CHECK(matches(a));
+    CHECK(snapshotter.write(a) == 0);
+
+    // Later writes only copy the changed tiles, here the one at the grid's center
+    grid.add_percept(0, 0, M_PI / 2, 3.0, true);
+    CHECK(snapshotter.write(a) == 1);
+    CHECK(matches(a));
+
+    // A snapshot left behind catches up on everything it missed, and can tell which tiles changed
+    // since the versions it had
+    just::GridSnapshot b;
+    snapshotter.write(b);
+    auto versions = b.tile_versions;
+    grid.add_percept(0, 0, M_PI, 3.0, true);
+    snapshotter.write(a);
+    grid.add_percept(grid.x_min(), grid.y_min(), M_PI / 2, 2.0, true);
+    snapshotter.write(a);
+    CHECK(snapshotter.write(b) == 2);
+    CHECK(matches(b));
+    size_t changed = 0;
+    for (size_t tile = 0; tile < versions.size(); ++tile) {
+        changed += versions[tile] != b.tile_versions[tile];
+    }
+    CHECK(changed == 2);
+}
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+
+#include "doctest/doctest.h"
+
+#include "just/agent.hpp"
+#include "just/kernels.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define JUST_KERNELS_X86
+#endif
+
+namespace just
+{
+
+namespace
+{
+
+// The kernels, written once. Inlined into each variant below, which is what gets them compiled
+// for the variant's target.
+
+__attribute__((always_inline)) inline void project_window_body(const uint8_t* window,
+                                                               const uint8_t* sector,
+                                                               const uint16_t* weight,
+                                                               size_t cells,
+                                                               uint32_t* sectors)
+{
+    // Magnitudes first, which vectorizes (certainty values squared fit 16 bit lanes, as do the
+    // weights), then the scatter into the sectors, which doesn't
+    std::array<uint32_t, VFHAgent::WINDOW_SIZE_SQUARED> magnitude;
+    for (size_t offset = 0; offset < cells; offset += magnitude.size()) {
+        size_t count = std::min(magnitude.size(), cells - offset);
+        for (size_t idx = 0; idx < count; ++idx) {
+            uint16_t cv = window[offset + idx];
+            magnitude[idx] = static_cast<uint32_t>(static_cast<uint16_t>(cv * cv))
+                             * weight[offset + idx];
+        }
+        for (size_t idx = 0; idx < count; ++idx) {
+            sectors[sector[offset + idx]] += magnitude[idx];
+        }
+    }
+}
+
+__attribute__((always_inline)) inline void smooth_sectors_body(const uint32_t* sectors,
+                                                               float* smoothed)
+{
+    constexpr int K = VFHAgent::K;
+    constexpr int L = VFHAgent::L;
+
+    // Unroll the wrap around into L sectors of padding either side, which leaves a plain
+    // convolution to vectorize across sectors
+    std::array<uint32_t, K + 2 * L> padded;
+    std::copy(sectors + K - L, sectors + K, padded.begin());
+    std::copy(sectors, sectors + K, padded.begin() + L);
+    std::copy(sectors, sectors + L, padded.begin() + L + K);
+
+    for (int i = 0; i < K; ++i) {
+        uint32_t h_prime = 0;
+        for (int l = -L; l <= L; ++l) {
+            // Slight difference from the paper here:
+            // I think there's a typo/error in the original publicaion (equation 5)
+            h_prime += padded[i + L + l] * static_cast<uint32_t>(1 + L - std::abs(l));
+        }
+        smoothed[i] = static_cast<float>(h_prime / (2 * L + 1));
+    }
+}
+
+__attribute__((always_inline)) inline void rollout_step_body(size_t n,
+                                                             float dt,
+                                                             const float* __restrict__ speed,
+                                                             const float* __restrict__ cos_step,
+                                                             const float* __restrict__ sin_step,
+                                                             float* __restrict__ cosine,
+                                                             float* __restrict__ sine,
+                                                             float* __restrict__ x,
+                                                             float* __restrict__ y)
+{
+    // Turn, then move along the new heading. Turning is a rotation by the per step angle, which
+    // keeps this free of trigonometry.
+    for (size_t i = 0; i < n; ++i) {
+        float c = cosine[i] * cos_step[i] - sine[i] * sin_step[i];
+        float s = sine[i] * cos_step[i] + cosine[i] * sin_step[i];
+        cosine[i] = c;
+        sine[i] = s;
+        x[i] += speed[i] * dt * c;
+        y[i] += speed[i] * dt * s;
+    }
+}
+
+// Stamp out a variant of every kernel, compiled with the given attributes. The buffers of
+// rollout_step never overlap, telling the compiler so lets it vectorize.
+#define JUST_DEFINE_KERNELS(suffix, attributes)                                                  \
+    attributes void project_window_##suffix(const uint8_t* window,                               \
+                                            const uint8_t* sector,                               \
+                                            const uint16_t* weight,                              \
+                                            size_t cells,                                        \
+                                            uint32_t* sectors)                                   \
+    {                                                                                            \
+        project_window_body(window, sector, weight, cells, sectors);                             \
+    }                                                                                            \
+    attributes void smooth_sectors_##suffix(const uint32_t* sectors, float* smoothed)            \
+    {                                                                                            \
+        smooth_sectors_body(sectors, smoothed);                                                  \
+    }                                                                                            \
+    attributes void rollout_step_##suffix(size_t n,                                              \
+                                          float dt,                                              \
+                                          const float* __restrict__ speed,                       \
+                                          const float* __restrict__ cos_step,                    \
+                                          const float* __restrict__ sin_step,                    \
+                                          float* __restrict__ cosine,                            \
+                                          float* __restrict__ sine,                              \
+                                          float* __restrict__ x,                                 \
+                                          float* __restrict__ y)                                 \
+    {                                                                                            \
+        rollout_step_body(n, dt, speed, cos_step, sin_step, cosine, sine, x, y);                 \
+    }                                                                                            \
+    constexpr Kernels KERNELS_##suffix{                                                          \
+        &project_window_##suffix, &smooth_sectors_##suffix, &rollout_step_##suffix};
+
+JUST_DEFINE_KERNELS(SCALAR, )
+#ifdef JUST_KERNELS_X86
+JUST_DEFINE_KERNELS(SSE4_2, __attribute__((target("sse4.2"))))
+JUST_DEFINE_KERNELS(AVX2, __attribute__((target("avx2"))))
+JUST_DEFINE_KERNELS(AVX512, __attribute__((target("avx512f,avx512bw,avx512vl"))))
+#endif
+
+#undef JUST_DEFINE_KERNELS
+
+bool host_supports(Isa isa)
+{
+#ifdef JUST_KERNELS_X86
+    __builtin_cpu_init();
+    switch (isa) {
+    case Isa::SCALAR:
+        return true;
+    case Isa::SSE4_2:
+        return __builtin_cpu_supports("sse4.2");
+    case Isa::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case Isa::AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+               && __builtin_cpu_supports("avx512vl");
+    }
+    return false;
+#else
+    return isa == Isa::SCALAR;
+#endif
+}
+
+Isa select_isa()
+{
+    std::vector<Isa> isas = supported_isas();
+    Isa best = isas.back();
+    if (const char* cap = std::getenv("JUST_ISA")) {
+        if (auto isa = isa_from_name(cap)) {
+            // Supported ISAs are contiguous from SCALAR up, so capping is a min
+            best = std::min(best, *isa);
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+const Kernels& kernels()
+{
+    static const Kernels& active = *kernels_for(active_isa());
+    return active;
+}
+
+Isa active_isa()
+{
+    static const Isa isa = select_isa();
+    return isa;
+}
+
+std::vector<Isa> supported_isas()
+{
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::SCALAR, Isa::SSE4_2, Isa::AVX2, Isa::AVX512}) {
+        if (!kernels_for(isa)) {
+            break;
+        }
+        isas.push_back(isa);
+    }
+    return isas;
+}
+
+const Kernels* kernels_for(Isa isa)
+{
+    if (!host_supports(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+    case Isa::SCALAR:
+        return &KERNELS_SCALAR;
+#ifdef JUST_KERNELS_X86
+    case Isa::SSE4_2:
+        return &KERNELS_SSE4_2;
+    case Isa::AVX2:
+        return &KERNELS_AVX2;
+    case Isa::AVX512:
+        return &KERNELS_AVX512;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const char* isa_name(Isa isa)
+{
+    switch (isa) {
+    case Isa::SCALAR:
+        return "scalar";
+    case Isa::SSE4_2:
+        return "sse4.2";
+    case Isa::AVX2:
+        return "avx2";
+    case Isa::AVX512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+std::optional<Isa> isa_from_name(std::string_view name)
+{
+    for (Isa isa : {Isa::SCALAR, Isa::SSE4_2, Isa::AVX2, Isa::AVX512}) {
+        if (name == isa_name(isa)) {
+            return isa;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace just
+
+TEST_CASE("Kernel variants match the scalar reference") {
+    constexpr size_t CELLS = just::VFHAgent::WINDOW_SIZE_SQUARED;
+    constexpr size_t K = just::VFHAgent::K;
+    constexpr size_t ROLLOUTS = 203;    // not a multiple of any vector width
+
+    const just::Kernels* reference = just::kernels_for(just::Isa::SCALAR);
+    REQUIRE(reference);
+    CHECK(just::kernels_for(just::active_isa()) == &just::kernels());
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> certainty(0, just::HistogramGrid::CV_MAX);
+    std::uniform_int_distribution<int> sector(0, K - 1);
+    std::uniform_int_distribution<int> weight(0, just::VFHAgent::A);
+    std::uniform_real_distribution<float> real(-1.0, 1.0);
+
+    for (just::Isa isa : just::supported_isas()) {
+        CAPTURE(just::isa_name(isa));
+        const just::Kernels* variant = just::kernels_for(isa);
+        REQUIRE(variant);
+
+        for (int round = 0; round < 10; ++round) {
+            std::vector<uint8_t> window(CELLS);
+            std::vector<uint8_t> sectors_of(CELLS);
+            std::vector<uint16_t> weights(CELLS);
+            for (size_t idx = 0; idx < CELLS; ++idx) {
+                window[idx] = certainty(rng);
+                sectors_of[idx] = sector(rng);
+                weights[idx] = weight(rng);
+            }
+
+            std::array<uint32_t, K> expected{};
+            std::array<uint32_t, K> actual{};
+            reference->project_window(window.data(), sectors_of.data(), weights.data(), CELLS,
+                                      expected.data());
+            variant->project_window(window.data(), sectors_of.data(), weights.data(), CELLS,
+                                    actual.data());
+            CHECK(actual == expected);
+
+            std::array<float, K> expected_smoothed;
+            std::array<float, K> actual_smoothed;
+            reference->smooth_sectors(expected.data(), expected_smoothed.data());
+            variant->smooth_sectors(expected.data(), actual_smoothed.data());
+            CHECK(actual_smoothed == expected_smoothed);
+
+            // Rollout state, 0 to 8 as speed, cos_step, sin_step, cos, sin, x and y
+            std::array<std::vector<float>, 7> expected_state;
+            for (auto& values : expected_state) {
+                values.resize(ROLLOUTS);
+                std::generate(values.begin(), values.end(), [&] { return real(rng); });
+            }
+            auto actual_state = expected_state;
+            auto step = [](const just::Kernels* k, std::array<std::vector<float>, 7>& s) {
+                k->rollout_step(ROLLOUTS, 0.1, s[0].data(), s[1].data(), s[2].data(),
+                                s[3].data(), s[4].data(), s[5].data(), s[6].data());
+            };
+            for (int i = 0; i < 5; ++i) {
+                step(reference, expected_state);
+                step(variant, actual_state);
+            }
+            CHECK(actual_state == expected_state);
+        }
+    }
+}
+
+TEST_CASE("Integer polar histogram") {
+    constexpr size_t K = just::VFHAgent::K;
+    constexpr uint32_t CV_MAX = just::HistogramGrid::CV_MAX;
+
+    // A window at full certainty is the largest the sectors get, and must not wrap around.
+    // The sum of the sectors is that of every cell's weight, found one cell at a time.
+    std::array<uint8_t, just::VFHAgent::WINDOW_SIZE_SQUARED> window{};
+    std::array<uint32_t, K> sectors;
+    uint64_t weight_sum = 0;
+    for (size_t idx = 0; idx < window.size(); ++idx) {
+        window[idx] = 1;
+        just::VFHAgent::project_window(window, sectors);
+        weight_sum += std::accumulate(sectors.begin(), sectors.end(), uint64_t{0});
+        window[idx] = 0;
+    }
+    window.fill(CV_MAX);
+    just::VFHAgent::project_window(window, sectors);
+    CHECK(std::accumulate(sectors.begin(), sectors.end(), uint64_t{0})
+          == weight_sum * CV_MAX * CV_MAX);
+
+    // Smoothing a flat histogram weighs every sector by 1 + L - |l|, (L + 1)^2 in total
+    constexpr uint32_t L = just::VFHAgent::L;
+    uint32_t peak = *std::max_element(sectors.begin(), sectors.end());
+    sectors.fill(peak);
+    std::array<float, K> smoothed;
+    just::VFHAgent::smooth_sectors(sectors, smoothed);
+    uint64_t expected = uint64_t{peak} * (L + 1) * (L + 1) / (2 * L + 1);
+    for (float value : smoothed) {
+        CHECK(value == static_cast<float>(expected));
+    }
+}
+
+TEST_CASE("Isa names") {
+    for (just::Isa isa : {just::Isa::SCALAR, just::Isa::SSE4_2, just::Isa::AVX2,
+                          just::Isa::AVX512}) {
+        CHECK(just::isa_from_name(just::isa_name(isa)) == isa);
+    }
+    CHECK_FALSE(just::isa_from_name("neon"));
+    CHECK(just::supported_isas().front() == just::Isa::SCALAR);
+}
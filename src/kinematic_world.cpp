@@ -0,0 +1,633 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+#include "just/kinematic_world.hpp"
+#include "just/occupancy_map.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+constexpr float MISS = std::numeric_limits<float>::infinity();
+constexpr float EPSILON = 1e-6;
+
+} // namespace
+
+class KinematicWorld::Body : public PhysicsBody
+{
+public:
+    Body(KinematicWorld* world, size_t index) : world_(world), index_(index) {}
+    ~Body() override { world_->remove_body(index_); }
+
+    b2Vec2 position() const override { return world_->positions_[index_]; }
+    float angle() const override { return world_->angles_[index_]; }
+
+    void set_linear_velocity(b2Vec2 velocity) override { world_->velocities_[index_] = velocity; }
+    void set_angular_velocity(float omega) override { world_->angular_velocities_[index_] = omega; }
+
+    bool in_contact() const override { return world_->contacts_[index_]; }
+
+private:
+    friend class KinematicWorld;
+
+    KinematicWorld* world_;
+    size_t index_;
+};
+
+KinematicWorld::Options KinematicWorld::options_from_config(const toml::table& world_config)
+{
+    Options options;
+    if (const toml::table* table = world_config["kinematic"].as_table()) {
+        options.cell_size = (*table)["cell_size"].value_or(options.cell_size);
+        options.iterations = (*table)["iterations"].value_or(options.iterations);
+    }
+    return options;
+}
+
+KinematicWorld::KinematicWorld(Options options)
+    : options_(options),
+      body_hash_(options.cell_size),
+      obstacle_hash_(options.cell_size)
+{
+    if (options_.cell_size <= 0.0) {
+        throw std::invalid_argument("KinematicWorld cell_size must be positive");
+    }
+}
+
+KinematicWorld::~KinematicWorld() = default;
+
+std::unique_ptr<PhysicsBody> KinematicWorld::create_body(const toml::table& config)
+{
+    float radius;
+    std::string_view shape_str = config["shape"].value_or("circle");
+    if (shape_str == "circle") {
+        radius = config["radius"].value_or(1.0);
+    } else if (shape_str == "box") {
+        float width = config["width"].value_or(1.0);
+        float height = config["height"].value_or(1.0);
+        radius = std::sqrt(width * width + height * height) / 2.0;
+    } else {
+        throw std::runtime_error("Agent constructed with invalid 'shape' field in TOML config");
+    }
+
+    auto body = std::make_unique<Body>(this, bodies_.size());
+    bodies_.push_back(body.get());
+    positions_.emplace_back(config["x"].value_or(0.0f), config["y"].value_or(0.0f));
+    angles_.push_back(config["theta"].value_or(0.0f));
+    velocities_.emplace_back(0.0f, 0.0f);
+    angular_velocities_.push_back(0.0f);
+    radii_.push_back(radius);
+    contacts_.push_back(false);
+    bodies_dirty_ = true;
+
+    return body;
+}
+
+void KinematicWorld::remove_body(size_t index)
+{
+    size_t last = bodies_.size() - 1;
+    if (index != last) {
+        bodies_[index] = bodies_[last];
+        bodies_[index]->index_ = index;
+        positions_[index] = positions_[last];
+        angles_[index] = angles_[last];
+        velocities_[index] = velocities_[last];
+        angular_velocities_[index] = angular_velocities_[last];
+        radii_[index] = radii_[last];
+        contacts_[index] = contacts_[last];
+    }
+    bodies_.pop_back();
+    positions_.pop_back();
+    angles_.pop_back();
+    velocities_.pop_back();
+    angular_velocities_.pop_back();
+    radii_.pop_back();
+    contacts_.pop_back();
+    bodies_dirty_ = true;
+}
+
+bool KinematicWorld::add_obstacle(const toml::table& config)
+{
+    Obstacle obstacle;
+    obstacle.center = {config["x"].value_or(0.0f), config["y"].value_or(0.0f)};
+    obstacle.rotation = b2Rot(config["theta"].value_or(0.0f));
+    obstacle.half_extents = {0.0f, 0.0f};
+    obstacle.radius = 0.0;
+
+    // Same default shape as the demo's obstacles
+    std::string_view shape_str = config["shape"].value_or("box");
+    b2Vec2 extent;
+    if (shape_str == "circle") {
+        obstacle.radius = config["radius"].value_or(1.0);
+        extent = {obstacle.radius, obstacle.radius};
+    } else if (shape_str == "box") {
+        obstacle.half_extents = {config["width"].value_or(1.0f) / 2.0f,
+                                 config["height"].value_or(1.0f) / 2.0f};
+        float c = std::abs(obstacle.rotation.c);
+        float s = std::abs(obstacle.rotation.s);
+        extent = {c * obstacle.half_extents.x + s * obstacle.half_extents.y,
+                  s * obstacle.half_extents.x + c * obstacle.half_extents.y};
+    } else {
+        return false;
+    }
+
+    obstacles_.push_back(obstacle);
+    obstacle_boxes_.push_back({obstacle.center - extent, obstacle.center + extent});
+    obstacles_dirty_ = true;
+    return true;
+}
+
+size_t KinematicWorld::add_occupancy_map(const OccupancyMap& map)
+{
+    std::vector<b2AABB> rectangles = map.rectangles();
+    obstacles_.reserve(obstacles_.size() + rectangles.size());
+    obstacle_boxes_.reserve(obstacle_boxes_.size() + rectangles.size());
+    for (const b2AABB& box : rectangles) {
+        obstacles_.push_back({box.GetCenter(), b2Rot(0.0f), box.GetExtents(), 0.0f});
+        obstacle_boxes_.push_back(box);
+    }
+    obstacles_dirty_ = true;
+    return rectangles.size();
+}
+
+void KinematicWorld::step(float delta_t)
+{
+    for (size_t i = 0; i < bodies_.size(); ++i) {
+        positions_[i] += delta_t * velocities_[i];
+        angles_[i] += delta_t * angular_velocities_[i];
+        contacts_[i] = false;
+    }
+
+    resolve_collisions();
+    // For the raycasts until the next step
+    rebuild_body_hash();
+}
+
+void KinematicWorld::rebuild_body_hash()
+{
+    body_boxes_.resize(bodies_.size());
+    for (size_t i = 0; i < bodies_.size(); ++i) {
+        b2Vec2 extent{radii_[i], radii_[i]};
+        body_boxes_[i] = {positions_[i] - extent, positions_[i] + extent};
+    }
+    body_hash_.build(body_boxes_);
+    bodies_dirty_ = false;
+}
+
+void KinematicWorld::resolve_collisions()
+{
+    if (obstacles_dirty_) {
+        obstacle_hash_.build(obstacle_boxes_);
+        obstacles_dirty_ = false;
+    }
+
+    for (unsigned iteration = 0; iteration < options_.iterations; ++iteration) {
+        rebuild_body_hash();
+
+        for (size_t i = 0; i < bodies_.size(); ++i) {
+            b2Vec2& position = positions_[i];
+            float radius = radii_[i];
+
+            obstacle_hash_.query(body_boxes_[i], [&](uint32_t o) {
+                if (push_out(position, radius, obstacles_[o])) {
+                    contacts_[i] = true;
+                }
+            });
+
+            // Each pair is handled once, by the lower index
+            body_hash_.query(body_boxes_[i], [&](uint32_t j) {
+                if (j <= i) {
+                    return;
+                }
+                b2Vec2 diff = positions_[j] - position;
+                float min_distance = radius + radii_[j];
+                float distance_squared = diff.LengthSquared();
+                if (distance_squared >= min_distance * min_distance) {
+                    return;
+                }
+
+                float distance = std::sqrt(distance_squared);
+                b2Vec2 normal = distance > EPSILON ? (1.0f / distance) * diff : b2Vec2{1.0f, 0.0f};
+                b2Vec2 correction = 0.5f * (min_distance - distance) * normal;
+                position -= correction;
+                positions_[j] += correction;
+                contacts_[i] = true;
+                contacts_[j] = true;
+            });
+        }
+    }
+}
+
+std::optional<float> KinematicWorld::raycast(b2Vec2 from, b2Vec2 to, const PhysicsBody* ignore)
+{
+    if (obstacles_dirty_) {
+        obstacle_hash_.build(obstacle_boxes_);
+        obstacles_dirty_ = false;
+    }
+    if (bodies_dirty_) {
+        rebuild_body_hash();
+    }
+
+    float best = obstacle_hash_.raycast(from, to, [&](uint32_t o) {
+        return raycast_obstacle(from, to, obstacles_[o]);
+    });
+
+    size_t index;
+    best = std::min(best, raycast_body_hash(from, to, ignore, index));
+
+    if (best > 1.0f) {
+        return std::nullopt;
+    }
+    return best * (to - from).Length();
+}
+
+void KinematicWorld::bodies_near(b2Vec2 center,
+                                 float radius,
+                                 const PhysicsBody* ignore,
+                                 std::vector<const PhysicsBody*>& bodies)
+{
+    if (bodies_dirty_) {
+        rebuild_body_hash();
+    }
+
+    b2Vec2 extent{radius, radius};
+    body_hash_.query({center - extent, center + extent}, [&](uint32_t i) {
+        float reach = radius + radii_[i];
+        if (bodies_[i] != ignore && (positions_[i] - center).LengthSquared() <= reach * reach) {
+            bodies.push_back(bodies_[i]);
+        }
+    });
+}
+
+std::optional<PhysicsWorld::BodyHit> KinematicWorld::raycast_bodies(b2Vec2 from,
+                                                                   b2Vec2 to,
+                                                                   const PhysicsBody* ignore)
+{
+    if (bodies_dirty_) {
+        rebuild_body_hash();
+    }
+
+    size_t index;
+    float fraction = raycast_body_hash(from, to, ignore, index);
+    if (fraction > 1.0f) {
+        return std::nullopt;
+    }
+    return BodyHit{bodies_[index], fraction * (to - from).Length()};
+}
+
+float KinematicWorld::raycast_body_hash(b2Vec2 from,
+                                        b2Vec2 to,
+                                        const PhysicsBody* ignore,
+                                        size_t& index)
+{
+    float closest = MISS;
+    return body_hash_.raycast(from, to, [&](uint32_t i) {
+        if (bodies_[i] == ignore) {
+            return MISS;
+        }
+        float hit = raycast_circle(from, to, positions_[i], radii_[i]);
+        if (hit < closest) {
+            closest = hit;
+            index = i;
+        }
+        return hit;
+    });
+}
+
+float KinematicWorld::raycast_circle(b2Vec2 p1, b2Vec2 p2, b2Vec2 center, float radius)
+{
+    b2Vec2 d = p2 - p1;
+    b2Vec2 s = p1 - center;
+    float c = b2Dot(s, s) - radius * radius;
+    if (c < 0.0f) {
+        // Starting inside, as Box2D does
+        return MISS;
+    }
+
+    float a = b2Dot(d, d);
+    float b = b2Dot(s, d);
+    float discriminant = b * b - a * c;
+    if (a < EPSILON || discriminant < 0.0f) {
+        return MISS;
+    }
+
+    float t = (-b - std::sqrt(discriminant)) / a;
+    return t >= 0.0f && t <= 1.0f ? t : MISS;
+}
+
+float KinematicWorld::raycast_obstacle(b2Vec2 p1, b2Vec2 p2, const Obstacle& obstacle)
+{
+    if (obstacle.radius > 0.0f) {
+        return raycast_circle(p1, p2, obstacle.center, obstacle.radius);
+    }
+
+    // Slab test in the box's frame
+    b2Vec2 q1 = b2MulT(obstacle.rotation, p1 - obstacle.center);
+    b2Vec2 q2 = b2MulT(obstacle.rotation, p2 - obstacle.center);
+    b2Vec2 d = q2 - q1;
+    const b2Vec2& h = obstacle.half_extents;
+    if (std::abs(q1.x) <= h.x && std::abs(q1.y) <= h.y) {
+        return MISS;
+    }
+
+    float t_enter = 0.0f;
+    float t_exit = 1.0f;
+    for (int axis = 0; axis < 2; ++axis) {
+        float origin = axis == 0 ? q1.x : q1.y;
+        float direction = axis == 0 ? d.x : d.y;
+        float half = axis == 0 ? h.x : h.y;
+        if (std::abs(direction) < EPSILON) {
+            if (std::abs(origin) > half) {
+                return MISS;
+            }
+            continue;
+        }
+        float t0 = (-half - origin) / direction;
+        float t1 = (half - origin) / direction;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        t_enter = std::max(t_enter, t0);
+        t_exit = std::min(t_exit, t1);
+        if (t_enter > t_exit) {
+            return MISS;
+        }
+    }
+    return t_enter;
+}
+
+bool KinematicWorld::push_out(b2Vec2& center, float radius, const Obstacle& obstacle)
+{
+    if (obstacle.radius > 0.0f) {
+        b2Vec2 diff = center - obstacle.center;
+        float min_distance = radius + obstacle.radius;
+        float distance_squared = diff.LengthSquared();
+        if (distance_squared >= min_distance * min_distance) {
+            return false;
+        }
+        float distance = std::sqrt(distance_squared);
+        b2Vec2 normal = distance > EPSILON ? (1.0f / distance) * diff : b2Vec2{1.0f, 0.0f};
+        center = obstacle.center + min_distance * normal;
+        return true;
+    }
+
+    b2Vec2 local = b2MulT(obstacle.rotation, center - obstacle.center);
+    const b2Vec2& h = obstacle.half_extents;
+    b2Vec2 closest{std::clamp(local.x, -h.x, h.x), std::clamp(local.y, -h.y, h.y)};
+    b2Vec2 diff = local - closest;
+    float distance_squared = diff.LengthSquared();
+    if (distance_squared >= radius * radius) {
+        return false;
+    }
+
+    if (distance_squared > EPSILON * EPSILON) {
+        float distance = std::sqrt(distance_squared);
+        local = closest + (radius / distance) * diff;
+    } else {
+        // The center is inside the box, leave through the nearest side
+        float penetration_x = h.x - std::abs(local.x);
+        float penetration_y = h.y - std::abs(local.y);
+        if (penetration_x < penetration_y) {
+            local.x = std::copysign(h.x + radius, local.x);
+        } else {
+            local.y = std::copysign(h.y + radius, local.y);
+        }
+    }
+    center = obstacle.center + b2Mul(obstacle.rotation, local);
+    return true;
+}
+
+} // namespace just
+
+namespace
+{
+
+toml::table circle_config(float x, float y, float radius)
+{
+    return toml::table{{"shape", "circle"}, {"radius", radius}, {"x", x}, {"y", y}};
+}
+
+toml::table box_config(float x, float y, float width, float height, float theta = 0.0)
+{
+    return toml::table{{"shape", "box"},
+                       {"width", width},
+                       {"height", height},
+                       {"x", x},
+                       {"y", y},
+                       {"theta", theta}};
+}
+
+} // namespace
+
+TEST_CASE("KinematicWorld moves bodies by their velocity") {
+    just::KinematicWorld world(just::KinematicWorld::Options{});
+    auto body = world.create_body(circle_config(0.0, 0.0, 1.0));
+    body->set_linear_velocity({2.0, 1.0});
+    body->set_angular_velocity(0.5);
+
+    for (int i = 0; i < 10; ++i) {
+        world.step(0.1);
+    }
+    CHECK(body->position().x == doctest::Approx(2.0));
+    CHECK(body->position().y == doctest::Approx(1.0));
+    CHECK(body->angle() == doctest::Approx(0.5));
+    CHECK_FALSE(body->in_contact());
+
+    CHECK_THROWS(world.create_body(toml::table{{"shape", "triangle"}}));
+    CHECK_FALSE(world.add_obstacle(toml::table{{"shape", "triangle"}}));
+}
+
+TEST_CASE("KinematicWorld resolves collisions") {
+    just::KinematicWorld world(just::KinematicWorld::Options{});
+    // A wall at x = 5, rotated a quarter turn so its width runs along y
+    REQUIRE(world.add_obstacle(box_config(5.5, 0.0, 20.0, 1.0, M_PI / 2)));
+
+    auto body = world.create_body(circle_config(0.0, 0.0, 1.0));
+    body->set_linear_velocity({5.0, 0.0});
+    for (int i = 0; i < 100; ++i) {
+        world.step(0.02);
+    }
+    CHECK(body->position().x == doctest::Approx(4.0).epsilon(0.001));
+    CHECK(body->in_contact());
+
+    // Agents heading at each other stop touching, rather than passing through
+    auto a = world.create_body(circle_config(-10.0, 10.0, 1.0));
+    auto b = world.create_body(box_config(-4.0, 10.0, 2.0, 2.0));
+    a->set_linear_velocity({2.0, 0.0});
+    b->set_linear_velocity({-2.0, 0.0});
+    for (int i = 0; i < 100; ++i) {
+        world.step(0.02);
+    }
+    float distance = (b->position() - a->position()).Length();
+    CHECK(distance >= doctest::Approx(1.0 + std::sqrt(2.0)).epsilon(0.01));
+    CHECK(a->in_contact());
+    CHECK(b->in_contact());
+
+    // Removing a body keeps the others intact
+    b2Vec2 a_position = a->position();
+    b2Vec2 b_position = b->position();
+    body.reset();
+    CHECK(world.body_count() == 2);
+    CHECK(a->position().x == a_position.x);
+    CHECK(a->position().y == a_position.y);
+    CHECK(b->position().x == b_position.x);
+    CHECK(b->position().y == b_position.y);
+}
+
+TEST_CASE("KinematicWorld raycasts") {
+    just::KinematicWorld world(just::KinematicWorld::Options{});
+    REQUIRE(world.add_obstacle(box_config(10.0, 0.0, 2.0, 2.0)));
+    REQUIRE(world.add_obstacle(circle_config(0.0, -6.0, 1.0)));
+    auto self = world.create_body(circle_config(0.0, 0.0, 1.0));
+    auto other = world.create_body(circle_config(0.0, 20.0, 2.0));
+
+    // The caster itself is ignored
+    auto hit = world.raycast({0.0, 0.0}, {25.0, 0.0}, self.get());
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(9.0));
+    hit = world.raycast({0.0, 0.0}, {0.0, -25.0}, self.get());
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(5.0));
+    hit = world.raycast({0.0, 0.0}, {0.0, 25.0}, self.get());
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(18.0));
+
+    // Out of range and misses
+    CHECK_FALSE(world.raycast({0.0, 0.0}, {5.0, 0.0}, self.get()));
+    CHECK_FALSE(world.raycast({0.0, 0.0}, {-25.0, 0.0}, self.get()));
+
+    // The nearest of several hits
+    hit = world.raycast({30.0, 0.0}, {-30.0, 0.0}, nullptr);
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(19.0));
+}
+
+TEST_CASE("KinematicWorld proximity queries") {
+    just::KinematicWorld world(just::KinematicWorld::Options{});
+    REQUIRE(world.add_obstacle(circle_config(5.0, 0.0, 1.0)));
+
+    // A lattice of agents, far enough apart not to push each other around
+    std::vector<std::unique_ptr<just::PhysicsBody>> bodies;
+    for (int i = 0; i < 20; ++i) {
+        for (int j = 0; j < 20; ++j) {
+            bodies.push_back(world.create_body(circle_config(i * 3.0, j * 3.0, 0.5)));
+        }
+    }
+    world.step(0.01);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-5.0, 65.0);
+    std::uniform_real_distribution<float> radius(0.0, 10.0);
+    for (int query = 0; query < 100; ++query) {
+        b2Vec2 center{position(rng), position(rng)};
+        float r = radius(rng);
+        const just::PhysicsBody* self = bodies[query].get();
+
+        std::vector<const just::PhysicsBody*> near;
+        world.bodies_near(center, r, self, near);
+
+        // Compared to checking every body
+        std::vector<const just::PhysicsBody*> expected;
+        for (const auto& body : bodies) {
+            if (body.get() != self && (body->position() - center).Length() <= r + 0.5) {
+                expected.push_back(body.get());
+            }
+        }
+        std::sort(near.begin(), near.end());
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(near == expected);
+    }
+
+    // Rays only see bodies, the obstacle in the way is ignored
+    auto hit = world.raycast_bodies({-10.0, 0.0}, {10.0, 0.0}, nullptr);
+    REQUIRE(hit);
+    CHECK(hit->body == bodies[0].get());
+    CHECK(hit->distance == doctest::Approx(9.5));
+    hit = world.raycast_bodies({0.0, 0.0}, {10.0, 0.0}, bodies[0].get());
+    REQUIRE(hit);
+    CHECK(hit->body == bodies[20].get());
+    CHECK(hit->distance == doctest::Approx(2.5));
+    CHECK_FALSE(world.raycast_bodies({-1.0, -1.0}, {-1.0, 60.0}, nullptr));
+
+    // Removed bodies are gone from the queries right away
+    bodies.erase(bodies.begin());
+    hit = world.raycast_bodies({-10.0, 0.0}, {10.0, 0.0}, nullptr);
+    REQUIRE(hit);
+    CHECK(hit->body == bodies[19].get());
+}
+
+TEST_CASE("KinematicWorld occupancy maps") {
+    // A 20 x 10 m room with 1 m thick walls, its bottom left corner at the origin
+    constexpr unsigned W = 20;
+    constexpr unsigned H = 10;
+    std::vector<uint8_t> pixels(W * H, 255);
+    for (unsigned row = 0; row < H; ++row) {
+        for (unsigned col = 0; col < W; ++col) {
+            if (row == 0 || row == H - 1 || col == 0 || col == W - 1) {
+                pixels[col + row * W] = 0;
+            }
+        }
+    }
+    just::OccupancyMap::Options options;
+    options.resolution = 1.0;
+    just::OccupancyMap map(W, H, pixels, options);
+
+    just::KinematicWorld world(just::KinematicWorld::Options{});
+    CHECK(world.add_occupancy_map(map) == 4);
+    CHECK(world.obstacle_count() == 4);
+
+    auto hit = world.raycast({5.0, 5.0}, {50.0, 5.0}, nullptr);
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(14.0));
+    hit = world.raycast({5.0, 5.0}, {5.0, -50.0}, nullptr);
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(4.0));
+
+    // Bodies stay inside
+    auto body = world.create_body(circle_config(10.0, 5.0, 0.5));
+    body->set_linear_velocity({0.0, 5.0});
+    for (int i = 0; i < 100; ++i) {
+        world.step(0.02);
+    }
+    CHECK(body->position().y == doctest::Approx(8.5).epsilon(0.001));
+    CHECK(body->in_contact());
+}
+
+TEST_CASE("KinematicWorld raycasts match Box2DWorld") {
+    just::KinematicWorld kinematic(just::KinematicWorld::Options{});
+    just::Box2DWorld box2d;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-30.0, 30.0);
+    std::uniform_real_distribution<float> size(0.5, 3.0);
+    std::uniform_real_distribution<float> angle(0.0, M_PI);
+    for (int i = 0; i < 100; ++i) {
+        toml::table config = i % 2 == 0
+            ? circle_config(position(rng), position(rng), size(rng))
+            : box_config(position(rng), position(rng), size(rng), size(rng), angle(rng));
+        REQUIRE(kinematic.add_obstacle(config));
+        REQUIRE(box2d.add_obstacle(config));
+    }
+
+    for (int i = 0; i < 360; ++i) {
+        float theta = i * M_PI / 180.0;
+        b2Vec2 from{0.0, 0.0};
+        b2Vec2 to{40.0f * std::cos(theta), 40.0f * std::sin(theta)};
+        auto kinematic_hit = kinematic.raycast(from, to, nullptr);
+        auto box2d_hit = box2d.raycast(from, to, nullptr);
+        REQUIRE(kinematic_hit.has_value() == box2d_hit.has_value());
+        if (kinematic_hit) {
+            CHECK(*kinematic_hit == doctest::Approx(*box2d_hit).epsilon(0.001));
+        }
+    }
+}
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "doctest/doctest.h"
+
+#include "just/live_stream.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+// The slots start on their own cache line after the header
+constexpr size_t SLOTS_OFFSET = (sizeof(LiveHeader) + alignof(LiveSlot) - 1)
+                                / alignof(LiveSlot) * alignof(LiveSlot);
+
+std::runtime_error system_error(const std::string& what, const std::string& name)
+{
+    return std::runtime_error(what + " '" + name + "': " + std::strerror(errno));
+}
+
+} // namespace
+
+LivePublisher::LivePublisher(LiveSlot* slot, const std::string& agent_name)
+    : slot_(slot)
+{
+    // Truncated if need be, always null terminated
+    size_t length = std::min(agent_name.size(), LiveSlot::NAME_SIZE - 1);
+    std::copy_n(agent_name.begin(), length, staged_.name.begin());
+}
+
+void LivePublisher::publish_window(std::span<const uint8_t, VFHAgent::WINDOW_SIZE_SQUARED> window)
+{
+    std::copy(window.begin(), window.end(), staged_.window.begin());
+    staged_.flags |= LiveSlot::WINDOW;
+}
+
+void LivePublisher::publish_polar_histogram(std::span<const float, VFHAgent::K> polar_histogram)
+{
+    std::copy(polar_histogram.begin(), polar_histogram.end(), staged_.polar_histogram.begin());
+    staged_.flags |= LiveSlot::POLAR_HISTOGRAM;
+}
+
+void LivePublisher::publish_motion(float angle, float speed, float x, float y)
+{
+    staged_.motion = {angle, speed, x, y};
+    staged_.flags |= LiveSlot::MOTION;
+}
+
+void LivePublisher::end_step()
+{
+    ++staged_.step;
+
+    // Only this publisher ever writes the sequence, no read-modify-write needed
+    uint64_t sequence = slot_->sequence.load(std::memory_order_relaxed);
+    slot_->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot_->data, &staged_, sizeof(staged_));
+    slot_->sequence.store(sequence + 2, std::memory_order_release);
+
+    staged_.flags = 0;
+}
+
+LiveStream::LiveStream(const std::string& name, size_t slot_count)
+    : name_(name),
+      size_(SLOTS_OFFSET + slot_count * sizeof(LiveSlot))
+{
+    // A stale segment left behind by a crashed run is simply replaced
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw system_error("Failed to create shared memory", name);
+    }
+    if (ftruncate(fd, size_) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw system_error("Failed to size shared memory", name);
+    }
+    memory_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory_ == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw system_error("Failed to map shared memory", name);
+    }
+
+    // The segment comes zero filled, which is a valid (unused) state for every slot
+    header_ = static_cast<LiveHeader*>(memory_);
+    header_->version = LiveHeader::VERSION;
+    header_->slot_count = slot_count;
+    header_->slot_size = sizeof(LiveSlot);
+    header_->slots_offset = SLOTS_OFFSET;
+    header_->k = VFHAgent::K;
+    header_->window_size = VFHAgent::WINDOW_SIZE;
+    header_->name_size = LiveSlot::NAME_SIZE;
+    size_t data_offset = offsetof(LiveSlot, data);
+    header_->name_offset = data_offset + offsetof(LiveSlot::Data, name);
+    header_->step_offset = data_offset + offsetof(LiveSlot::Data, step);
+    header_->flags_offset = data_offset + offsetof(LiveSlot::Data, flags);
+    header_->motion_offset = data_offset + offsetof(LiveSlot::Data, motion);
+    header_->polar_histogram_offset = data_offset + offsetof(LiveSlot::Data, polar_histogram);
+    header_->window_offset = data_offset + offsetof(LiveSlot::Data, window);
+    header_->magic.store(LiveHeader::MAGIC, std::memory_order_release);
+}
+
+LiveStream::~LiveStream()
+{
+    // Readers that are still attached keep their mapping (of the final state) until they detach
+    munmap(memory_, size_);
+    shm_unlink(name_.c_str());
+}
+
+LivePublisher LiveStream::add_publisher(const std::string& agent_name)
+{
+    uint32_t idx = header_->slots_used.load(std::memory_order_relaxed);
+    if (idx >= header_->slot_count) {
+        throw std::runtime_error("No free slot in live stream '" + name_ + "' for agent "
+                                 + agent_name);
+    }
+
+    auto* slots = reinterpret_cast<LiveSlot*>(static_cast<std::byte*>(memory_) + SLOTS_OFFSET);
+    LivePublisher publisher(&slots[idx], agent_name);
+    header_->slots_used.store(idx + 1, std::memory_order_release);
+    return publisher;
+}
+
+LiveStreamReader::LiveStreamReader(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw system_error("Failed to open shared memory", name);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < SLOTS_OFFSET) {
+        close(fd);
+        throw std::runtime_error("Shared memory '" + name + "' is not a live stream");
+    }
+    size_ = info.st_size;
+    memory_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory_ == MAP_FAILED) {
+        throw system_error("Failed to map shared memory", name);
+    }
+
+    header_ = static_cast<const LiveHeader*>(memory_);
+    if (header_->magic.load(std::memory_order_acquire) != LiveHeader::MAGIC
+        || header_->version != LiveHeader::VERSION
+        || header_->slot_size != sizeof(LiveSlot)
+        || size_ < SLOTS_OFFSET + header_->slot_count * sizeof(LiveSlot)) {
+        munmap(memory_, size_);
+        throw std::runtime_error("Shared memory '" + name + "' is not a compatible live stream");
+    }
+    slots_ = reinterpret_cast<const LiveSlot*>(static_cast<const std::byte*>(memory_)
+                                               + SLOTS_OFFSET);
+}
+
+LiveStreamReader::~LiveStreamReader()
+{
+    munmap(memory_, size_);
+}
+
+size_t LiveStreamReader::size() const
+{
+    return header_->slots_used.load(std::memory_order_acquire);
+}
+
+bool LiveStreamReader::read(size_t slot, Snapshot& snapshot, unsigned max_retries) const
+{
+    if (slot >= size()) {
+        return false;
+    }
+
+    const LiveSlot& live_slot = slots_[slot];
+    for (unsigned attempt = 0; attempt < max_retries; ++attempt) {
+        uint64_t before = live_slot.sequence.load(std::memory_order_acquire);
+        if (before == 0) {
+            // Never published
+            return false;
+        }
+        if (before % 2 == 1) {
+            // Mid write
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::memcpy(&snapshot, &live_slot.data, sizeof(snapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (live_slot.sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace just
+
+TEST_CASE("LiveStream publish and read") {
+    const std::string name = "/just_live_test";
+    just::LiveStream stream(name, 2);
+    auto tom = stream.add_publisher("tom");
+    auto jerry = stream.add_publisher("jerry");
+    CHECK_THROWS(stream.add_publisher("spike"));
+
+    just::LiveStreamReader reader(name);
+    REQUIRE(reader.size() == 2);
+
+    just::LiveStreamReader::Snapshot snapshot;
+    CHECK_FALSE(reader.read(0, snapshot));
+    CHECK_FALSE(reader.read(2, snapshot));
+
+    std::array<float, just::VFHAgent::K> polar_histogram;
+    polar_histogram.fill(3.0);
+    tom.publish_polar_histogram(polar_histogram);
+    tom.publish_motion(0.5, 1.0, 2.0, 3.0);
+    tom.end_step();
+    jerry.publish_motion(0.0, 0.0, 0.0, 0.0);
+    jerry.end_step();
+    jerry.end_step();
+
+    REQUIRE(reader.read(0, snapshot));
+    CHECK(std::string(snapshot.name.data()) == "tom");
+    CHECK(snapshot.step == 1);
+    CHECK(snapshot.flags == (just::LiveSlot::POLAR_HISTOGRAM | just::LiveSlot::MOTION));
+    CHECK(snapshot.polar_histogram[10] == 3.0);
+    CHECK(snapshot.motion[3] == 3.0);
+
+    REQUIRE(reader.read(1, snapshot));
+    CHECK(std::string(snapshot.name.data()) == "jerry");
+    CHECK(snapshot.step == 2);
+    CHECK(snapshot.flags == 0);
+}
+
+TEST_CASE("LiveStream reads are never torn") {
+    const std::string name = "/just_live_test";
+    just::LiveStream stream(name, 1);
+    auto publisher = stream.add_publisher("agent");
+
+    constexpr int STEPS = 20000;
+    std::thread writer([&publisher] {
+        std::array<float, just::VFHAgent::K> polar_histogram;
+        for (int i = 1; i <= STEPS; ++i) {
+            polar_histogram.fill(i);
+            publisher.publish_polar_histogram(polar_histogram);
+            publisher.end_step();
+        }
+    });
+
+    just::LiveStreamReader reader(name);
+    just::LiveStreamReader::Snapshot snapshot;
+    bool consistent = true;
+    uint64_t last_step = 0;
+    while (last_step < STEPS) {
+        if (!reader.read(0, snapshot)) {
+            continue;
+        }
+        // Every value of a step is the step number, anything else is a torn read
+        consistent = consistent && std::all_of(snapshot.polar_histogram.begin(),
+                                               snapshot.polar_histogram.end(),
+                                               [&snapshot](float value) {
+                                                   return value == snapshot.step;
+                                               });
+        consistent = consistent && snapshot.step >= last_step;
+        last_step = snapshot.step;
+    }
+    writer.join();
+
+    CHECK(consistent);
+}
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <numeric>
+#include <mutex>
+#include <stdexcept>
+
+#include "doctest/doctest.h"
+
+#include "just/log_reader.hpp"
+#include "just/telemetry.hpp"
+
+namespace just
+{
+
+// One block of steps of a [N, steps] dataset, transposed so each step is contiguous
+template <typename T, size_t N>
+class LogReader::ColumnStream
+{
+public:
+    explicit ColumnStream(HighFive::DataSet dataset)
+        : dataset_(std::move(dataset)),
+          columns_(dataset_.getDimensions().at(1))
+    {
+    }
+
+    std::span<const T, N> get(size_t step)
+    {
+        if (step >= columns_) {
+            throw std::out_of_range("Step " + std::to_string(step) + " is past the end of the log");
+        }
+
+        if (step < block_start_ || step >= block_start_ + block_.size()) {
+            load(step - step % BLOCK_STEPS);
+        }
+        return block_[step - block_start_];
+    }
+
+private:
+    HighFive::DataSet dataset_;
+    size_t columns_;
+    size_t block_start_{0};
+    std::vector<std::array<T, N>> block_;
+    std::vector<T> buffer_;
+
+    void load(size_t start)
+    {
+        size_t count = std::min(BLOCK_STEPS, columns_ - start);
+        buffer_.resize(N * count);
+        {
+            std::lock_guard lock(Telemetry::hdf5_mutex());
+            dataset_.select({0, start}, {N, count}).read_raw(buffer_.data());
+        }
+
+        block_.resize(count);
+        for (size_t row = 0; row < N; ++row) {
+            for (size_t col = 0; col < count; ++col) {
+                block_[col][row] = buffer_[row * count + col];
+            }
+        }
+        block_start_ = start;
+    }
+};
+
+// The keyframes and deltas of the full grid history. The per grid step tables are small and
+// loaded up front, keyframes and deltas are read as grids are asked for.
+class LogReader::GridHistory
+{
+public:
+    explicit GridHistory(const HighFive::Group& group)
+        : keyframes_(group.getDataSet("keyframes")),
+          delta_cells_(group.getDataSet("delta_cells")),
+          delta_values_(group.getDataSet("delta_values"))
+    {
+        group.getAttribute("width").read(width_);
+        group.getAttribute("height").read(height_);
+        group.getDataSet("keyframe_steps").read(keyframe_steps_);
+        group.getDataSet("steps").read(steps_);
+        std::vector<uint32_t> counts;
+        group.getDataSet("delta_counts").read(counts);
+        // A crash may leave the tables of the last block partly written
+        size_t grid_steps = std::min(steps_.size(), counts.size());
+        steps_.resize(grid_steps);
+        delta_offsets_.resize(grid_steps + 1, 0);
+        for (size_t i = 0; i < grid_steps; ++i) {
+            delta_offsets_[i + 1] = delta_offsets_[i] + counts[i];
+        }
+        keyframe_steps_.resize(std::min(keyframe_steps_.size(),
+                                        keyframes_.getDimensions().at(1)));
+    }
+
+    unsigned width() const { return width_; }
+    unsigned height() const { return height_; }
+
+    std::vector<uint8_t> at(uint64_t agent_step)
+    {
+        // The last grid step and the last keyframe at or before the agent's step. The first grid
+        // step is always a keyframe, so there is one if there is a grid step.
+        auto step = std::upper_bound(steps_.begin(), steps_.end(), agent_step);
+        auto keyframe = std::upper_bound(keyframe_steps_.begin(),
+                                         keyframe_steps_.end(),
+                                         agent_step);
+        if (step == steps_.begin() || keyframe == keyframe_steps_.begin()) {
+            throw std::out_of_range("No grid logged at or before step "
+                                    + std::to_string(agent_step));
+        }
+        size_t last = step - steps_.begin() - 1;
+        size_t column = keyframe - keyframe_steps_.begin() - 1;
+        size_t first = std::lower_bound(steps_.begin(), steps_.end(), keyframe_steps_[column])
+                       - steps_.begin();
+
+        std::vector<uint8_t> grid(static_cast<size_t>(width_) * height_);
+        size_t start = delta_offsets_[first + 1];
+        size_t count = delta_offsets_[last + 1] - start;
+        std::vector<uint32_t> cells(count);
+        std::vector<uint8_t> values(count);
+        {
+            std::lock_guard lock(Telemetry::hdf5_mutex());
+            keyframes_.select({0, column}, {grid.size(), 1}).read_raw(grid.data());
+            if (count > 0) {
+                delta_cells_.select({start}, {count}).read_raw(cells.data());
+                delta_values_.select({start}, {count}).read_raw(values.data());
+            }
+        }
+        // In order, so a cell changed more than once ends up with its last value
+        for (size_t i = 0; i < count; ++i) {
+            grid[cells[i]] = values[i];
+        }
+        return grid;
+    }
+
+private:
+    HighFive::DataSet keyframes_;
+    HighFive::DataSet delta_cells_;
+    HighFive::DataSet delta_values_;
+    unsigned width_{0};
+    unsigned height_{0};
+    std::vector<uint64_t> keyframe_steps_;
+    std::vector<uint64_t> steps_;
+    std::vector<uint64_t> delta_offsets_;
+};
+
+LogReader::LogReader(const std::string& filename, const std::string& group)
+{
+    std::lock_guard lock(Telemetry::hdf5_mutex());
+    file_ = std::make_unique<HighFive::File>(filename, HighFive::File::ReadOnly);
+    HighFive::Group base = file_->getGroup(group);
+
+    // The whole motion dataset is read at once, it's small enough even for very long runs
+    HighFive::DataSet motion = base.getDataSet("vfh_agent/packed_motion");
+    size_t steps = motion.getDimensions().at(1);
+    std::vector<float> buffer(4 * steps);
+    if (steps > 0) {
+        motion.select({0, 0}, {4, steps}).read_raw(buffer.data());
+    }
+    motion_.resize(steps);
+    for (size_t step = 0; step < steps; ++step) {
+        motion_[step] = {buffer[step],
+                         buffer[steps + step],
+                         buffer[2 * steps + step],
+                         buffer[3 * steps + step]};
+    }
+
+    agent_steps_.resize(steps);
+    if (base.exist("vfh_agent/agent_steps")) {
+        HighFive::DataSet agent_steps = base.getDataSet("vfh_agent/agent_steps");
+        if (agent_steps.getDimensions().at(0) != steps) {
+            throw std::runtime_error("The log's agent_steps don't match its motion");
+        }
+        if (steps > 0) {
+            agent_steps.select({0}, {steps}).read_raw(agent_steps_.data());
+        }
+    } else {
+        std::iota(agent_steps_.begin(), agent_steps_.end(), uint64_t{0});
+    }
+
+    polar_histogram_ = std::make_unique<ColumnStream<float, K>>(
+        base.getDataSet("vfh_agent/polar_histogram"));
+    window_ = std::make_unique<ColumnStream<uint8_t, WINDOW_SIZE_SQUARED>>(
+        base.getDataSet("vfh_agent/window_histogram"));
+    if (base.exist("vfh_agent/full_histogram/steps")) {
+        grid_ = std::make_unique<GridHistory>(base.getGroup("vfh_agent/full_histogram"));
+    }
+}
+
+LogReader::~LogReader()
+{
+    std::lock_guard lock(Telemetry::hdf5_mutex());
+    polar_histogram_.reset();
+    window_.reset();
+    grid_.reset();
+    file_.reset();
+}
+
+std::vector<std::string> LogReader::agents(const std::string& filename)
+{
+    std::lock_guard lock(Telemetry::hdf5_mutex());
+    HighFive::File file(filename, HighFive::File::ReadOnly);
+
+    std::vector<std::string> names;
+    for (const std::string& name : file.listObjectNames()) {
+        if (file.exist(name + "/vfh_agent/packed_motion")) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+size_t LogReader::find(uint64_t agent_step) const
+{
+    auto it = std::upper_bound(agent_steps_.begin(), agent_steps_.end(), agent_step);
+    return it == agent_steps_.begin() ? 0 : it - agent_steps_.begin() - 1;
+}
+
+std::span<const float, LogReader::K> LogReader::polar_histogram(size_t step)
+{
+    return polar_histogram_->get(step);
+}
+
+std::span<const uint8_t, LogReader::WINDOW_SIZE_SQUARED> LogReader::window(size_t step)
+{
+    return window_->get(step);
+}
+
+unsigned LogReader::grid_width() const
+{
+    return grid_ ? grid_->width() : 0;
+}
+
+unsigned LogReader::grid_height() const
+{
+    return grid_ ? grid_->height() : 0;
+}
+
+std::vector<uint8_t> LogReader::grid(uint64_t agent_step)
+{
+    if (!grid_) {
+        throw std::out_of_range("The log has no grid history");
+    }
+    return grid_->at(agent_step);
+}
+
+} // namespace just
+
+TEST_CASE("LogReader reads back a VFHAgent log") {
+    toml::table config{
+        {"name", "just_log_reader_test"},
+        {"type", "vfh"},
+        {"grid", toml::table{{"width", 200}, {"height", 200}}},
+        {"sensor", toml::table{{"count", 8}, {"range", 10.0}}},
+        {"goal", toml::table{{"x", 80.0}, {"y", 0.0}}},
+        {"valley_threshold", 10000.0},
+        {"speed", 1.0},
+        {"shape", "circle"},
+        {"radius", 1.0},
+        {"x", -80.0},
+        {"y", 0.0},
+    };
+    std::string filename = "/tmp/just/just_log_reader_test/log.h5";
+
+    // Enough steps for a few blocks, the last one partial
+    constexpr size_t STEPS = 3 * just::LogReader::BLOCK_STEPS + 10;
+    std::vector<b2Vec2> positions;
+    std::vector<uint8_t> final_grid;
+    {
+        just::Box2DWorld world;
+        just::VFHAgent agent(config, &world);
+        for (size_t step = 0; step < STEPS; ++step) {
+            positions.push_back(agent.get_body()->position());
+            agent.step(0.01);
+            world.step(0.01);
+        }
+        const just::HistogramGrid& grid = agent.grid();
+        final_grid.assign(grid.data(), grid.data() + grid.width() * grid.height());
+    }
+
+    just::LogReader reader(filename);
+    REQUIRE(reader.steps() == STEPS);
+    CHECK(reader.motion()[0].x == positions[0].x);
+    CHECK(reader.motion()[STEPS - 1].x == positions[STEPS - 1].x);
+    CHECK(reader.motion()[STEPS - 1].y == positions[STEPS - 1].y);
+    // Every step was logged
+    CHECK(reader.agent_steps()[STEPS - 1] == STEPS - 1);
+    CHECK(reader.find(300) == 300);
+
+    // The grid history, rebuilt from a keyframe and the deltas after it
+    REQUIRE(reader.has_grid());
+    CHECK(reader.grid_width() == 200);
+    CHECK(reader.grid(STEPS - 1) == final_grid);
+    CHECK(reader.grid(STEPS + 100) == final_grid);
+
+    // Sequential access, one block at a time
+    std::vector<std::array<float, just::VFHAgent::K>> polar_histograms(STEPS);
+    std::vector<uint8_t> centers(STEPS);
+    for (size_t step = 0; step < STEPS; ++step) {
+        auto polar_histogram = reader.polar_histogram(step);
+        std::copy(polar_histogram.begin(), polar_histogram.end(), polar_histograms[step].begin());
+        centers[step] = reader.window(step)[just::VFHAgent::WINDOW_SIZE_SQUARED / 2];
+    }
+
+    // Backwards and random access see the same data
+    for (size_t step : {STEPS - 1, size_t{300}, size_t{299}, size_t{5}, size_t{0}}) {
+        auto polar_histogram = reader.polar_histogram(step);
+        CHECK(std::equal(polar_histogram.begin(),
+                         polar_histogram.end(),
+                         polar_histograms[step].begin()));
+        CHECK(reader.window(step)[just::VFHAgent::WINDOW_SIZE_SQUARED / 2] == centers[step]);
+    }
+    CHECK_THROWS_AS(reader.polar_histogram(STEPS), std::out_of_range);
+
+    std::filesystem::remove_all("/tmp/just/just_log_reader_test");
+}
+
+TEST_CASE("LogReader finds steps by the agent's step number") {
+    std::string filename = "/tmp/just_log_reader_find_test.h5";
+    std::vector<uint64_t> agent_steps{2, 3, 7, 8, 20};
+    size_t steps = agent_steps.size();
+    {
+        std::lock_guard lock(just::Telemetry::hdf5_mutex());
+        HighFive::File file(filename, HighFive::File::OpenOrCreate | HighFive::File::Truncate);
+        HighFive::Group group = file.createGroup("vfh_agent");
+        // Only motion is read up front, the histograms can stay empty
+        auto create = [&group, steps](const std::string& name, size_t rows, auto datatype) {
+            return group.createDataSet(name, HighFive::DataSpace({rows, steps}), datatype);
+        };
+        std::vector<float> motion(4 * steps, 0.0f);
+        create("packed_motion", 4, HighFive::create_datatype<float>()).write_raw(motion.data());
+        create("polar_histogram", just::LogReader::K, HighFive::create_datatype<float>());
+        create("window_histogram",
+               just::LogReader::WINDOW_SIZE_SQUARED,
+               HighFive::create_datatype<uint8_t>());
+        group.createDataSet("agent_steps", agent_steps);
+    }
+
+    just::LogReader reader(filename);
+    REQUIRE(reader.steps() == steps);
+    CHECK(reader.agent_steps() == agent_steps);
+    // Before the first logged step, at logged steps and in the gaps between them
+    CHECK(reader.find(0) == 0);
+    CHECK(reader.find(2) == 0);
+    CHECK(reader.find(3) == 1);
+    CHECK(reader.find(6) == 1);
+    CHECK(reader.find(8) == 3);
+    CHECK(reader.find(19) == 3);
+    CHECK(reader.find(20) == 4);
+    CHECK(reader.find(1000) == 4);
+
+    CHECK_FALSE(reader.has_grid());
+    CHECK_THROWS_AS(reader.grid(0), std::out_of_range);
+
+    std::filesystem::remove(filename);
+}
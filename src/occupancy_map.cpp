@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "raylib.h"
+#include "doctest/doctest.h"
+
+#include "just/occupancy_map.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+// PGM header fields are separated by whitespace, with '#' comments running to the end of the line
+unsigned read_pgm_field(const std::string& data, size_t& pos)
+{
+    while (pos < data.size()) {
+        if (data[pos] == '#') {
+            pos = data.find('\n', pos);
+            if (pos == std::string::npos) {
+                pos = data.size();
+            }
+        } else if (std::isspace(static_cast<unsigned char>(data[pos]))) {
+            ++pos;
+        } else {
+            break;
+        }
+    }
+
+    size_t start = pos;
+    unsigned value = 0;
+    while (pos < data.size() && std::isdigit(static_cast<unsigned char>(data[pos]))) {
+        unsigned digit = data[pos] - '0';
+        if (value > (std::numeric_limits<unsigned>::max() - digit) / 10) {
+            throw std::runtime_error("PGM image field is out of range");
+        }
+        value = value * 10 + digit;
+        ++pos;
+    }
+    if (pos == start) {
+        throw std::runtime_error("Malformed PGM image");
+    }
+    return value;
+}
+
+// Pixels scaled to 0 (black) to 255 (white)
+std::vector<uint8_t> read_pgm(const std::string& data, unsigned& width, unsigned& height)
+{
+    bool plain = data[1] == '2';
+    size_t pos = 2;
+    width = read_pgm_field(data, pos);
+    height = read_pgm_field(data, pos);
+    unsigned max_value = read_pgm_field(data, pos);
+    if (max_value == 0 || max_value > 255) {
+        throw std::runtime_error("Only 8 bit PGM images are supported");
+    }
+
+    if (!plain) {
+        // A single whitespace character separates the header from the pixels
+        ++pos;
+    }
+    // Checked before allocating, so a corrupt header can't ask for gigabytes. A binary pixel is a
+    // byte, a plain one at least two (a digit and a separator, bar the last pixel's).
+    size_t count = static_cast<size_t>(width) * height;
+    size_t available = data.size() > pos ? data.size() - pos : 0;
+    if ((plain ? (available + 1) / 2 : available) < count) {
+        throw std::runtime_error("PGM image is truncated");
+    }
+
+    std::vector<uint8_t> pixels(count);
+    if (plain) {
+        for (uint8_t& pixel : pixels) {
+            pixel = std::min(read_pgm_field(data, pos), max_value) * 255 / max_value;
+        }
+    } else {
+        std::transform(data.begin() + pos, data.begin() + pos + count, pixels.begin(), [&](char c) {
+            return std::min<unsigned>(static_cast<uint8_t>(c), max_value) * 255 / max_value;
+        });
+    }
+    return pixels;
+}
+
+} // namespace
+
+OccupancyMap::Options OccupancyMap::options_from_config(const toml::table& map_config)
+{
+    Options options;
+    options.resolution = map_config["resolution"].value_or(options.resolution);
+    options.x = map_config["x"].value_or(options.x);
+    options.y = map_config["y"].value_or(options.y);
+    options.occupied_threshold =
+        map_config["occupied_threshold"].value_or(options.occupied_threshold);
+    options.negate = map_config["negate"].value_or(options.negate);
+    return options;
+}
+
+OccupancyMap OccupancyMap::load(const std::string& path, Options options)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to open map image '" + path + "'");
+    }
+    std::string data(std::istreambuf_iterator<char>(file), {});
+
+    unsigned width;
+    unsigned height;
+    std::vector<uint8_t> pixels;
+    if (data.size() >= 2 && data[0] == 'P' && (data[1] == '2' || data[1] == '5')) {
+        pixels = read_pgm(data, width, height);
+    } else {
+        // Everything else is left to raylib, which reads images without needing a window
+        Image image = LoadImage(path.c_str());
+        if (!image.data) {
+            throw std::runtime_error("Unable to read map image '" + path + "'");
+        }
+        ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+        width = image.width;
+        height = image.height;
+        const uint8_t* begin = static_cast<const uint8_t*>(image.data);
+        pixels.assign(begin, begin + static_cast<size_t>(width) * height);
+        UnloadImage(image);
+    }
+
+    return OccupancyMap(width, height, pixels, options);
+}
+
+OccupancyMap::OccupancyMap(unsigned width,
+                           unsigned height,
+                           const std::vector<uint8_t>& pixels,
+                           Options options)
+    : options_(options),
+      width_(width),
+      height_(height),
+      occupied_(static_cast<size_t>(width) * height)
+{
+    if (pixels.size() != occupied_.size()) {
+        throw std::invalid_argument("OccupancyMap needs width * height pixels");
+    }
+    if (!(options_.resolution > 0.0)) {
+        throw std::invalid_argument("OccupancyMap resolution must be positive");
+    }
+
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        float darkness = 1.0f - pixels[i] / 255.0f;
+        if (options_.negate) {
+            darkness = 1.0f - darkness;
+        }
+        occupied_[i] = darkness > options_.occupied_threshold;
+    }
+}
+
+std::vector<b2AABB> OccupancyMap::rectangles() const
+{
+    std::vector<b2AABB> rectangles;
+    std::vector<uint8_t> covered(occupied_.size(), false);
+    auto free = [&](unsigned col, unsigned row) {
+        size_t i = col + static_cast<size_t>(row) * width_;
+        return !occupied_[i] || covered[i];
+    };
+
+    float resolution = options_.resolution;
+    for (unsigned row = 0; row < height_; ++row) {
+        for (unsigned col = 0; col < width_; ++col) {
+            if (free(col, row)) {
+                continue;
+            }
+
+            unsigned end_col = col + 1;
+            while (end_col < width_ && !free(end_col, row)) {
+                ++end_col;
+            }
+            unsigned end_row = row + 1;
+            while (end_row < height_) {
+                bool full = true;
+                for (unsigned c = col; c < end_col && full; ++c) {
+                    full = !free(c, end_row);
+                }
+                if (!full) {
+                    break;
+                }
+                ++end_row;
+            }
+
+            for (unsigned r = row; r < end_row; ++r) {
+                std::fill_n(covered.begin() + col + static_cast<size_t>(r) * width_,
+                            end_col - col,
+                            true);
+            }
+            // Rows count down from the top of the image
+            rectangles.push_back({{options_.x + col * resolution,
+                                   options_.y + (height_ - end_row) * resolution},
+                                  {options_.x + end_col * resolution,
+                                   options_.y + (height_ - row) * resolution}});
+            col = end_col - 1;
+        }
+    }
+    return rectangles;
+}
+
+} // namespace just
+
+namespace
+{
+
+// Whether the rectangles cover exactly the occupied cells of the map, each at most once
+bool covers_exactly(const just::OccupancyMap& map, const std::vector<b2AABB>& rectangles)
+{
+    const auto& options = map.options();
+    std::vector<int> counts(static_cast<size_t>(map.width()) * map.height(), 0);
+    for (const b2AABB& box : rectangles) {
+        int col0 = std::lround((box.lowerBound.x - options.x) / options.resolution);
+        int col1 = std::lround((box.upperBound.x - options.x) / options.resolution);
+        int row0 = map.height() - std::lround((box.upperBound.y - options.y) / options.resolution);
+        int row1 = map.height() - std::lround((box.lowerBound.y - options.y) / options.resolution);
+        for (int row = row0; row < row1; ++row) {
+            for (int col = col0; col < col1; ++col) {
+                ++counts[col + row * map.width()];
+            }
+        }
+    }
+    for (unsigned row = 0; row < map.height(); ++row) {
+        for (unsigned col = 0; col < map.width(); ++col) {
+            if (counts[col + row * map.width()] != (map.occupied(col, row) ? 1 : 0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("OccupancyMap rectangles") {
+    // A room: dark walls around a light floor, with a pillar off the center
+    constexpr unsigned W = 40;
+    constexpr unsigned H = 30;
+    std::vector<uint8_t> pixels(W * H, 254);
+    for (unsigned row = 0; row < H; ++row) {
+        for (unsigned col = 0; col < W; ++col) {
+            bool wall = row < 2 || row >= H - 2 || col < 2 || col >= W - 2;
+            bool pillar = row >= 10 && row < 15 && col >= 20 && col < 23;
+            if (wall || pillar) {
+                pixels[col + row * W] = 0;
+            }
+        }
+    }
+
+    just::OccupancyMap::Options options;
+    options.resolution = 0.5;
+    options.x = -10.0;
+    options.y = 5.0;
+    just::OccupancyMap map(W, H, pixels, options);
+    CHECK(map.occupied(0, 0));
+    CHECK_FALSE(map.occupied(10, 10));
+
+    // The top wall, the side walls, what's left of the bottom wall and the pillar
+    auto rectangles = map.rectangles();
+    CHECK(rectangles.size() == 5);
+    CHECK(covers_exactly(map, rectangles));
+
+    // The pillar, with the image's top row at the far side in y
+    auto pillar = std::find_if(rectangles.begin(), rectangles.end(), [](const b2AABB& box) {
+        return box.lowerBound.x > -10.0 + 1.0 && box.upperBound.x < 10.0 - 1.0
+               && box.lowerBound.y > 5.0 + 1.0 && box.upperBound.y < 20.0 - 1.0;
+    });
+    REQUIRE(pillar != rectangles.end());
+    CHECK(pillar->lowerBound.x == doctest::Approx(0.0));
+    CHECK(pillar->upperBound.x == doctest::Approx(1.5));
+    CHECK(pillar->lowerBound.y == doctest::Approx(5.0 + 7.5));
+    CHECK(pillar->upperBound.y == doctest::Approx(5.0 + 10.0));
+
+    // Negated, the floor around the pillar is the obstacle
+    options.negate = true;
+    just::OccupancyMap negated(W, H, pixels, options);
+    CHECK(negated.rectangles().size() == 4);
+
+    // Random noise still covers exactly, in far fewer rectangles than cells
+    std::mt19937 rng(42);
+    std::bernoulli_distribution dark(0.7);
+    for (uint8_t& pixel : pixels) {
+        pixel = dark(rng) ? 0 : 255;
+    }
+    options.negate = false;
+    just::OccupancyMap noise(W, H, pixels, options);
+    rectangles = noise.rectangles();
+    CHECK(covers_exactly(noise, rectangles));
+    CHECK(rectangles.size() < static_cast<size_t>(std::count(pixels.begin(), pixels.end(), 0)) / 2);
+
+    CHECK_THROWS(just::OccupancyMap(W, H + 1, pixels, options));
+    options.resolution = 0.0;
+    CHECK_THROWS(just::OccupancyMap(W, H, pixels, options));
+}
+
+TEST_CASE("OccupancyMap loads PGM images") {
+    auto path = (std::filesystem::temp_directory_path() / "just_occupancy_map_test.pgm").string();
+    just::OccupancyMap::Options options;
+    options.resolution = 1.0;
+
+    // Plain, with a comment and values out of 15
+    {
+        std::ofstream file(path);
+        file << "P2\n# a 3x2 map\n3 2\n15\n0 15 15\n15 8 2\n";
+    }
+    auto map = just::OccupancyMap::load(path, options);
+    REQUIRE(map.width() == 3);
+    REQUIRE(map.height() == 2);
+    CHECK(map.occupied(0, 0));
+    CHECK_FALSE(map.occupied(1, 0));
+    CHECK_FALSE(map.occupied(1, 1));
+    CHECK(map.occupied(2, 1));
+
+    // Binary
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "P5 2 2 255\n";
+        file.put(static_cast<char>(255)).put(0).put(0).put(static_cast<char>(200));
+    }
+    map = just::OccupancyMap::load(path, options);
+    REQUIRE(map.width() == 2);
+    CHECK_FALSE(map.occupied(0, 0));
+    CHECK(map.occupied(1, 0));
+    CHECK(map.occupied(0, 1));
+    CHECK_FALSE(map.occupied(1, 1));
+
+    // Truncated
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "P5 2 2 255\n";
+        file.put(0);
+    }
+    CHECK_THROWS(just::OccupancyMap::load(path, options));
+
+    // Claiming far more pixels than there are, or more than fit in the header's fields
+    for (const char* header : {"P5 100000 100000 255\n", "P2 100000 100000 255\n0 0\n",
+                               "P5 99999999999 1 255\n"}) {
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << header;
+        }
+        CHECK_THROWS(just::OccupancyMap::load(path, options));
+    }
+
+    std::filesystem::remove(path);
+    CHECK_THROWS(just::OccupancyMap::load(path, options));
+}
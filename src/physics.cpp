@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+#include "just/kinematic_world.hpp"
+#include "just/physics.hpp"
+
+namespace just
+{
+
+class Box2DWorld::Body : public PhysicsBody
+{
+public:
+    Body(Box2DWorld* world, b2Body* body, size_t index)
+        : world_(world),
+          body_(body),
+          index_(index)
+    {
+    }
+    ~Body() override
+    {
+        world_->remove_body(index_);
+        body_->GetWorld()->DestroyBody(body_);
+    }
+
+    b2Vec2 position() const override { return body_->GetPosition(); }
+    float angle() const override { return body_->GetAngle(); }
+
+    void set_linear_velocity(b2Vec2 velocity) override { body_->SetLinearVelocity(velocity); }
+    void set_angular_velocity(float omega) override { body_->SetAngularVelocity(omega); }
+
+    // Whether any fixture of the body is touching another fixture
+    bool in_contact() const override
+    {
+        for (const b2ContactEdge* edge = body_->GetContactList(); edge; edge = edge->next) {
+            if (edge->contact->IsTouching()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const b2Body* body() const { return body_; }
+
+private:
+    friend class Box2DWorld;
+
+    Box2DWorld* world_;
+    b2Body* body_;
+    size_t index_;
+};
+
+namespace
+{
+
+// Closest fixture along the ray, other than those of the ignored body
+class ClosestRaycast : public b2RayCastCallback
+{
+public:
+    explicit ClosestRaycast(const b2Body* ignore) : ignore_(ignore) {}
+
+    float ReportFixture(b2Fixture* fixture,
+                        const b2Vec2& point,
+                        const b2Vec2& normal,
+                        float fraction) override
+    {
+        (void)point;
+        (void)normal;
+
+        if (fixture->GetBody() == ignore_) {
+            // Carry on as if the fixture wasn't there
+            return -1.0;
+        }
+        closest = std::min(closest, fraction);
+        // Clip the ray, only closer fixtures are reported from here on
+        return fraction;
+    }
+
+    float closest{2.0};
+
+private:
+    const b2Body* ignore_;
+};
+
+} // namespace
+
+Box2DWorld::Box2DWorld(int velocity_iterations, int position_iterations, float cell_size)
+    : world_({0.0, 0.0}),
+      velocity_iterations_(velocity_iterations),
+      position_iterations_(position_iterations),
+      body_hash_(cell_size)
+{
+}
+
+std::unique_ptr<PhysicsBody> Box2DWorld::create_body(const toml::table& config)
+{
+    b2BodyDef body_def;
+    body_def.type = b2_dynamicBody;
+    body_def.position.Set(config["x"].value_or(0.0), config["y"].value_or(0.0));
+    body_def.angle = config["theta"].value_or(0.0);
+    b2Body* body = world_.CreateBody(&body_def);
+
+    // Bounding circle, for the spatial hash
+    float radius;
+    std::string_view shape_str = config["shape"].value_or("circle");
+    if (shape_str == "circle") {
+        b2CircleShape shape;
+        shape.m_radius = config["radius"].value_or(1.0);
+        radius = shape.m_radius;
+
+        b2FixtureDef fixture_def;
+        fixture_def.shape = &shape;
+        fixture_def.density = config["density"].value_or(1.0);
+        body->CreateFixture(&fixture_def);
+
+    } else if (shape_str == "box") {
+        float width = config["width"].value_or(1.0);
+        float height = config["height"].value_or(1.0);
+        b2PolygonShape shape;
+        shape.SetAsBox(width / 2, height / 2);
+        radius = std::sqrt(width * width + height * height) / 2.0;
+
+        b2FixtureDef fixture_def;
+        fixture_def.shape = &shape;
+        fixture_def.density = config["density"].value_or(1.0);
+        body->CreateFixture(&fixture_def);
+    } else {
+        world_.DestroyBody(body);
+        throw std::runtime_error("Agent constructed with invalid 'shape' field in TOML config");
+    }
+
+    auto wrapper = std::make_unique<Body>(this, body, bodies_.size());
+    bodies_.push_back(wrapper.get());
+    radii_.push_back(radius);
+    bodies_dirty_ = true;
+
+    return wrapper;
+}
+
+void Box2DWorld::remove_body(size_t index)
+{
+    size_t last = bodies_.size() - 1;
+    if (index != last) {
+        bodies_[index] = bodies_[last];
+        bodies_[index]->index_ = index;
+        radii_[index] = radii_[last];
+    }
+    bodies_.pop_back();
+    radii_.pop_back();
+    bodies_dirty_ = true;
+}
+
+void Box2DWorld::rebuild_body_hash()
+{
+    centers_.resize(bodies_.size());
+    boxes_.resize(bodies_.size());
+    for (size_t i = 0; i < bodies_.size(); ++i) {
+        centers_[i] = bodies_[i]->position();
+        b2Vec2 extent{radii_[i], radii_[i]};
+        boxes_[i] = {centers_[i] - extent, centers_[i] + extent};
+    }
+    body_hash_.build(boxes_);
+    bodies_dirty_ = false;
+}
+
+bool Box2DWorld::add_obstacle(const toml::table& config)
+{
+    b2BodyDef body_def;
+    body_def.type = b2_staticBody;
+    body_def.position.Set(config["x"].value_or(0.0), config["y"].value_or(0.0));
+    body_def.angle = config["theta"].value_or(0.0);
+
+    b2FixtureDef fixture_def;
+    fixture_def.density = config["density"].value_or(1.0);
+    std::string_view shape_str = config["shape"].value_or("box");
+    if (shape_str == "circle") {
+        b2CircleShape shape;
+        shape.m_radius = config["radius"].value_or(1.0);
+        fixture_def.shape = &shape;
+        world_.CreateBody(&body_def)->CreateFixture(&fixture_def);
+    } else if (shape_str == "box") {
+        b2PolygonShape shape;
+        float width = config["width"].value_or(1.0) / 2.0;
+        float height = config["height"].value_or(1.0) / 2.0;
+        shape.SetAsBox(width, height);
+        fixture_def.shape = &shape;
+        world_.CreateBody(&body_def)->CreateFixture(&fixture_def);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+size_t Box2DWorld::add_occupancy_map(const OccupancyMap& map)
+{
+    std::vector<b2AABB> rectangles = map.rectangles();
+    if (rectangles.empty()) {
+        return 0;
+    }
+
+    b2BodyDef body_def;
+    body_def.type = b2_staticBody;
+    b2Body* body = world_.CreateBody(&body_def);
+    for (const b2AABB& box : rectangles) {
+        b2Vec2 half_extents = box.GetExtents();
+        b2PolygonShape shape;
+        shape.SetAsBox(half_extents.x, half_extents.y, box.GetCenter(), 0.0);
+
+        b2FixtureDef fixture_def;
+        fixture_def.shape = &shape;
+        body->CreateFixture(&fixture_def);
+    }
+    return rectangles.size();
+}
+
+void Box2DWorld::step(float delta_t)
+{
+    world_.Step(delta_t, velocity_iterations_, position_iterations_);
+    // The bodies moved. The hash is only rebuilt by the first proximity query after this, Box2D's
+    // own raycasts don't need it, so runs without such queries don't pay for it.
+    bodies_dirty_ = true;
+}
+
+std::optional<float> Box2DWorld::raycast(b2Vec2 from, b2Vec2 to, const PhysicsBody* ignore)
+{
+    // NOTE: bodies of this world are always Box2DWorld::Body
+    ClosestRaycast callback(ignore ? static_cast<const Body*>(ignore)->body() : nullptr);
+    world_.RayCast(&callback, from, to);
+
+    if (callback.closest > 1.0) {
+        return std::nullopt;
+    }
+    return callback.closest * (to - from).Length();
+}
+
+void Box2DWorld::bodies_near(b2Vec2 center,
+                             float radius,
+                             const PhysicsBody* ignore,
+                             std::vector<const PhysicsBody*>& bodies)
+{
+    if (bodies_dirty_) {
+        rebuild_body_hash();
+    }
+
+    b2Vec2 extent{radius, radius};
+    body_hash_.query({center - extent, center + extent}, [&](uint32_t i) {
+        float reach = radius + radii_[i];
+        if (bodies_[i] != ignore && (centers_[i] - center).LengthSquared() <= reach * reach) {
+            bodies.push_back(bodies_[i]);
+        }
+    });
+}
+
+std::optional<PhysicsWorld::BodyHit> Box2DWorld::raycast_bodies(b2Vec2 from,
+                                                               b2Vec2 to,
+                                                               const PhysicsBody* ignore)
+{
+    if (bodies_dirty_) {
+        rebuild_body_hash();
+    }
+
+    // The hash narrows it down to the bodies near the ray, their fixtures give the exact hit
+    b2RayCastInput input{from, to, 1.0};
+    const PhysicsBody* closest = nullptr;
+    float fraction = body_hash_.raycast(from, to, [&](uint32_t i) {
+        float hit = 2.0;
+        if (bodies_[i] == ignore) {
+            return hit;
+        }
+        for (const b2Fixture* fixture = bodies_[i]->body_->GetFixtureList(); fixture;
+             fixture = fixture->GetNext()) {
+            b2RayCastOutput output;
+            if (fixture->RayCast(&output, input, 0)) {
+                hit = std::min(hit, output.fraction);
+            }
+        }
+        if (hit < input.maxFraction) {
+            closest = bodies_[i];
+            input.maxFraction = hit;
+        }
+        return hit;
+    });
+
+    if (fraction > 1.0) {
+        return std::nullopt;
+    }
+    return BodyHit{closest, fraction * (to - from).Length()};
+}
+
+std::unique_ptr<PhysicsWorld> make_physics_world(const toml::table& world_config)
+{
+    std::string backend = world_config["backend"].value_or(std::string("box2d"));
+    if (backend == "box2d") {
+        return std::make_unique<Box2DWorld>();
+    } else if (backend == "kinematic") {
+        return std::make_unique<KinematicWorld>(KinematicWorld::options_from_config(world_config));
+    }
+    throw std::runtime_error("Unknown world backend '" + backend + "'");
+}
+
+} // namespace just
+
+TEST_CASE("Box2DWorld bodies and raycasts") {
+    just::Box2DWorld world;
+    REQUIRE(world.add_obstacle(toml::table{{"shape", "circle"}, {"radius", 1.0}, {"x", 5.0}}));
+    CHECK_FALSE(world.add_obstacle(toml::table{{"shape", "triangle"}}));
+    CHECK_THROWS(world.create_body(toml::table{{"shape", "triangle"}}));
+
+    auto body = world.create_body(toml::table{{"shape", "box"},
+                                              {"width", 2.0},
+                                              {"height", 2.0},
+                                              {"theta", M_PI / 2}});
+    CHECK(body->angle() == doctest::Approx(M_PI / 2));
+    b2Vec2 local = body->local_point({0.0, 3.0});
+    CHECK(local.x == doctest::Approx(3.0));
+    CHECK(local.y == doctest::Approx(0.0).epsilon(1e-6));
+    b2Vec2 round_trip = body->world_point(local);
+    CHECK(round_trip.x == doctest::Approx(0.0).epsilon(1e-6));
+    CHECK(round_trip.y == doctest::Approx(3.0));
+
+    // The body casting the ray doesn't see itself
+    auto hit = world.raycast({0.0, 0.0}, {10.0, 0.0}, body.get());
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(4.0));
+    hit = world.raycast({-10.0, 0.0}, {10.0, 0.0}, nullptr);
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(9.0));
+    CHECK_FALSE(world.raycast({0.0, 0.0}, {0.0, 10.0}, body.get()));
+
+    // Driving into the obstacle
+    body->set_linear_velocity({5.0, 0.0});
+    for (int i = 0; i < 100; ++i) {
+        world.step(0.02);
+    }
+    CHECK(body->in_contact());
+    CHECK(body->position().x < 5.0);
+}
+
+TEST_CASE("Box2DWorld proximity queries") {
+    just::Box2DWorld world;
+    REQUIRE(world.add_obstacle(toml::table{{"shape", "circle"}, {"radius", 1.0}, {"x", -5.0}}));
+    auto a = world.create_body(toml::table{{"shape", "circle"}, {"radius", 0.5}});
+    auto b = world.create_body(toml::table{{"shape", "box"}, {"width", 2.0}, {"height", 2.0},
+                                           {"x", 4.0}});
+    auto c = world.create_body(toml::table{{"shape", "circle"}, {"radius", 0.5}, {"y", 20.0}});
+
+    std::vector<const just::PhysicsBody*> near;
+    world.bodies_near({0.0, 0.0}, 3.0, a.get(), near);
+    REQUIRE(near.size() == 1);
+    CHECK(near[0] == b.get());
+    near.clear();
+    world.bodies_near({0.0, 10.0}, 10.0, nullptr, near);
+    CHECK(near.size() == 3);
+
+    // Exact against the box's fixture, the obstacle in the way is ignored
+    auto hit = world.raycast_bodies({-10.0, 0.0}, {10.0, 0.0}, a.get());
+    REQUIRE(hit);
+    CHECK(hit->body == b.get());
+    CHECK(hit->distance == doctest::Approx(13.0));
+    CHECK_FALSE(world.raycast_bodies({-10.0, 10.0}, {10.0, 10.0}, nullptr));
+
+    // Queries follow the bodies as they move and go away with them
+    c->set_linear_velocity({0.0, -10.0});
+    for (int i = 0; i < 50; ++i) {
+        world.step(0.02);
+    }
+    near.clear();
+    world.bodies_near({0.0, 10.0}, 1.0, nullptr, near);
+    REQUIRE(near.size() == 1);
+    CHECK(near[0] == c.get());
+    c.reset();
+    near.clear();
+    world.bodies_near({0.0, 10.0}, 1.0, nullptr, near);
+    CHECK(near.empty());
+}
+
+TEST_CASE("Box2DWorld occupancy maps") {
+    // Two 1 m pillars, 4 m apart, merged with nothing
+    std::vector<uint8_t> pixels{
+        0, 255, 255, 255, 255, 0,
+    };
+    just::OccupancyMap::Options options;
+    options.resolution = 1.0;
+    options.x = -3.0;
+    just::OccupancyMap map(6, 1, pixels, options);
+
+    just::Box2DWorld world;
+    CHECK(world.add_occupancy_map(map) == 2);
+    // A single body for the whole map
+    CHECK(world.b2world().GetBodyCount() == 1);
+
+    auto hit = world.raycast({0.0, 0.5}, {10.0, 0.5}, nullptr);
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(2.0));
+    hit = world.raycast({0.0, 0.5}, {-10.0, 0.5}, nullptr);
+    REQUIRE(hit);
+    CHECK(*hit == doctest::Approx(2.0));
+    CHECK_FALSE(world.raycast({0.0, 0.5}, {0.0, 10.0}, nullptr));
+}
+
+TEST_CASE("make_physics_world") {
+    auto world = just::make_physics_world(toml::table{});
+    CHECK(dynamic_cast<just::Box2DWorld*>(world.get()));
+    world = just::make_physics_world(toml::table{{"backend", "kinematic"}});
+    CHECK(dynamic_cast<just::KinematicWorld*>(world.get()));
+    CHECK_THROWS(just::make_physics_world(toml::table{{"backend", "bullet"}}));
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+#include "doctest/doctest.h"
+
+#include "just/profiling.hpp"
+
+namespace just
+{
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    if (buckets_.empty()) {
+        buckets_.resize(BUCKETS);
+    }
+    ++buckets_[bucket_of(nanoseconds)];
+    ++count_;
+    max_ = std::max(max_, nanoseconds);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+
+    uint64_t target = std::max<uint64_t>(1, std::ceil(std::clamp(p, 0.0, 1.0) * count_));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+        seen += buckets_[bucket];
+        if (seen >= target) {
+            // The max is exact, no need to report more than it
+            return std::min(bucket_upper_bound(bucket), max_);
+        }
+    }
+    return max_;
+}
+
+void LatencyHistogram::reset()
+{
+    std::fill(buckets_.begin(), buckets_.end(), 0);
+    count_ = 0;
+    max_ = 0;
+}
+
+size_t LatencyHistogram::bucket_of(uint64_t nanoseconds)
+{
+    // Values below SUB_BUCKETS get a bucket each, above that the top SUB_BUCKET_BITS + 1 bits
+    // (the leading one and the sub bucket) pick the bucket
+    if (nanoseconds < SUB_BUCKETS) {
+        return nanoseconds;
+    }
+    unsigned magnitude = std::bit_width(nanoseconds) - 1;
+    unsigned shift = magnitude - SUB_BUCKET_BITS;
+    size_t sub_bucket = (nanoseconds >> shift) & (SUB_BUCKETS - 1);
+    return (shift + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t bucket)
+{
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned shift = bucket / SUB_BUCKETS - 1;
+    uint64_t sub_bucket = bucket % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub_bucket) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+StepProfiler::StepProfiler(std::string name, std::initializer_list<const char*> phase_names)
+    : name_(std::move(name)),
+      phase_names_(phase_names)
+{
+    if (phase_names_.size() > MAX_PHASES) {
+        throw std::invalid_argument("StepProfiler supports at most 8 phases");
+    }
+}
+
+void StepProfiler::begin_step()
+{
+    current_.fill(std::chrono::nanoseconds::zero());
+    step_start_ = Clock::now();
+}
+
+void StepProfiler::end_step()
+{
+    step_histogram_.record((Clock::now() - step_start_).count());
+    for (size_t phase = 0; phase < phases(); ++phase) {
+        histograms_[phase].record(current_[phase].count());
+    }
+}
+
+void StepProfiler::add(size_t phase, std::chrono::nanoseconds duration)
+{
+    current_[phase] += duration;
+}
+
+void StepProfiler::report(std::ostream& out) const
+{
+    auto row = [&out](const char* label, const LatencyHistogram& histogram) {
+        out << "  " << std::left << std::setw(20) << label << std::right << std::fixed
+            << std::setprecision(2)
+            << std::setw(12) << histogram.percentile(0.5) / 1000.0
+            << std::setw(12) << histogram.percentile(0.99) / 1000.0
+            << std::setw(12) << histogram.max() / 1000.0 << '\n';
+    };
+
+    out << name_ << " (" << step_histogram_.count() << " steps, microseconds)\n";
+    out << "  " << std::left << std::setw(20) << "phase" << std::right
+        << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "max" << '\n';
+    for (size_t phase = 0; phase < phases(); ++phase) {
+        row(phase_names_[phase], histograms_[phase]);
+    }
+    row("step", step_histogram_);
+}
+
+} // namespace just
+
+TEST_CASE("LatencyHistogram percentiles") {
+    just::LatencyHistogram histogram;
+    CHECK(histogram.percentile(0.5) == 0);
+
+    // Small values are exact
+    for (uint64_t value = 1; value <= 5; ++value) {
+        histogram.record(value);
+    }
+    CHECK(histogram.count() == 5);
+    CHECK(histogram.percentile(0.5) == 3);
+    CHECK(histogram.percentile(1.0) == 5);
+    CHECK(histogram.max() == 5);
+
+    // Large values are within a bucket (12.5%) of the truth
+    histogram.reset();
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.record(value * 1000);
+    }
+    CHECK(histogram.percentile(0.5) >= 500000);
+    CHECK(histogram.percentile(0.5) <= 500000 * 1.125);
+    CHECK(histogram.percentile(0.99) >= 990000);
+    CHECK(histogram.percentile(0.99) <= 1000000);
+    CHECK(histogram.max() == 1000000);
+
+    // The whole range of uint64_t fits
+    histogram.record(UINT64_MAX);
+    CHECK(histogram.max() == UINT64_MAX);
+    CHECK(histogram.percentile(1.0) == UINT64_MAX);
+}
+
+TEST_CASE("StepProfiler sums phases per step") {
+    just::StepProfiler profiler("test", {"a", "b"});
+    REQUIRE(profiler.phases() == 2);
+
+    for (int step = 0; step < 3; ++step) {
+        profiler.begin_step();
+        profiler.add(0, std::chrono::microseconds(10));
+        profiler.add(0, std::chrono::microseconds(10));
+        {
+            just::StepProfiler::Scope scope(profiler, 1);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        profiler.end_step();
+    }
+
+    CHECK(profiler.histogram(0).count() == 3);
+    CHECK(profiler.histogram(0).max() == 20000);
+    CHECK(profiler.histogram(1).max() >= 100000);
+    CHECK(profiler.step_histogram().count() == 3);
+    CHECK(profiler.step_histogram().max() >= profiler.histogram(1).max());
+
+    CHECK_THROWS(just::StepProfiler("too many", {"1", "2", "3", "4", "5", "6", "7", "8", "9"}));
+}
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "raylib.h"
+#include "raymath.h"
+#include "toml++/toml.hpp"
+
+#include "just/log_reader.hpp"
+#include "just/occupancy_map.hpp"
+#include "just/scenario.hpp"
+#include "just/visualization.hpp"
+
+// Replays the logs of a run of the demo, without re-simulating it.
+//
+// Takes the same config as the demo (for the world, the agents' shapes and where their logs are)
+// and an optional initial playback speed. Controls:
+//   space              pause/resume
+//   left/right         step backward/forward one step (while paused)
+//   up/down            double/halve the playback speed
+//   page up/page down  seek forward/backward 1000 steps
+//   home/end           seek to the start/end
+//   tab                cycle which agent's polar histogram is drawn
+//   right mouse drag   pan
+//   mouse wheel        zoom
+
+namespace
+{
+
+struct ReplayAgent
+{
+    std::string name;
+    std::unique_ptr<just::LogReader> log;
+    std::unique_ptr<just::Visualization> viz;
+    float theta;
+};
+
+// Positions of at most this many past steps are drawn as the agent's trail
+constexpr size_t TRAIL_POINTS = 2000;
+
+Vector2 to_screen(float x, float y, float width, float height, float scale)
+{
+    return {width / 2.0f + scale * x, height / 2.0f - scale * y};
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    toml::table config;
+
+    if (argc == 2 || argc == 3) {
+        try {
+            config = toml::parse_file(argv[1]);
+        } catch (const toml::parse_error& err) {
+            std::cerr << "Parsing the TOML config file failed with error: " << err << std::endl;
+            return 2;
+        }
+    } else {
+        std::cerr << "Usage: just_replay <config.toml> [speed]" << std::endl;
+        return 1;
+    }
+    double speed = 1.0;
+    try {
+        if (argc == 3) {
+            speed = std::stod(argv[2]);
+        }
+        if (!(speed > 0.0) || !std::isfinite(speed)) {
+            throw std::invalid_argument("speed must be a positive number");
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid speed '" << argv[2] << "'\n"
+                  << "Usage: just_replay <config.toml> [speed]" << std::endl;
+        return 1;
+    }
+
+    // The same agents and obstacles as the demo generated from the config
+    try {
+        just::expand_scenario(config);
+    } catch (const std::exception& err) {
+        std::cerr << "Error: " << err.what() << std::endl;
+        return 4;
+    }
+
+    int width = config["world"]["width"].value_or(1000);
+    int height = config["world"]["height"].value_or(1000);
+    float scale = config["world"]["scale"].value_or(10.0);
+    int fps = config["world"]["fps"].value_or(100.0);
+
+    // Agents log once per control step, which is what playback at speed 1 follows
+    float physics_rate = config["world"]["physics_rate"].value_or(static_cast<float>(fps));
+    float control_rate = config["world"]["control_rate"].value_or(0.0f);
+    double step_rate = control_rate > 0.0 ? control_rate : physics_rate;
+
+    just::Visualizer visualizer(width, height, scale, fps);
+
+    std::optional<std::string> telemetry_file = config["world"]["telemetry"].value<std::string>();
+
+    std::vector<ReplayAgent> agents;
+    if (toml::array* agent_configs = config["agents"].as_array()) {
+        agent_configs->for_each([&](toml::table agent_config) {
+            if (agent_config["type"].value_or(std::string()) != "vfh"
+                || !agent_config["logging"].value_or(true)) {
+                return;
+            }
+
+            std::string name = agent_config["name"].value_or(std::string());
+            auto viz_ptr = just::viz_factory(agent_config, visualizer);
+            if (!viz_ptr) {
+                std::cout << "Agent visualization options are missing or invalid, "
+                          << "skipping agent: " << name << std::endl;
+                return;
+            }
+
+            try {
+                auto log = telemetry_file
+                    ? std::make_unique<just::LogReader>(*telemetry_file, name)
+                    : std::make_unique<just::LogReader>("/tmp/just/" + name + "/log.h5");
+                if (log->steps() == 0) {
+                    std::cout << "The log of agent " << name << " is empty, skipping it"
+                              << std::endl;
+                    return;
+                }
+                agents.push_back({name,
+                                  std::move(log),
+                                  std::move(viz_ptr),
+                                  agent_config["theta"].value_or(0.0f)});
+            } catch (const std::exception& err) {
+                std::cout << "Unable to read the log of agent " << name << ", skipping it: "
+                          << err.what() << std::endl;
+            }
+        });
+    }
+
+    if (agents.empty()) {
+        std::cerr << "Error: no agent logs to replay" << std::endl;
+        return 3;
+    }
+
+    // Steps are the agents' own, logs skip those an agent didn't log
+    uint64_t last_step = 0;
+    for (const auto& agent : agents) {
+        last_step = std::max(last_step, agent.log->agent_steps().back());
+    }
+
+    if (toml::array* obstacle_configs = config["obstacles"].as_array()) {
+        obstacle_configs->for_each([&](toml::table obstacle_config) {
+            if (auto viz_ptr = just::viz_factory(obstacle_config, visualizer)) {
+                visualizer.add_static_viz(obstacle_config["x"].value_or(0.0f),
+                                          obstacle_config["y"].value_or(0.0f),
+                                          0.0,
+                                          std::move(viz_ptr));
+            }
+        });
+    }
+
+    if (const toml::table* map_config = config["map"].as_table()) {
+        std::string image = (*map_config)["image"].value_or(std::string());
+        try {
+            auto options = just::OccupancyMap::options_from_config(*map_config);
+            auto map = just::OccupancyMap::load(image, options);
+            just::add_map_vizs(map, (*map_config)["color"].value_or("white"), visualizer);
+        } catch (const std::exception& err) {
+            std::cout << "Unable to load the map, not drawing it: " << err.what() << std::endl;
+        }
+    }
+
+    double cursor = 0.0;
+    bool paused = false;
+    size_t selected = 0;
+    while (!WindowShouldClose()) {
+        if (IsKeyPressed(KEY_SPACE)) {
+            paused = !paused;
+        }
+        if (IsKeyPressed(KEY_UP)) {
+            speed *= 2.0;
+        }
+        if (IsKeyPressed(KEY_DOWN)) {
+            speed /= 2.0;
+        }
+        if (IsKeyPressed(KEY_TAB)) {
+            selected = (selected + 1) % agents.size();
+        }
+        if (IsKeyPressed(KEY_HOME)) {
+            cursor = 0.0;
+        }
+        if (IsKeyPressed(KEY_END)) {
+            cursor = last_step;
+        }
+        if (IsKeyPressed(KEY_PAGE_UP)) {
+            cursor += 1000.0;
+        }
+        if (IsKeyPressed(KEY_PAGE_DOWN)) {
+            cursor -= 1000.0;
+        }
+        if (paused) {
+            cursor += IsKeyPressed(KEY_RIGHT) ? 1.0 : 0.0;
+            cursor -= IsKeyPressed(KEY_LEFT) ? 1.0 : 0.0;
+        } else {
+            cursor += GetFrameTime() * step_rate * speed;
+        }
+        cursor = std::clamp(cursor, 0.0, static_cast<double>(last_step));
+        uint64_t step = cursor;
+
+        visualizer.update_camera();
+        visualizer.begin_drawing();
+
+        visualizer.draw_static_layer();
+
+        visualizer.begin_world();
+
+        for (size_t i = 0; i < agents.size(); ++i) {
+            auto& agent = agents[i];
+            const auto& motion = agent.log->motion();
+            // The latest step the agent logged, holding its last position over the gaps
+            size_t logged = agent.log->find(step);
+            const auto& current = motion[logged];
+
+            // Only a bounded number of trail segments, however long the run
+            size_t first = logged > TRAIL_POINTS ? logged - TRAIL_POINTS : 0;
+            Vector2 previous = to_screen(motion[first].x, motion[first].y, width, height, scale);
+            for (size_t s = first + 1; s <= logged; ++s) {
+                Vector2 point = to_screen(motion[s].x, motion[s].y, width, height, scale);
+                DrawLineV(previous, point, DARKGRAY);
+                previous = point;
+            }
+
+            visualizer.draw_viz(current.x, current.y, -agent.theta * RAD2DEG, *agent.viz);
+
+            Vector2 center = to_screen(current.x, current.y, width, height, scale);
+            Vector2 heading = {center.x + scale * current.speed * std::cos(current.angle),
+                               center.y - scale * current.speed * std::sin(current.angle)};
+            DrawLineV(center, heading, YELLOW);
+
+            if (i == selected) {
+                // Polar histogram as spokes around the agent, scaled to its largest sector
+                auto polar_histogram = agent.log->polar_histogram(logged);
+                float max = *std::max_element(polar_histogram.begin(), polar_histogram.end());
+                for (size_t k = 0; k < polar_histogram.size(); ++k) {
+                    float length = max > 0.0 ? 10.0 * scale * polar_histogram[k] / max : 0.0;
+                    float angle = k * just::VFHAgent::ALPHA;
+                    Vector2 tip = {center.x + length * std::cos(angle),
+                                   center.y - length * std::sin(angle)};
+                    DrawLineV(center, tip, Fade(RED, 0.6));
+                }
+            }
+        }
+
+        visualizer.end_world();
+
+        DrawText(TextFormat("%s  step %llu/%llu  speed x%.2f%s",
+                            agents[selected].name.c_str(),
+                            static_cast<unsigned long long>(step),
+                            static_cast<unsigned long long>(last_step),
+                            speed,
+                            paused ? "  (paused)" : ""),
+                 10,
+                 10,
+                 20,
+                 GRAY);
+
+        visualizer.end_drawing();
+    }
+
+    return 0;
+}
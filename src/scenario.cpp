@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+#include "just/agent.hpp"
+#include "just/scenario.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+// Uniform in [0, 1), from the top 24 bits of the engine's output
+float uniform(std::mt19937& rng)
+{
+    return (rng() >> 8) * 0x1p-24f;
+}
+
+float uniform(std::mt19937& rng, float low, float high)
+{
+    return low + (high - low) * uniform(rng);
+}
+
+// Uniform in [0, n)
+uint32_t uniform_index(std::mt19937& rng, uint32_t n)
+{
+    return (static_cast<uint64_t>(rng()) * n) >> 32;
+}
+
+// Fisher-Yates, std::shuffle may shuffle differently from one standard library to the next
+void shuffle(std::vector<uint32_t>& values, std::mt19937& rng)
+{
+    for (uint32_t i = values.size(); i > 1; --i) {
+        std::swap(values[i - 1], values[uniform_index(rng, i)]);
+    }
+}
+
+// Spots are laid out on a square lattice of odd side centered on the origin, indexed row by row.
+// The spot opposite one through the origin is then one too, as is the origin itself.
+b2Vec2 spot_position(uint32_t spot, uint32_t side, float pitch)
+{
+    int half = side / 2;
+    return {(static_cast<int>(spot % side) - half) * pitch,
+            (static_cast<int>(spot / side) - half) * pitch};
+}
+
+} // namespace
+
+ScenarioGenerator::Options ScenarioGenerator::options_from_config(
+    const toml::table& scenario_config)
+{
+    Options options;
+    options.seed = scenario_config["seed"].value_or(options.seed);
+    options.size = scenario_config["size"].value_or(options.size);
+    options.layout = scenario_config["layout"].value_or(options.layout);
+    options.agents = scenario_config["agents"].value_or(options.agents);
+    options.goals = scenario_config["goals"].value_or(options.goals);
+    options.spacing = scenario_config["spacing"].value_or(options.spacing);
+    options.obstacles = scenario_config["obstacles"].value_or(options.obstacles);
+    options.obstacle_density =
+        scenario_config["obstacle_density"].value_or(options.obstacle_density);
+    options.corridor_width = scenario_config["corridor_width"].value_or(options.corridor_width);
+    options.wall_thickness = scenario_config["wall_thickness"].value_or(options.wall_thickness);
+    options.maze_loops = scenario_config["maze_loops"].value_or(options.maze_loops);
+    if (const toml::table* agent = scenario_config["agent"].as_table()) {
+        options.agent = *agent;
+    }
+    return options;
+}
+
+ScenarioGenerator::ScenarioGenerator(Options options) : options_(std::move(options))
+{
+    if (options_.layout != "scatter" && options_.layout != "maze") {
+        throw std::invalid_argument("Unknown scenario layout '" + options_.layout + "'");
+    }
+    if (options_.goals != "opposite" && options_.goals != "center" && options_.goals != "random"
+        && options_.goals != "exchange") {
+        throw std::invalid_argument("Unknown scenario goals '" + options_.goals + "'");
+    }
+    if (options_.spacing <= 0.0 || options_.wall_thickness <= 0.0
+        || options_.corridor_width <= options_.wall_thickness) {
+        throw std::invalid_argument("Scenario spacing and corridors must be wider than the walls");
+    }
+    // Obstacles up to 2 m across would overlap the spots next to them, agents' included
+    if (options_.layout == "scatter" && options_.spacing < 2.0) {
+        throw std::invalid_argument("Scatter scenario spacing must be at least 2 m");
+    }
+}
+
+Scenario ScenarioGenerator::generate() const
+{
+    std::mt19937 rng(options_.seed);
+    Scenario scenario;
+
+    float pitch = options_.layout == "maze" ? options_.corridor_width : options_.spacing;
+    uint32_t side = options_.size / pitch;
+    if (options_.layout == "scatter") {
+        // Spots on the edges of the world too
+        ++side;
+    }
+    if (side % 2 == 0) {
+        --side;
+    }
+    if (side == 0) {
+        throw std::invalid_argument("Scenario world too small");
+    }
+
+    std::vector<uint8_t> reserved;
+    std::vector<uint32_t> order = place_agents(rng, side, pitch, reserved, scenario);
+    if (options_.layout == "scatter") {
+        scatter(rng, side, order, reserved, scenario);
+    } else {
+        maze(rng, side, scenario);
+    }
+    return scenario;
+}
+
+std::vector<uint32_t> ScenarioGenerator::place_agents(std::mt19937& rng,
+                                                      uint32_t side,
+                                                      float pitch,
+                                                      std::vector<uint8_t>& reserved,
+                                                      Scenario& scenario) const
+{
+    uint32_t spots = side * side;
+    std::vector<uint32_t> order(spots);
+    std::iota(order.begin(), order.end(), 0);
+    shuffle(order, rng);
+
+    bool random_goals = options_.goals == "random";
+    if (options_.agents * (random_goals ? 2 : 1) > spots) {
+        throw std::invalid_argument("Scenario world too small for "
+                                    + std::to_string(options_.agents) + " agents");
+    }
+
+    // Every agent starts at a spot of its own, the spots after those are the random goals
+    reserved.assign(spots, false);
+    for (size_t i = 0; i < options_.agents; ++i) {
+        uint32_t start = order[i];
+        uint32_t goal;
+        if (options_.goals == "opposite") {
+            goal = spots - 1 - start;
+        } else if (options_.goals == "center") {
+            goal = spots / 2;
+        } else if (random_goals) {
+            goal = order[options_.agents + i];
+        } else {
+            goal = order[(i + 1) % options_.agents];
+        }
+        reserved[start] = true;
+        reserved[goal] = true;
+        scenario.agents.push_back(
+            {spot_position(start, side, pitch), spot_position(goal, side, pitch)});
+    }
+    return order;
+}
+
+void ScenarioGenerator::scatter(std::mt19937& rng,
+                                uint32_t side,
+                                const std::vector<uint32_t>& order,
+                                const std::vector<uint8_t>& reserved,
+                                Scenario& scenario) const
+{
+    // Obstacles are at most 2 m across, so with spots at least that far apart they never overlap
+    // each other, nor the agents' starts and goals
+    float target_area = options_.obstacle_density * options_.size * options_.size;
+    float area = 0.0;
+    auto done = [&] {
+        return options_.obstacle_density > 0.0 ? area >= target_area
+                                               : scenario.obstacles.size() >= options_.obstacles;
+    };
+
+    for (size_t i = 0; i < order.size() && !done(); ++i) {
+        if (reserved[order[i]]) {
+            continue;
+        }
+        b2Vec2 center = spot_position(order[i], side, options_.spacing);
+        if (scenario.obstacles.size() % 2 == 0) {
+            float radius = uniform(rng, 0.5, 1.0);
+            scenario.obstacles.push_back({center, radius, {0.0, 0.0}});
+            area += M_PI * radius * radius;
+        } else {
+            b2Vec2 size{2.0f * uniform(rng, 0.5, 1.0), 2.0f * uniform(rng, 0.5, 1.0)};
+            scenario.obstacles.push_back({center, 0.0, size});
+            area += size.x * size.y;
+        }
+    }
+
+    if (!done()) {
+        throw std::invalid_argument("Scenario world too small for its obstacles");
+    }
+}
+
+void ScenarioGenerator::maze(std::mt19937& rng, uint32_t side, Scenario& scenario) const
+{
+    // Walls between neighboring cells: the east wall of each cell but those of the last column,
+    // and the north wall of each cell but those of the last row
+    std::vector<uint8_t> east((side - 1) * side, true);
+    std::vector<uint8_t> north(side * (side - 1), true);
+
+    // A randomized depth first search from the center carves a perfect maze
+    std::vector<uint8_t> visited(side * side, false);
+    std::vector<uint32_t> stack{side * side / 2};
+    visited[stack.back()] = true;
+    while (!stack.empty()) {
+        uint32_t cell = stack.back();
+        uint32_t col = cell % side;
+        uint32_t row = cell / side;
+
+        // Neighbors not yet visited, and the wall in between
+        std::pair<uint32_t, uint8_t*> neighbors[4];
+        uint32_t count = 0;
+        if (col + 1 < side && !visited[cell + 1]) {
+            neighbors[count++] = {cell + 1, &east[row * (side - 1) + col]};
+        }
+        if (col > 0 && !visited[cell - 1]) {
+            neighbors[count++] = {cell - 1, &east[row * (side - 1) + col - 1]};
+        }
+        if (row + 1 < side && !visited[cell + side]) {
+            neighbors[count++] = {cell + side, &north[cell]};
+        }
+        if (row > 0 && !visited[cell - side]) {
+            neighbors[count++] = {cell - side, &north[cell - side]};
+        }
+        if (count == 0) {
+            stack.pop_back();
+            continue;
+        }
+
+        auto [next, wall] = neighbors[uniform_index(rng, count)];
+        *wall = false;
+        visited[next] = true;
+        stack.push_back(next);
+    }
+
+    for (auto* walls : {&east, &north}) {
+        for (uint8_t& wall : *walls) {
+            if (wall && uniform(rng) < options_.maze_loops) {
+                wall = false;
+            }
+        }
+    }
+
+    // Each line between cells becomes a box per run of consecutive walls along it, overlapping
+    // the perpendicular walls at its ends to close the corners
+    float pitch = options_.corridor_width;
+    float thickness = options_.wall_thickness;
+    float extent = side * pitch / 2.0f;
+    auto add_runs = [&](uint32_t line, bool vertical, auto&& has_wall) {
+        float offset = -extent + line * pitch;
+        uint32_t begin = 0;
+        while (begin < side) {
+            if (!has_wall(begin)) {
+                ++begin;
+                continue;
+            }
+            uint32_t end = begin + 1;
+            while (end < side && has_wall(end)) {
+                ++end;
+            }
+            float along = -extent + (begin + end) * pitch / 2.0f;
+            float length = (end - begin) * pitch + thickness;
+            if (vertical) {
+                scenario.obstacles.push_back({{offset, along}, 0.0, {thickness, length}});
+            } else {
+                scenario.obstacles.push_back({{along, offset}, 0.0, {length, thickness}});
+            }
+            begin = end;
+        }
+    };
+
+    for (uint32_t line = 0; line <= side; ++line) {
+        bool boundary = line == 0 || line == side;
+        add_runs(line, true, [&](uint32_t row) {
+            return boundary || east[row * (side - 1) + line - 1];
+        });
+        add_runs(line, false, [&](uint32_t col) {
+            return boundary || north[(line - 1) * side + col];
+        });
+    }
+}
+
+toml::table ScenarioGenerator::to_config(const Scenario& scenario) const
+{
+    // What the agents' table doesn't set. The grid covers the world plus the active window
+    // around an agent at its edge.
+    int64_t grid_size = std::ceil(options_.size) + 2 * (VFHAgent::WINDOW_SIZE + 2);
+    toml::table base = options_.agent;
+    base.insert("type", "vfh");
+    base.insert("grid", toml::table{{"width", grid_size}, {"height", grid_size}});
+    base.insert("sensor", toml::table{{"count", 24}, {"range", 25.0}});
+    base.insert("valley_threshold", 1000);
+    base.insert("logging", false);
+    base.insert("speed", 3.0);
+    base.insert("shape", "box");
+    base.insert("width", 2.0);
+    base.insert("height", 2.0);
+    std::string prefix = options_.agent["name"].value_or(std::string());
+
+    toml::array agents;
+    for (size_t i = 0; i < scenario.agents.size(); ++i) {
+        const Scenario::Agent& agent = scenario.agents[i];
+        b2Vec2 heading = agent.goal - agent.start;
+        toml::table agent_config = base;
+        agent_config.insert_or_assign(
+            "name", prefix.empty() ? std::to_string(i + 1) : prefix + "_" + std::to_string(i + 1));
+        agent_config.insert_or_assign("goal",
+                                      toml::table{{"x", agent.goal.x}, {"y", agent.goal.y}});
+        agent_config.insert_or_assign("x", agent.start.x);
+        agent_config.insert_or_assign("y", agent.start.y);
+        agent_config.insert_or_assign("theta", std::atan2(heading.y, heading.x));
+        agents.push_back(std::move(agent_config));
+    }
+
+    toml::array obstacles;
+    for (const Scenario::Obstacle& obstacle : scenario.obstacles) {
+        if (obstacle.radius > 0.0) {
+            obstacles.push_back(toml::table{{"color", "white"},
+                                            {"shape", "circle"},
+                                            {"radius", obstacle.radius},
+                                            {"x", obstacle.center.x},
+                                            {"y", obstacle.center.y}});
+        } else {
+            obstacles.push_back(toml::table{{"color", "white"},
+                                            {"shape", "box"},
+                                            {"width", obstacle.size.x},
+                                            {"height", obstacle.size.y},
+                                            {"x", obstacle.center.x},
+                                            {"y", obstacle.center.y}});
+        }
+    }
+
+    return toml::table{{"agents", std::move(agents)}, {"obstacles", std::move(obstacles)}};
+}
+
+void expand_scenario(toml::table& config)
+{
+    const toml::table* scenario_config = config["scenario"].as_table();
+    if (!scenario_config) {
+        return;
+    }
+
+    ScenarioGenerator generator(ScenarioGenerator::options_from_config(*scenario_config));
+    toml::table generated = generator.to_config(generator.generate());
+    for (const char* key : {"agents", "obstacles"}) {
+        toml::array* generated_array = generated[key].as_array();
+        if (toml::array* array = config[key].as_array()) {
+            for (toml::node& node : *generated_array) {
+                array->push_back(std::move(*node.as_table()));
+            }
+        } else {
+            config.insert_or_assign(key, std::move(*generated_array));
+        }
+    }
+    config.erase("scenario");
+}
+
+} // namespace just
+
+namespace
+{
+
+bool inside(const just::Scenario::Obstacle& obstacle, b2Vec2 point)
+{
+    b2Vec2 offset = point - obstacle.center;
+    if (obstacle.radius > 0.0) {
+        return offset.Length() < obstacle.radius;
+    }
+    return std::abs(offset.x) < obstacle.size.x / 2.0 && std::abs(offset.y) < obstacle.size.y / 2.0;
+}
+
+bool blocked(const just::Scenario& scenario, b2Vec2 point)
+{
+    return std::any_of(scenario.obstacles.begin(),
+                       scenario.obstacles.end(),
+                       [point](const just::Scenario::Obstacle& obstacle) {
+                           return inside(obstacle, point);
+                       });
+}
+
+bool same_scenario(const just::Scenario& a, const just::Scenario& b)
+{
+    auto same = [](b2Vec2 p, b2Vec2 q) { return p.x == q.x && p.y == q.y; };
+    return a.agents.size() == b.agents.size() && a.obstacles.size() == b.obstacles.size()
+           && std::equal(a.agents.begin(), a.agents.end(), b.agents.begin(),
+                         [&](const auto& p, const auto& q) {
+                             return same(p.start, q.start) && same(p.goal, q.goal);
+                         })
+           && std::equal(a.obstacles.begin(), a.obstacles.end(), b.obstacles.begin(),
+                         [&](const auto& p, const auto& q) {
+                             return same(p.center, q.center) && p.radius == q.radius
+                                    && same(p.size, q.size);
+                         });
+}
+
+} // namespace
+
+TEST_CASE("ScenarioGenerator scatter") {
+    just::ScenarioGenerator::Options options;
+    options.size = 100.0;
+    options.agents = 200;
+    options.obstacle_density = 0.1;
+    auto scenario = just::ScenarioGenerator(options).generate();
+
+    REQUIRE(scenario.agents.size() == 200);
+    float area = 0.0;
+    for (const auto& obstacle : scenario.obstacles) {
+        area += obstacle.radius > 0.0 ? M_PI * obstacle.radius * obstacle.radius
+                                      : obstacle.size.x * obstacle.size.y;
+    }
+    CHECK(area >= 0.1 * 100.0 * 100.0);
+    CHECK(area < 0.1 * 100.0 * 100.0 + 4.0);
+
+    // Starts are distinct and, as are goals, clear of obstacles
+    for (size_t i = 0; i < scenario.agents.size(); ++i) {
+        const auto& agent = scenario.agents[i];
+        CHECK(agent.goal.x == -agent.start.x);
+        CHECK(agent.goal.y == -agent.start.y);
+        CHECK_FALSE(blocked(scenario, agent.start));
+        CHECK_FALSE(blocked(scenario, agent.goal));
+        for (size_t j = 0; j < i; ++j) {
+            CHECK((scenario.agents[j].start - agent.start).Length() >= options.spacing);
+        }
+    }
+
+    // Reproducible from the seed alone
+    CHECK(same_scenario(scenario, just::ScenarioGenerator(options).generate()));
+    options.seed = 7;
+    CHECK_FALSE(same_scenario(scenario, just::ScenarioGenerator(options).generate()));
+
+    // A given number of obstacles instead, and more than fit
+    options.obstacle_density = 0.0;
+    options.obstacles = 100;
+    CHECK(just::ScenarioGenerator(options).generate().obstacles.size() == 100);
+    options.obstacles = 2000;
+    CHECK_THROWS(just::ScenarioGenerator(options).generate());
+
+    options.spacing = 1.5;
+    CHECK_THROWS(just::ScenarioGenerator{options});
+    options.spacing = 3.0;
+    options.layout = "forest";
+    CHECK_THROWS(just::ScenarioGenerator{options});
+}
+
+TEST_CASE("ScenarioGenerator maze") {
+    just::ScenarioGenerator::Options options;
+    options.layout = "maze";
+    options.size = 100.0;
+    options.corridor_width = 5.0;
+    options.agents = 50;
+    options.goals = "exchange";
+    auto scenario = just::ScenarioGenerator(options).generate();
+
+    // 19 x 19 cells, centered on the origin
+    constexpr int SIDE = 19;
+    REQUIRE(scenario.agents.size() == 50);
+    for (size_t i = 0; i < scenario.agents.size(); ++i) {
+        const auto& agent = scenario.agents[i];
+        CHECK(agent.goal.x == scenario.agents[(i + 1) % 50].start.x);
+        CHECK(agent.goal.y == scenario.agents[(i + 1) % 50].start.y);
+        CHECK_FALSE(blocked(scenario, agent.start));
+    }
+    // Far fewer boxes than the 2 * 19 * 20 cell sides, as runs of walls are merged
+    CHECK(scenario.obstacles.size() < SIDE * SIDE);
+
+    // Every cell can be reached from the center, through the middle of the sides between cells
+    // that aren't walled off, and the maze is closed all around
+    auto center = [](int col, int row) {
+        return b2Vec2{(col - SIDE / 2) * 5.0f, (row - SIDE / 2) * 5.0f};
+    };
+    std::vector<uint8_t> reached(SIDE * SIDE, false);
+    std::vector<std::pair<int, int>> queue{{SIDE / 2, SIDE / 2}};
+    reached[SIDE * SIDE / 2] = true;
+    size_t open_sides = 0;
+    while (!queue.empty()) {
+        auto [col, row] = queue.back();
+        queue.pop_back();
+        CHECK_FALSE(blocked(scenario, center(col, row)));
+        for (auto [dc, dr] :
+             {std::pair{1, 0}, std::pair{-1, 0}, std::pair{0, 1}, std::pair{0, -1}}) {
+            b2Vec2 side = 0.5f * (center(col, row) + center(col + dc, row + dr));
+            if (blocked(scenario, side)) {
+                continue;
+            }
+            ++open_sides;
+            int c = col + dc;
+            int r = row + dr;
+            REQUIRE((c >= 0 && c < SIDE && r >= 0 && r < SIDE));
+            if (!reached[c + r * SIDE]) {
+                reached[c + r * SIDE] = true;
+                queue.push_back({c, r});
+            }
+        }
+    }
+    CHECK(std::count(reached.begin(), reached.end(), true) == SIDE * SIDE);
+    // Some loops, on top of the SIDE * SIDE - 1 passages (each counted from both ends) of a
+    // perfect maze
+    CHECK(open_sides / 2 > static_cast<size_t>(SIDE * SIDE - 1));
+
+    options.agents = SIDE * SIDE + 1;
+    CHECK_THROWS(just::ScenarioGenerator(options).generate());
+}
+
+TEST_CASE("expand_scenario") {
+    toml::table config{
+        {"scenario", toml::table{{"agents", 5},
+                                 {"size", 50.0},
+                                 {"obstacles", 10},
+                                 {"agent", toml::table{{"name", "bot"}, {"speed", 5.0}}}}},
+        {"obstacles", toml::array{toml::table{{"shape", "circle"}, {"radius", 5.0}}}},
+    };
+    just::expand_scenario(config);
+
+    CHECK_FALSE(config.contains("scenario"));
+    REQUIRE(config["agents"].as_array());
+    CHECK(config["agents"].as_array()->size() == 5);
+    // Appended to the config's own
+    CHECK(config["obstacles"].as_array()->size() == 11);
+    CHECK(config["obstacles"][0]["radius"].value_or(0.0) == 5.0);
+
+    // The agents' fields on top of the defaults
+    auto agent = config["agents"][4];
+    CHECK(agent["name"].value_or(std::string()) == "bot_5");
+    CHECK(agent["speed"].value_or(0.0) == 5.0);
+    CHECK(agent["type"].value_or(std::string()) == "vfh");
+    CHECK(agent["grid"]["width"].value_or(size_t{0}) >= 50 + 2 * just::VFHAgent::WINDOW_SIZE);
+
+    // Nothing left to expand
+    just::expand_scenario(config);
+    CHECK(config["agents"].as_array()->size() == 5);
+}
@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "toml++/toml.hpp"
+
+#include "just/scenario.hpp"
+
+// Writes out a config with the world of its [scenario] table generated, as TOML on stdout.
+//
+// The written config holds the generated agents and obstacles in place of the [scenario] table, so
+// it can be inspected and edited. The demo takes the original config as well, generating the same
+// world in memory. The options below override those of the [scenario] table, e.g. to generate a
+// series of worlds from one config.
+//
+// Usage: just_scenario_gen <config.toml> [--seed 42] [--agents 100] [--size 200]
+//                          [--layout scatter|maze] [--goals opposite|center|random|exchange]
+
+int main(int argc, char** argv)
+{
+    toml::table config;
+    try {
+        if (argc < 2) {
+            throw std::invalid_argument("Missing config");
+        }
+        config = toml::parse_file(argv[1]);
+        toml::table* scenario = config["scenario"].as_table();
+        if (!scenario) {
+            throw std::invalid_argument("The config has no [scenario] table");
+        }
+
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 == argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--seed") {
+                scenario->insert_or_assign("seed", static_cast<int64_t>(std::stoul(value)));
+            } else if (arg == "--agents") {
+                scenario->insert_or_assign("agents", static_cast<int64_t>(std::stoul(value)));
+            } else if (arg == "--size") {
+                scenario->insert_or_assign("size", std::stod(value));
+            } else if (arg == "--layout") {
+                scenario->insert_or_assign("layout", value);
+            } else if (arg == "--goals") {
+                scenario->insert_or_assign("goals", value);
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+
+        just::expand_scenario(config);
+    } catch (const toml::parse_error& err) {
+        std::cerr << "Parsing the TOML config file failed with error: " << err << std::endl;
+        return 2;
+    } catch (const std::exception& err) {
+        std::cerr << "Error: " << err.what() << "\n"
+                  << "Usage: just_scenario_gen <config.toml> [--seed 42] [--agents 100] "
+                  << "[--size 200] [--layout scatter|maze] "
+                  << "[--goals opposite|center|random|exchange]" << std::endl;
+        return 1;
+    }
+
+    std::cout << config << std::endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+
+#include "doctest/doctest.h"
+
+#include "just/scheduler.hpp"
+
+namespace just
+{
+
+namespace
+{
+// Slack when comparing (accumulated) simulated times, so that rates which divide the physics rate
+// evenly don't miss a tick due to rounding
+constexpr double TIME_EPSILON = 1e-9;
+}
+
+Scheduler::Scheduler(float physics_rate, Task physics_step, unsigned max_substeps)
+    : physics_dt_(1.0 / physics_rate),
+      max_substeps_(max_substeps),
+      physics_step_(std::move(physics_step))
+{
+}
+
+void Scheduler::add_task(float rate_hz, Task task)
+{
+    double period = rate_hz > 0.0 ? 1.0 / rate_hz : 0.0;
+    tasks_.push_back({period, time_, time_ - period, std::move(task)});
+}
+
+void Scheduler::advance(float frame_time)
+{
+    accumulator_ += std::max(frame_time, 0.0f);
+
+    unsigned substeps = 0;
+    while (accumulator_ + TIME_EPSILON >= physics_dt_ && substeps < max_substeps_) {
+        tick();
+        accumulator_ -= physics_dt_;
+        ++substeps;
+    }
+
+    // Drop whatever couldn't be simulated this frame
+    if (substeps == max_substeps_) {
+        accumulator_ = std::min(accumulator_, static_cast<double>(physics_dt_));
+    }
+    accumulator_ = std::max(accumulator_, 0.0);
+}
+
+void Scheduler::tick()
+{
+    // Control tasks act on the current state, then physics integrates their commands
+    for (auto& scheduled : tasks_) {
+        if (time_ + TIME_EPSILON < scheduled.next_time) {
+            continue;
+        }
+
+        float delta_t = scheduled.period > 0.0 ? time_ - scheduled.last_time : physics_dt_;
+        scheduled.task(delta_t);
+        scheduled.last_time = time_;
+
+        // Keep a fixed cadence, unless we've fallen more than a period behind
+        scheduled.next_time += scheduled.period;
+        if (scheduled.next_time + TIME_EPSILON < time_) {
+            scheduled.next_time = time_ + scheduled.period;
+        }
+    }
+
+    physics_step_(physics_dt_);
+    ++physics_steps_;
+    time_ = physics_steps_ * static_cast<double>(physics_dt_);
+}
+
+} // namespace just
+
+TEST_CASE("Scheduler physics steps") {
+    int steps = 0;
+    just::Scheduler scheduler(100.0, [&steps](float dt) {
+        CHECK(dt == doctest::Approx(0.01));
+        ++steps;
+    });
+
+    SUBCASE("Fixed timestep independent of frame time") {
+        scheduler.advance(0.005);
+        CHECK(steps == 0);
+        scheduler.advance(0.005);
+        CHECK(steps == 1);
+        scheduler.advance(0.035);
+        CHECK(steps == 4);
+        CHECK(scheduler.alpha() == doctest::Approx(0.5));
+        CHECK(scheduler.time() == doctest::Approx(0.04));
+    }
+
+    SUBCASE("Substeps are capped") {
+        scheduler.advance(1.0);
+        CHECK(steps == 10);
+        scheduler.advance(0.0);
+        CHECK(steps == 11);
+        scheduler.advance(0.0);
+        CHECK(steps == 11);
+    }
+}
+
+TEST_CASE("Scheduler task rates") {
+    just::Scheduler scheduler(100.0, [](float) {}, 1000);
+
+    int every_step = 0;
+    int ten_hz = 0;
+    int thirty_hz = 0;
+    float ten_hz_dt = 0.0;
+    scheduler.add_task(0.0, [&every_step](float) { ++every_step; });
+    scheduler.add_task(10.0, [&ten_hz, &ten_hz_dt](float dt) {
+        ++ten_hz;
+        ten_hz_dt = dt;
+    });
+    scheduler.add_task(30.0, [&thirty_hz](float) { ++thirty_hz; });
+
+    // One second of simulated time, in uneven frames
+    for (int i = 0; i < 40; ++i) {
+        scheduler.advance(i % 2 ? 0.03 : 0.02);
+    }
+
+    CHECK(scheduler.physics_steps() == 100);
+    CHECK(every_step == 100);
+    CHECK(ten_hz == 10);
+    CHECK(ten_hz_dt == doctest::Approx(0.1));
+    // 30 Hz doesn't divide 100 Hz evenly, tasks run on the first physics step at/after each period
+    CHECK(thirty_hz == 30);
+}
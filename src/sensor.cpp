@@ -1,6 +1,7 @@
 #include <cmath>
 #include <algorithm>
 #include <memory>
+#include <optional>
 
 #include "doctest/doctest.h"
 
@@ -9,8 +10,12 @@
 namespace just
 {
 
-UltrasonicArray::UltrasonicArray(unsigned sensor_cnt, float max_range, b2Body* body)
+UltrasonicArray::UltrasonicArray(unsigned sensor_cnt,
+                                 float max_range,
+                                 PhysicsWorld* world,
+                                 const PhysicsBody* body)
 {
+    world_ = world;
     body_ = body;
 
     beams_.resize(sensor_cnt);
@@ -31,66 +36,39 @@ UltrasonicArray::SensorReading UltrasonicArray::sense_one()
     const Beam& beam = beams_.at(active_beam_idx_);
     active_beam_idx_ = (active_beam_idx_ + 1) % beams_.size();
 
-    b2Vec2 world_endpoint = body_->GetWorldPoint(beam.local_endpoint);
-    RaycastCb cb(body_);
-    b2World* world = body_->GetWorld();
+    b2Vec2 world_endpoint = body_->world_point(beam.local_endpoint);
+    std::optional<float> distance = world_->raycast(body_->position(), world_endpoint, body_);
 
-    world->RayCast(&cb, body_->GetPosition(), world_endpoint);
-
-    reading.distance = cb.min_distance <= max_range() ? cb.min_distance : -1.0;
-    reading.angle = beam.relative_angle + body_->GetAngle();
+    reading.distance = distance ? *distance : -1.0;
+    reading.angle = beam.relative_angle + body_->angle();
 
     return reading;
 }
 
 std::vector<UltrasonicArray::SensorReading> UltrasonicArray::sense_all()
 {
-    std::vector<SensorReading> readings;
-    readings.resize(beams_.size());
-    for (unsigned i = 0; i < beams_.size(); ++i) {
-        readings.at(i) = sense_one();
-    }
-    return readings;
+    return sense_some(beams_.size());
 }
 
-float UltrasonicArray::RaycastCb::ReportFixture(b2Fixture* fixture,
-                                          const b2Vec2& world_point,
-                                          const b2Vec2& normal,
-                                          float fraction)
+std::vector<UltrasonicArray::SensorReading> UltrasonicArray::sense_some(size_t count)
 {
-    (void)normal;
-    (void)fraction;
-
-    if (fixture->GetBody() != body_) {
-        b2Vec2 local_point = body_->GetLocalPoint(world_point);
-        min_distance = std::min(min_distance, local_point.Length());
+    std::vector<SensorReading> readings;
+    readings.resize(std::min(count, beams_.size()));
+    for (unsigned i = 0; i < readings.size(); ++i) {
+        readings.at(i) = sense_one();
     }
-
-    return 1.0;
+    return readings;
 }
 
 } // namespace just
 
 TEST_CASE("UltrasonicArray sensor tests") {
     // Set up the world
-    auto world = std::make_unique<b2World>(b2Vec2{0.0, 0.0});
-    b2BodyDef dummy_body_def;
-    dummy_body_def.type = b2_staticBody;
-    dummy_body_def.position.Set(0.0, 0.0);
-    dummy_body_def.angle = 0.0;
-
-    b2Body* dummy_body = world->CreateBody(&dummy_body_def);
-    b2CircleShape dummy_shape;
-    dummy_shape.m_p.Set(0.0, 0.0);
-    dummy_shape.m_radius = 0.1;
-
-    b2FixtureDef dummy_fixture_def;
-    dummy_fixture_def.shape = &dummy_shape;
-    dummy_fixture_def.density = 1.0;
-    dummy_body->CreateFixture(&dummy_fixture_def);
+    just::Box2DWorld world;
+    auto dummy_body = world.create_body(toml::table{{"shape", "circle"}, {"radius", 0.1}});
 
     SUBCASE("Single sensor") {
-        just::UltrasonicArray sensor(1, 5.0, dummy_body);
+        just::UltrasonicArray sensor(1, 5.0, &world, dummy_body.get());
 
         auto reading = sensor.sense_one();
         REQUIRE(reading.angle == 0.0);
@@ -107,7 +85,7 @@ TEST_CASE("UltrasonicArray sensor tests") {
     }
 
     SUBCASE("Multiple sensors") {
-        just::UltrasonicArray sensor(10, 1.0, dummy_body);
+        just::UltrasonicArray sensor(10, 1.0, &world, dummy_body.get());
 
         just::UltrasonicArray::SensorReading reading;
         for (int i = 0; i < 10; ++i) {
@@ -122,44 +100,29 @@ TEST_CASE("UltrasonicArray sensor tests") {
             REQUIRE(reading_vec.at(i).angle == doctest::Approx(i * 2.0 * M_PI / 10.0));
             REQUIRE(reading_vec.at(i).distance == -1.0);
         }
+
+        // Partial sweeps continue where the last one stopped
+        reading_vec = sensor.sense_some(4);
+        REQUIRE(reading_vec.size() == 4);
+        reading_vec = sensor.sense_some(8);
+        REQUIRE(reading_vec.size() == 8);
+        for (int i = 0; i < 8; ++i) {
+            float angle = ((i + 4) % 10) * 2.0 * M_PI / 10.0;
+            REQUIRE(reading_vec.at(i).angle == doctest::Approx(angle));
+        }
+        REQUIRE(sensor.sense_some(20).size() == 10);
     }
 
     // Create actual obstacles to sense
-    // Common stuff
-    b2CircleShape obstacle_shape;
-    obstacle_shape.m_p.Set(0.0, 0.0);
-    obstacle_shape.m_radius = 1.0;
-
-    b2FixtureDef obstacle_fixture_def;
-    obstacle_fixture_def.shape = &obstacle_shape;
-    obstacle_fixture_def.density = 1.0;
-
     // Obstacle #1 -- should be detected at (1,0)
-    b2BodyDef obstacle1_body_def;
-    obstacle1_body_def.type = b2_staticBody;
-    obstacle1_body_def.position.Set(2.0, 0.0);
-    obstacle1_body_def.angle = 0.0;
-    b2Body* obstacle1_body = world->CreateBody(&obstacle1_body_def);
-    obstacle1_body->CreateFixture(&obstacle_fixture_def);
-
+    world.add_obstacle(toml::table{{"shape", "circle"}, {"radius", 1.0}, {"x", 2.0}});
     // Obstacle #2 -- should be detected at (0,5)
-    b2BodyDef obstacle2_body_def;
-    obstacle2_body_def.type = b2_staticBody;
-    obstacle2_body_def.position.Set(0.0, 6.0);
-    obstacle2_body_def.angle = 0.0;
-    b2Body* obstacle2_body = world->CreateBody(&obstacle2_body_def);
-    obstacle2_body->CreateFixture(&obstacle_fixture_def);
-
+    world.add_obstacle(toml::table{{"shape", "circle"}, {"radius", 1.0}, {"y", 6.0}});
     // Obstacle #3 -- should NOT be detected (outside of the intended max range of 10)
-    b2BodyDef obstacle3_body_def;
-    obstacle3_body_def.type = b2_staticBody;
-    obstacle3_body_def.position.Set(-11.001, 0.0);
-    obstacle3_body_def.angle = 0.0;
-    b2Body* obstacle3_body = world->CreateBody(&obstacle3_body_def);
-    obstacle3_body->CreateFixture(&obstacle_fixture_def);
+    world.add_obstacle(toml::table{{"shape", "circle"}, {"radius", 1.0}, {"x", -11.001}});
 
     SUBCASE("Test raycasts") {
-        just::UltrasonicArray sensor(4, 10.0, dummy_body);
+        just::UltrasonicArray sensor(4, 10.0, &world, dummy_body.get());
 
         auto reading = sensor.sense_one();
         REQUIRE(reading.angle == 0.0);
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#include "doctest/doctest.h"
+
+#include "just/telemetry.hpp"
+#include "just/trace.hpp"
+
+namespace just
+{
+
+std::mutex& Telemetry::hdf5_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+Telemetry::Telemetry(const std::string& filename)
+    : filename_(filename)
+{
+    std::filesystem::path path(filename);
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path());
+    }
+
+    {
+        std::lock_guard lock(hdf5_mutex());
+        unsigned file_opts = HighFive::File::OpenOrCreate | HighFive::File::Truncate;
+        file_ = std::make_unique<HighFive::File>(filename, file_opts);
+    }
+
+    writer_ = std::thread(&Telemetry::writer_loop, this);
+}
+
+Telemetry::~Telemetry()
+{
+    running_.store(false, std::memory_order_release);
+    writer_.join();
+
+    std::lock_guard lock(hdf5_mutex());
+    file_.reset();
+}
+
+void Telemetry::add_channel(Channel* channel, const std::function<void(HighFive::File&)>& setup)
+{
+    std::lock_guard channels_lock(channels_mutex_);
+    {
+        std::lock_guard lock(hdf5_mutex());
+        setup(*file_);
+    }
+    channels_.push_back(channel);
+}
+
+void Telemetry::remove_channel(Channel* channel)
+{
+    // Holding the channel lock keeps the writer away, so the channel can be flushed from here
+    std::lock_guard channels_lock(channels_mutex_);
+    auto it = std::find(channels_.begin(), channels_.end(), channel);
+    if (it == channels_.end()) {
+        return;
+    }
+
+    flush(channel);
+    channels_.erase(it);
+}
+
+void Telemetry::writer_loop()
+{
+    JUST_TRACE_THREAD_NAME("telemetry writer");
+
+    while (true) {
+        // Once stopped, all producers are done, whatever is queued is final
+        bool stopping = !running_.load(std::memory_order_acquire);
+
+        bool busy = false;
+        {
+            std::lock_guard channels_lock(channels_mutex_);
+
+            for (Channel* channel : channels_) {
+                busy |= channel->drain();
+            }
+
+            if (stopping) {
+                for (Channel* channel : channels_) {
+                    flush(channel);
+                }
+            } else if (std::any_of(channels_.begin(), channels_.end(),
+                                   [](const Channel* channel) { return channel->ready(); })) {
+                // Write every ready channel under a single acquisition of the lock
+                std::lock_guard lock(hdf5_mutex());
+                for (Channel* channel : channels_) {
+                    if (channel->ready()) {
+                        channel->write();
+                    }
+                }
+                JUST_TRACE_SCOPE("telemetry_flush");
+                file_->flush();
+            }
+        }
+
+        if (stopping) {
+            break;
+        }
+        if (!busy) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void Telemetry::flush(Channel* channel)
+{
+    // A batch holds at most one block, so keep going until the channel has nothing left
+    do {
+        std::lock_guard lock(hdf5_mutex());
+        channel->write();
+    } while (channel->drain());
+}
+
+} // namespace just
+
+namespace
+{
+
+class CountingChannel : public just::Telemetry::Channel
+{
+public:
+    std::atomic<int> queued{0};
+    int batched{0};
+    int written{0};
+
+    bool drain() override
+    {
+        int count = queued.exchange(0);
+        batched += count;
+        return count > 0;
+    }
+
+    bool ready() const override { return batched >= 10; }
+
+    void write() override
+    {
+        written += batched;
+        batched = 0;
+    }
+};
+
+} // namespace
+
+TEST_CASE("Telemetry channels") {
+    auto filename = std::filesystem::temp_directory_path() / "just_telemetry_test.h5";
+    just::Telemetry telemetry(filename.string());
+
+    CountingChannel a;
+    CountingChannel b;
+    bool setup_called = false;
+    telemetry.add_channel(&a, [&setup_called](HighFive::File& file) {
+        file.createGroup("a");
+        setup_called = true;
+    });
+    telemetry.add_channel(&b, [](HighFive::File& file) { file.createGroup("b"); });
+    REQUIRE(setup_called);
+
+    // Removing a channel flushes everything it has queued, whether or not a block was full
+    a.queued += 25;
+    b.queued += 3;
+    telemetry.remove_channel(&a);
+    telemetry.remove_channel(&b);
+    CHECK(a.written == 25);
+    CHECK(b.written == 3);
+
+    // Removing twice is harmless
+    telemetry.remove_channel(&a);
+}
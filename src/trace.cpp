@@ -0,0 +1,216 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "doctest/doctest.h"
+
+#include "just/trace.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+std::atomic<uint64_t> next_tracer_id{0};
+
+// Thread names are the only free form strings in a trace
+std::string escape_json(const std::string& str)
+{
+    std::string escaped;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+Tracer::Tracer(size_t events_per_thread)
+    : id_(next_tracer_id.fetch_add(1, std::memory_order_relaxed)),
+      events_per_thread_(events_per_thread),
+      epoch_(Clock::now())
+{
+}
+
+Tracer& Tracer::global()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::ThreadBuffer& Tracer::local_buffer()
+{
+    // This thread's buffer in each tracer it has recorded to, almost always just the global one.
+    // Tracers are told apart by id rather than address, a new tracer may reuse an old one's.
+    thread_local std::vector<std::pair<uint64_t, ThreadBuffer*>> cache;
+
+    for (const auto& [tracer_id, buffer] : cache) {
+        if (tracer_id == id_) {
+            return *buffer;
+        }
+    }
+
+    std::lock_guard lock(mutex_);
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->tid = buffers_.size() + 1;
+    buffer->name = "thread " + std::to_string(buffer->tid);
+    buffer->events = std::make_unique<Event[]>(events_per_thread_);
+    cache.emplace_back(id_, buffer.get());
+    buffers_.push_back(std::move(buffer));
+    return *buffers_.back();
+}
+
+void Tracer::record(const char* name, Clock::time_point start, Clock::time_point end)
+{
+    ThreadBuffer& buffer = local_buffer();
+
+    size_t size = buffer.size.load(std::memory_order_relaxed);
+    if (size == events_per_thread_) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer.events[size] = {name,
+                           std::chrono::nanoseconds(start - epoch_).count(),
+                           std::chrono::nanoseconds(end - start).count()};
+    // Publishes the event to write_json()
+    buffer.size.store(size + 1, std::memory_order_release);
+}
+
+void Tracer::set_thread_name(const std::string& name)
+{
+    ThreadBuffer& buffer = local_buffer();
+    std::lock_guard lock(mutex_);
+    buffer.name = name;
+}
+
+size_t Tracer::size() const
+{
+    std::lock_guard lock(mutex_);
+    size_t total = 0;
+    for (const auto& buffer : buffers_) {
+        total += buffer->size.load(std::memory_order_acquire);
+    }
+    return total;
+}
+
+size_t Tracer::dropped() const
+{
+    std::lock_guard lock(mutex_);
+    size_t total = 0;
+    for (const auto& buffer : buffers_) {
+        total += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Tracer::write_json(std::ostream& out) const
+{
+    std::lock_guard lock(mutex_);
+
+    size_t dropped = 0;
+    bool first = true;
+    auto separator = [&first, &out] {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    // Timestamps and durations are in (fractional) microseconds
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (const auto& buffer : buffers_) {
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << escape_json(buffer->name) << "\"}}";
+
+        size_t size = buffer->size.load(std::memory_order_acquire);
+        for (size_t i = 0; i < size; ++i) {
+            const Event& event = buffer->events[i];
+            separator();
+            out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << buffer->tid << ",\"ts\":" << event.start_ns / 1000 << '.'
+                << event.start_ns % 1000 / 100 << ",\"dur\":" << event.duration_ns / 1000 << '.'
+                << event.duration_ns % 1000 / 100 << '}';
+        }
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    out << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+}
+
+bool Tracer::write_json(const std::string& filename) const
+{
+    std::filesystem::path path(filename);
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path());
+    }
+
+    std::ofstream out(filename);
+    write_json(out);
+    return static_cast<bool>(out);
+}
+
+} // namespace just
+
+TEST_CASE("Tracer records per thread events") {
+    just::Tracer tracer(4);
+
+    // Nothing is recorded until enabled
+    {
+        just::Tracer::Scope scope(tracer, "ignored");
+    }
+    CHECK(tracer.size() == 0);
+
+    tracer.enable(true);
+    tracer.set_thread_name("main \"thread\"");
+    {
+        just::Tracer::Scope outer(tracer, "outer");
+        just::Tracer::Scope inner(tracer, "inner");
+    }
+
+    std::thread worker([&tracer] {
+        tracer.set_thread_name("worker");
+        for (int i = 0; i < 6; ++i) {
+            just::Tracer::Scope scope(tracer, "work");
+        }
+    });
+    worker.join();
+
+    // The worker filled its buffer of 4 and dropped the rest
+    CHECK(tracer.size() == 6);
+    CHECK(tracer.dropped() == 2);
+
+    std::stringstream json;
+    tracer.write_json(json);
+    std::string str = json.str();
+    CHECK(str.find("\"name\":\"main \\\"thread\\\"\"") != std::string::npos);
+    CHECK(str.find("\"name\":\"worker\"") != std::string::npos);
+    CHECK(str.find("\"name\":\"outer\",\"ph\":\"X\",\"pid\":1,\"tid\":1") != std::string::npos);
+    CHECK(str.find("\"name\":\"work\",\"ph\":\"X\",\"pid\":1,\"tid\":2") != std::string::npos);
+    CHECK(str.find("\"dropped_events\":2") != std::string::npos);
+    CHECK(str.find("ignored") == std::string::npos);
+
+    // Inner ends first, so is recorded before outer
+    size_t inner = str.find("\"inner\"");
+    size_t outer = str.find("\"outer\"");
+    REQUIRE(inner != std::string::npos);
+    REQUIRE(outer != std::string::npos);
+    CHECK(inner < outer);
+
+    // A second tracer gets buffers of its own, even on the same threads
+    just::Tracer other(16);
+    other.enable(true);
+    {
+        just::Tracer::Scope scope(other, "other");
+    }
+    CHECK(other.size() == 1);
+    CHECK(tracer.size() == 6);
+}
@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "just/trace.hpp"
+#include "just/vfh_logger.hpp"
+
+namespace just
+{
+
+namespace
+{
+
+// Create an extendable [rows, steps] dataset, chunked in blocks of 'chunk_steps' columns
+template <typename T>
+HighFive::DataSet create_column_dataset(HighFive::Group& group,
+                                        const std::string& name,
+                                        size_t rows,
+                                        size_t chunk_steps,
+                                        unsigned compression = 0)
+{
+    HighFive::DataSpace dataspace({rows, 0}, {rows, HighFive::DataSpace::UNLIMITED});
+    HighFive::DataSetCreateProps props;
+    props.add(HighFive::Chunking(std::vector<hsize_t>{rows, chunk_steps}));
+    if (compression > 0) {
+        props.add(HighFive::Deflate(compression));
+    }
+    return group.createDataSet(name, dataspace, HighFive::create_datatype<T>(), props);
+}
+
+// Create an extendable 1D dataset
+template <typename T>
+HighFive::DataSet create_array_dataset(HighFive::Group& group,
+                                       const std::string& name,
+                                       size_t chunk,
+                                       unsigned compression = 0)
+{
+    HighFive::DataSpace dataspace({0}, {HighFive::DataSpace::UNLIMITED});
+    HighFive::DataSetCreateProps props;
+    props.add(HighFive::Chunking(std::vector<hsize_t>{chunk}));
+    if (compression > 0) {
+        props.add(HighFive::Deflate(compression));
+    }
+    return group.createDataSet(name, dataspace, HighFive::create_datatype<T>(), props);
+}
+
+template <typename T>
+void append(HighFive::DataSet& dataset, const std::vector<T>& values)
+{
+    if (values.empty()) {
+        return;
+    }
+    auto dims = dataset.getDimensions();
+    size_t start = dims.at(0);
+    dims.at(0) += values.size();
+    dataset.resize(dims);
+    dataset.select({start}, {values.size()}).write_raw(values.data());
+}
+
+} // namespace
+
+struct VFHAgent::Logger::Datasets
+{
+    Datasets(HighFive::Group group, unsigned grid_size, const Options& options)
+        : window(create_column_dataset<uint8_t>(group,
+                                                "vfh_agent/window_histogram",
+                                                WINDOW_SIZE_SQUARED,
+                                                BLOCK_STEPS)),
+          polar_histogram(create_column_dataset<float>(group,
+                                                       "vfh_agent/polar_histogram",
+                                                       K,
+                                                       BLOCK_STEPS)),
+          motion(create_column_dataset<float>(group, "vfh_agent/packed_motion", 4, BLOCK_STEPS)),
+          agent_steps(create_array_dataset<uint64_t>(group, "vfh_agent/agent_steps", BLOCK_STEPS)),
+          grid_group(group.createGroup("vfh_agent/full_histogram")),
+          keyframes(create_column_dataset<uint8_t>(grid_group,
+                                                   "keyframes",
+                                                   grid_size,
+                                                   1,
+                                                   options.compression)),
+          keyframe_steps(create_array_dataset<uint64_t>(grid_group, "keyframe_steps", 64)),
+          steps(create_array_dataset<uint64_t>(grid_group, "steps", BLOCK_STEPS)),
+          delta_counts(create_array_dataset<uint32_t>(grid_group,
+                                                      "delta_counts",
+                                                      BLOCK_STEPS,
+                                                      options.compression)),
+          delta_cells(create_array_dataset<uint32_t>(grid_group,
+                                                     "delta_cells",
+                                                     1 << 14,
+                                                     options.compression)),
+          delta_values(create_array_dataset<uint8_t>(grid_group,
+                                                     "delta_values",
+                                                     1 << 14,
+                                                     options.compression))
+    {
+        motion.createAttribute("angle_index", 0);
+        motion.createAttribute("speed_index", 1);
+        motion.createAttribute("x_index", 2);
+        motion.createAttribute("y_index", 3);
+    }
+
+    HighFive::DataSet window;
+    HighFive::DataSet polar_histogram;
+    HighFive::DataSet motion;
+    HighFive::DataSet agent_steps;
+    HighFive::Group grid_group;
+    HighFive::DataSet keyframes;
+    HighFive::DataSet keyframe_steps;
+    HighFive::DataSet steps;
+    HighFive::DataSet delta_counts;
+    HighFive::DataSet delta_cells;
+    HighFive::DataSet delta_values;
+};
+
+VFHAgent::Logger::Logger(const std::string& filename,
+                         unsigned grid_width,
+                         unsigned grid_height,
+                         Options options)
+    : options_(options),
+      owned_telemetry_(std::make_unique<Telemetry>(filename)),
+      telemetry_(owned_telemetry_.get()),
+      ring_(RING_CAPACITY),
+      cell_ring_(CELL_RING_CAPACITY)
+{
+    init("/", grid_width, grid_height);
+}
+
+VFHAgent::Logger::Logger(Telemetry& telemetry,
+                         const std::string& group,
+                         unsigned grid_width,
+                         unsigned grid_height,
+                         Options options)
+    : options_(options),
+      telemetry_(&telemetry),
+      ring_(RING_CAPACITY),
+      cell_ring_(CELL_RING_CAPACITY)
+{
+    init(group, grid_width, grid_height);
+}
+
+VFHAgent::Logger::~Logger()
+{
+    // Flushes whatever is still queued, the datasets are no longer touched after this
+    telemetry_->remove_channel(this);
+    // Closing the datasets is an HDF5 call like any other, other files' writers may be running
+    std::lock_guard lock(Telemetry::hdf5_mutex());
+    datasets_.reset();
+}
+
+void VFHAgent::Logger::init(const std::string& group, unsigned grid_width, unsigned grid_height)
+{
+    options_.keyframe_interval = std::max<size_t>(options_.keyframe_interval, 1);
+    shadow_grid_.resize(grid_width * grid_height);
+    batch_.reserve(BLOCK_STEPS);
+
+    telemetry_->add_channel(this, [&](HighFive::File& file) {
+        HighFive::Group base = file.exist(group) ? file.getGroup(group) : file.createGroup(group);
+        datasets_ = std::make_unique<Datasets>(base, grid_width * grid_height, options_);
+        datasets_->grid_group.createAttribute("width", grid_width);
+        datasets_->grid_group.createAttribute("height", grid_height);
+        datasets_->grid_group.createAttribute("keyframe_interval", options_.keyframe_interval);
+    });
+}
+
+void VFHAgent::Logger::begin_step(uint64_t step)
+{
+    pending_.step = step;
+}
+
+void VFHAgent::Logger::log_polar_histogram(const std::array<float, K>& polar_histogram)
+{
+    pending_.polar_histogram = polar_histogram;
+    pending_.flags |= Record::POLAR_HISTOGRAM;
+}
+
+void VFHAgent::Logger::log_window(std::span<const uint8_t, WINDOW_SIZE_SQUARED> window)
+{
+    std::copy(window.begin(), window.end(), pending_.window.begin());
+    pending_.flags |= Record::WINDOW;
+}
+
+void VFHAgent::Logger::log_full_grid(const HistogramGrid& grid)
+{
+    // Cost is proportional to the cells that changed this step, not the size of the grid
+    const uint8_t* data = grid.data();
+    for (uint32_t cell : grid.changed_cells()) {
+        push_cell({cell, data[cell]});
+    }
+    pending_.grid_updates = grid.changed_cells().size();
+    pending_.flags |= Record::GRID;
+}
+
+void VFHAgent::Logger::log_grid_keyframe(const HistogramGrid& grid)
+{
+    const uint8_t* data = grid.data();
+    uint32_t size = grid.width() * grid.height();
+    for (uint32_t cell = 0; cell < size; ++cell) {
+        push_cell({cell, data[cell]});
+    }
+    pending_.grid_updates = size;
+    pending_.flags |= Record::GRID | Record::KEYFRAME;
+}
+
+void VFHAgent::Logger::log_motion(float angle, float speed, float x, float y)
+{
+    pending_.motion = {angle, speed, x, y};
+    pending_.flags |= Record::MOTION;
+}
+
+void VFHAgent::Logger::end_step()
+{
+    if (pending_.flags != 0) {
+        // Never drop data, if the writer can't keep up the agent has to wait for it
+        while (!ring_.try_push(pending_) && !failed_.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+    pending_.flags = 0;
+    pending_.grid_updates = 0;
+}
+
+void VFHAgent::Logger::push_cell(CellUpdate update)
+{
+    while (!cell_ring_.try_push(update) && !failed_.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+bool VFHAgent::Logger::drain()
+{
+    bool popped = false;
+    while (batch_.size() < BLOCK_STEPS) {
+        batch_.emplace_back();
+        if (!ring_.try_pop(batch_.back())) {
+            batch_.pop_back();
+            break;
+        }
+        popped = true;
+    }
+
+    // Cells are pushed before the record they belong to, so draining them after popping records
+    // means every popped record has its cells in the backlog
+    CellUpdate update;
+    while (cell_ring_.try_pop(update)) {
+        cell_backlog_.push_back(update);
+        popped = true;
+    }
+
+    return popped;
+}
+
+bool VFHAgent::Logger::ready() const
+{
+    return batch_.size() >= BLOCK_STEPS;
+}
+
+void VFHAgent::Logger::write()
+{
+    JUST_TRACE_SCOPE("logger_write");
+    if (!failed_.load(std::memory_order_relaxed)) {
+        try {
+            write_grid_deltas();
+            write_batch();
+        } catch (const std::exception& err) {
+            // Not much to be done from here, don't take the simulation down with us
+            std::cerr << "VFHAgent logger failed, logging stopped: " << err.what() << std::endl;
+            failed_.store(true, std::memory_order_release);
+        }
+    }
+
+    // Once failed, keep draining (so the agent never blocks) but discard everything
+    if (failed_.load(std::memory_order_relaxed)) {
+        batch_.clear();
+        cell_backlog_.clear();
+        cell_backlog_start_ = 0;
+    }
+}
+
+template <typename T, size_t N, typename Getter>
+void VFHAgent::Logger::append_columns(HighFive::DataSet& dataset, uint8_t flag, Getter get)
+{
+    size_t count = std::count_if(batch_.begin(), batch_.end(), [flag](const Record& record) {
+        return record.flags & flag;
+    });
+    if (count == 0) {
+        return;
+    }
+
+    // Steps are columns in the file, so the block is transposed on the way out
+    std::vector<T> buffer(N * count);
+    size_t col = 0;
+    for (const auto& record : batch_) {
+        if (!(record.flags & flag)) {
+            continue;
+        }
+        const std::array<T, N>& data = get(record);
+        for (size_t row = 0; row < N; ++row) {
+            buffer[row * count + col] = data[row];
+        }
+        ++col;
+    }
+
+    auto dims = dataset.getDimensions();
+    size_t start = dims.at(1);
+    dims.at(1) += count;
+    dataset.resize(dims);
+    dataset.select({0, start}, {N, count}).write_raw(buffer.data());
+}
+
+void VFHAgent::Logger::write_batch()
+{
+    append_columns<uint8_t, WINDOW_SIZE_SQUARED>(
+        datasets_->window,
+        Record::WINDOW,
+        [](const Record& record) -> const auto& { return record.window; });
+    append_columns<float, K>(
+        datasets_->polar_histogram,
+        Record::POLAR_HISTOGRAM,
+        [](const Record& record) -> const auto& { return record.polar_histogram; });
+    append_columns<float, 4>(
+        datasets_->motion,
+        Record::MOTION,
+        [](const Record& record) -> const auto& { return record.motion; });
+
+    std::vector<uint64_t> agent_steps;
+    for (const auto& record : batch_) {
+        if (record.flags & Record::MOTION) {
+            agent_steps.push_back(record.step);
+        }
+    }
+    append(datasets_->agent_steps, agent_steps);
+
+    batch_.clear();
+}
+
+void VFHAgent::Logger::write_grid_deltas()
+{
+    std::vector<uint64_t> steps;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> cells;
+    std::vector<uint8_t> values;
+    std::vector<uint64_t> keyframe_steps;
+
+    auto flush_deltas = [&] {
+        append(datasets_->steps, steps);
+        append(datasets_->delta_counts, counts);
+        append(datasets_->delta_cells, cells);
+        append(datasets_->delta_values, values);
+        steps.clear();
+        counts.clear();
+        cells.clear();
+        values.clear();
+    };
+
+    for (const auto& record : batch_) {
+        if (!(record.flags & Record::GRID)) {
+            continue;
+        }
+
+        auto first = cell_backlog_.begin() + cell_backlog_start_;
+        auto last = first + record.grid_updates;
+        bool keyframe = record.flags & Record::KEYFRAME;
+        uint32_t count = 0;
+        if (keyframe) {
+            // The whole grid, in order. The delta is whatever differs from the last logged step,
+            // so the deltas still add up for readers replaying them across the unlogged steps.
+            for (auto it = first; it != last; ++it) {
+                if (shadow_grid_[it->cell] != it->value) {
+                    shadow_grid_[it->cell] = it->value;
+                    cells.push_back(it->cell);
+                    values.push_back(it->value);
+                    ++count;
+                }
+            }
+        } else {
+            // A cell may change more than once in a step, only its final value is kept
+            std::stable_sort(first, last, [](const CellUpdate& a, const CellUpdate& b) {
+                return a.cell < b.cell;
+            });
+            for (auto it = first; it != last; ++it) {
+                if (std::next(it) != last && std::next(it)->cell == it->cell) {
+                    continue;
+                }
+                shadow_grid_[it->cell] = it->value;
+                cells.push_back(it->cell);
+                values.push_back(it->value);
+                ++count;
+            }
+        }
+        steps.push_back(record.step);
+        counts.push_back(count);
+        cell_backlog_start_ += record.grid_updates;
+
+        if (keyframe || grid_step_ % options_.keyframe_interval == 0) {
+            // Keep the deltas and keyframes in step, in case of a crash mid-batch
+            flush_deltas();
+
+            auto dims = datasets_->keyframes.getDimensions();
+            size_t column = dims.at(1);
+            dims.at(1) += 1;
+            datasets_->keyframes.resize(dims);
+            datasets_->keyframes.select({0, column}, {shadow_grid_.size(), 1})
+                .write_raw(shadow_grid_.data());
+            keyframe_steps.push_back(record.step);
+        }
+        ++grid_step_;
+    }
+
+    flush_deltas();
+    append(datasets_->keyframe_steps, keyframe_steps);
+
+    cell_backlog_.erase(cell_backlog_.begin(), cell_backlog_.begin() + cell_backlog_start_);
+    cell_backlog_start_ = 0;
+}
+
+} // namespace just
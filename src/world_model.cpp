@@ -36,6 +36,23 @@ HistogramGrid::HistogramGrid(unsigned width, unsigned height)
     y_min_ = height % 2 ? -y_max_ : -(y_max_ - 1);
 }
 
+void HistogramGrid::track_dirty_tiles(bool enable)
+{
+    track_dirty_tiles_ = enable;
+    tile_dirty_.assign(enable ? tiles_wide() * tiles_high() : 0, false);
+    dirty_tiles_.clear();
+}
+
+std::vector<uint32_t> HistogramGrid::take_dirty_tiles()
+{
+    std::vector<uint32_t> tiles;
+    tiles.swap(dirty_tiles_);
+    for (uint32_t tile : tiles) {
+        tile_dirty_[tile] = false;
+    }
+    return tiles;
+}
+
 bool HistogramGrid::add_percept(int x0, int y0, float theta, float distance, bool detected)
 {
     if (!within_bounds(x0, y0)) {
@@ -113,34 +130,65 @@ bool HistogramGrid::within_bounds(int x, int y) const
 
 uint8_t& HistogramGrid::unsafe_at(int x, int y)
 {
-    unsigned col = x - x_min_;
-    unsigned row = y - y_min_;
-
-    return data_[row * width_ + col];
+    return data_[unsafe_index(x, y)];
 }
 
 const uint8_t& HistogramGrid::unsafe_at(int x, int y) const
+{
+    return data_[unsafe_index(x, y)];
+}
+
+uint32_t HistogramGrid::unsafe_index(int x, int y) const
 {
     unsigned col = x - x_min_;
     unsigned row = y - y_min_;
 
-    return data_[row * width_ + col];
+    return row * width_ + col;
+}
+
+void HistogramGrid::mark_dirty(uint32_t idx)
+{
+    uint32_t tile = (idx % width_) / TILE_SIZE + (idx / width_) / TILE_SIZE * tiles_wide();
+    if (!tile_dirty_[tile]) {
+        tile_dirty_[tile] = true;
+        dirty_tiles_.push_back(tile);
+    }
 }
 
 void HistogramGrid::increment_cell(int x, int y)
 {
-    uint8_t& cell = unsafe_at(x, y);
+    uint32_t idx = unsafe_index(x, y);
+    uint8_t& cell = data_[idx];
+    uint8_t old = cell;
     cell = std::clamp(static_cast<uint8_t>(cell + CV_INC), CV_MIN, CV_MAX);
+    if (cell != old) {
+        if (track_changes_) {
+            changed_cells_.push_back(idx);
+        }
+        if (track_dirty_tiles_) {
+            mark_dirty(idx);
+        }
+    }
 }
 
 void HistogramGrid::decrement_cell(int x, int y)
 {
-    uint8_t& cell = unsafe_at(x, y);
+    uint32_t idx = unsafe_index(x, y);
+    uint8_t& cell = data_[idx];
+    uint8_t old = cell;
     if (static_cast<int>(cell) - static_cast<int>(CV_DEC) < 0) {
         cell = 0;
     } else {
         cell -= CV_DEC;
     }
+    if (cell != old) {
+        if (track_changes_) {
+            changed_cells_.push_back(idx);
+        }
+        if (track_dirty_tiles_) {
+            mark_dirty(idx);
+        }
+    }
 }
 
 } // namespace just
@@ -414,3 +462,71 @@ TEST_CASE("HistogramGrid.subgrid") {
 
     // TODO: add more test cases
 }
+
+TEST_CASE("HistogramGrid change tracking") {
+    just::HistogramGrid grid(10, 10);
+
+    // Off by default
+    grid.add_percept(0, 0, 0.0, 3.0, true);
+    REQUIRE(grid.changed_cells().empty());
+
+    grid.track_changes(true);
+
+    // Decrementing cells that are already at the minimum isn't a change, so only the cell
+    // the percept landed on is recorded
+    grid.add_percept(0, 0, M_PI / 2, 3.0, true);
+    REQUIRE(grid.changed_cells().size() == 1);
+    uint32_t idx = grid.changed_cells().at(0);
+    CHECK(grid.data()[idx] == just::HistogramGrid::CV_INC);
+    CHECK(grid.data()[idx] == grid.at(0,3).value());
+
+    grid.clear_changed_cells();
+    REQUIRE(grid.changed_cells().empty());
+
+    // Shooting through (3,0) decrements it, and increments (4,0)
+    grid.add_percept(0, 0, 0.0, 4.0, true);
+    REQUIRE(grid.changed_cells().size() == 2);
+    for (uint32_t changed : grid.changed_cells()) {
+        bool expected = grid.data()[changed] == just::HistogramGrid::CV_INC - 1 ||
+                        grid.data()[changed] == just::HistogramGrid::CV_INC;
+        CHECK(expected);
+    }
+}
+
+TEST_CASE("HistogramGrid dirty tiles") {
+    constexpr unsigned TILE = just::HistogramGrid::TILE_SIZE;
+    // Three tiles wide, the last one partial, and two high
+    just::HistogramGrid grid(2 * TILE + 5, 2 * TILE);
+    REQUIRE(grid.tiles_wide() == 3);
+    REQUIRE(grid.tiles_high() == 2);
+
+    // Off by default
+    grid.add_percept(0, 0, 0.0, 3.0, true);
+    grid.track_dirty_tiles(true);
+    REQUIRE(grid.take_dirty_tiles().empty());
+
+    // Cells map to tiles from the grid's bottom left corner, and repeated changes to a tile only
+    // dirty it once
+    int x_left = grid.x_min();
+    int y_bottom = grid.y_min();
+    grid.add_percept(x_left, y_bottom, M_PI / 2, 2.0, true);
+    grid.add_percept(x_left, y_bottom, M_PI / 2, 2.0, true);
+    auto tiles = grid.take_dirty_tiles();
+    REQUIRE(tiles.size() == 1);
+    CHECK(tiles.at(0) == 0);
+    CHECK(grid.take_dirty_tiles().empty());
+
+    // A percept in the top right corner, within the partial tile
+    int x_right = grid.x_min() + static_cast<int>(grid.width()) - 1;
+    int y_top = grid.y_min() + static_cast<int>(grid.height()) - 1;
+    grid.add_percept(x_right, y_top, M_PI, 2.0, true);
+    tiles = grid.take_dirty_tiles();
+    REQUIRE(tiles.size() == 1);
+    CHECK(tiles.at(0) == 2 + 1 * grid.tiles_wide());
+
+    // Independent of the changed cells
+    grid.track_changes(true);
+    grid.add_percept(0, 0, 0.0, 3.0, true);
+    grid.clear_changed_cells();
+    CHECK(grid.take_dirty_tiles().size() == 1);
+}
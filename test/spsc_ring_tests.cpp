@@ -0,0 +1,63 @@
+#include <thread>
+
+#include "doctest/doctest.h"
+
+#include "just/spsc_ring.hpp"
+
+TEST_CASE("SpscRing single threaded") {
+    just::SpscRing<int> ring(3);
+    REQUIRE(ring.capacity() == 4);
+    REQUIRE(ring.empty());
+
+    int value;
+    CHECK_FALSE(ring.try_pop(value));
+
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(ring.try_push(i));
+    }
+    CHECK_FALSE(ring.try_push(4));
+    CHECK_FALSE(ring.empty());
+
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(ring.try_pop(value));
+        CHECK(value == i);
+    }
+    CHECK_FALSE(ring.try_pop(value));
+
+    // Wrap around
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(ring.try_push(i));
+        REQUIRE(ring.try_pop(value));
+        CHECK(value == i);
+    }
+    CHECK(ring.empty());
+}
+
+TEST_CASE("SpscRing producer/consumer threads") {
+    constexpr int COUNT = 100000;
+    just::SpscRing<int> ring(64);
+
+    std::thread producer([&ring] {
+        for (int i = 0; i < COUNT; ++i) {
+            while (!ring.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    bool in_order = true;
+    int value;
+    while (expected < COUNT) {
+        if (ring.try_pop(value)) {
+            in_order = in_order && value == expected;
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    CHECK(in_order);
+    CHECK(ring.empty());
+}
@@ -0,0 +1,77 @@
+#include <array>
+#include <atomic>
+#include <thread>
+
+#include "doctest/doctest.h"
+
+#include "just/triple_buffer.hpp"
+
+TEST_CASE("TripleBuffer single threaded") {
+    just::TripleBuffer<int> buffer;
+
+    // Nothing published yet
+    CHECK_FALSE(buffer.update());
+    CHECK(buffer.read_buffer() == 0);
+
+    buffer.write_buffer() = 1;
+    buffer.publish();
+    REQUIRE(buffer.update());
+    CHECK(buffer.read_buffer() == 1);
+    // Taken already
+    CHECK_FALSE(buffer.update());
+    CHECK(buffer.read_buffer() == 1);
+
+    // Only the latest of several publishes is seen
+    for (int i = 2; i <= 5; ++i) {
+        buffer.write_buffer() = i;
+        buffer.publish();
+    }
+    REQUIRE(buffer.update());
+    CHECK(buffer.read_buffer() == 5);
+
+    // The writer never gets the buffer the reader holds
+    for (int i = 6; i <= 10; ++i) {
+        CHECK(&buffer.write_buffer() != &buffer.read_buffer());
+        buffer.write_buffer() = i;
+        buffer.publish();
+    }
+    CHECK(buffer.read_buffer() == 5);
+}
+
+TEST_CASE("TripleBuffer writer/reader threads") {
+    // Every element of a published value is the same, a torn read would show mixed ones
+    constexpr int COUNT = 100000;
+    just::TripleBuffer<std::array<int, 64>> buffer;
+    std::atomic<bool> done{false};
+
+    std::thread writer([&buffer, &done] {
+        for (int i = 1; i <= COUNT; ++i) {
+            buffer.write_buffer().fill(i);
+            buffer.publish();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    bool consistent = true;
+    bool increasing = true;
+    int last = 0;
+    while (true) {
+        bool finished = done.load(std::memory_order_acquire);
+        if (buffer.update()) {
+            const auto& value = buffer.read_buffer();
+            for (int element : value) {
+                consistent = consistent && element == value[0];
+            }
+            increasing = increasing && value[0] > last;
+            last = value[0];
+        } else if (finished) {
+            break;
+        }
+    }
+    writer.join();
+
+    CHECK(consistent);
+    CHECK(increasing);
+    // The reader always ends up with the last value
+    CHECK(last == COUNT);
+}